@@ -0,0 +1,49 @@
+// Copyright 2019 Tricot Inc.
+// Use of this source code is governed by the license in the LICENSE file.
+
+#ifndef XSP_PERCPU_COUNTER_H_
+#define XSP_PERCPU_COUNTER_H_
+
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A 64-bit counter (e.g., for statistics) that is cheap to add to: it has one shard per core, and
+// adding only updates the current core's shard (masking interrupts on that core only, without any
+// cross-core locking). Reading sums the shards (without locking, using a sequence counter per
+// shard to avoid torn reads), so is more expensive.
+//
+// Note that a read is not a snapshot of all shards at a single point in time, but it will include
+// all adds that completed before the read started.
+
+typedef struct {
+    uint64_t value;
+    uint32_t seq;  // Odd while `value` is being updated.
+} __attribute__((aligned(32))) xsp_percpu_counter_shard_t;
+
+typedef struct xsp_percpu_counter {
+    xsp_percpu_counter_shard_t shards[portNUM_PROCESSORS];
+} xsp_percpu_counter_t;
+
+// Static initializer (to zero).
+#define XSP_PERCPU_COUNTER_INITIALIZER {}
+
+// Initializes (or resets) the counter to zero. This must not be called concurrently with any other
+// operation on the counter.
+void xsp_percpu_counter_init(xsp_percpu_counter_t* counter);
+
+// Adds to the counter. May be called from an ISR.
+void xsp_percpu_counter_add(xsp_percpu_counter_t* counter, uint64_t delta);
+
+// Reads the counter (the sum of the shards). May be called from an ISR.
+uint64_t xsp_percpu_counter_read(const xsp_percpu_counter_t* counter);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // XSP_PERCPU_COUNTER_H_
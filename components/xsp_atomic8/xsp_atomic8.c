@@ -2,37 +2,130 @@
 // Use of this source code is governed by the license in the LICENSE file.
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #include "freertos/FreeRTOS.h"
 
+#include "sdkconfig.h"
+
 #define CAT3(a, b, c) a##b##c
 
 #define WEAK __attribute__((weak))
 
-static portMUX_TYPE g_atomic8_mux = portMUX_INITIALIZER_UNLOCKED;
+// Implementation strategy (see Kconfig).
+#if defined(CONFIG_XSP_ATOMIC8_GLOBAL_LOCK)
+#define NUM_LOCKS 1
+#define USE_SEQLOCK 0
+#elif defined(CONFIG_XSP_ATOMIC8_STRIPED_LOCK)
+#define NUM_LOCKS CONFIG_XSP_ATOMIC8_NUM_LOCKS
+#define USE_SEQLOCK 0
+#elif defined(CONFIG_XSP_ATOMIC8_SEQLOCK)
+#define NUM_LOCKS CONFIG_XSP_ATOMIC8_NUM_LOCKS
+#define USE_SEQLOCK 1
+#else
+#error "No XSP atomic8 strategy selected"
+#endif
+
+_Static_assert(NUM_LOCKS > 0 && (NUM_LOCKS & (NUM_LOCKS - 1)) == 0,
+               "CONFIG_XSP_ATOMIC8_NUM_LOCKS must be a power of 2");
+
+// Each lock gets its own cache line (the ESP32's cache line size is 32 bytes), so that spinning on
+// one lock doesn't interfere with the others.
+#define CACHE_LINE_SIZE 32
+
+// With the seqlock strategy, each lock is also a seqlock: writers (which hold `mux`) make `seq` odd
+// while writing, so that loads can be done without taking `mux` (by retrying if `seq` was odd or
+// changed). Note that readers can only ever spin on writers on the *other* core, since writers mask
+// interrupts.
+typedef struct {
+    portMUX_TYPE mux;
+    uint32_t seq;
+} __attribute__((aligned(CACHE_LINE_SIZE))) atomic8_lock_t;
+
+static atomic8_lock_t g_atomic8_locks[NUM_LOCKS] = {
+        [0 ... NUM_LOCKS - 1] = {.mux = portMUX_INITIALIZER_UNLOCKED, .seq = 0},
+};
+
+// Selects the lock for the given address. The low 3 bits are always zero (for properly-aligned
+// 64-bit values), so are dropped; the rest is hashed (Fibonacci hashing), so that nearby values
+// (e.g., in an array) get different locks.
+static inline atomic8_lock_t* get_lock(const volatile void* ptr) {
+    uint32_t h = (uint32_t)((uintptr_t)ptr >> 3) * 2654435761u;
+    return &g_atomic8_locks[(h >> 16) & (NUM_LOCKS - 1)];
+}
+
+static inline void write_begin(atomic8_lock_t* lock) {
+    portENTER_CRITICAL(&lock->mux);
+#if USE_SEQLOCK
+    __atomic_store_n(&lock->seq, lock->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+#endif
+}
 
-#define LOCK() portENTER_CRITICAL(&g_atomic8_mux)
-#define UNLOCK() portEXIT_CRITICAL(&g_atomic8_mux)
+static inline void write_end(atomic8_lock_t* lock) {
+#if USE_SEQLOCK
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    __atomic_store_n(&lock->seq, lock->seq + 1, __ATOMIC_RELAXED);
+#endif
+    portEXIT_CRITICAL(&lock->mux);
+}
 
+#define LOCK(ptr) write_begin(get_lock(ptr))
+#define UNLOCK(ptr) write_end(get_lock(ptr))
+
+// Reports (truthfully) whether atomics of the given size (at the given address, if non-null) are
+// lock-free. This is what `atomic_is_lock_free()` and `std::atomic<T>::is_lock_free()` call when
+// the compiler can't determine the answer itself. (Note that `__atomic_always_lock_free()` is
+// always evaluated by the compiler.)
+WEAK bool __atomic_is_lock_free(size_t size, const volatile void* ptr) {
+    // The hardware supports (only) 32-bit compare-and-set (S32C1I), which the compiler uses for
+    // naturally-aligned atomics of up to 4 bytes. 64-bit atomics use locks, even with the seqlock
+    // strategy (only loads are lock-free).
+    switch (size) {
+    case 1:
+    case 2:
+    case 4:
+        return !ptr || ((uintptr_t)ptr & (size - 1)) == 0;
+    default:
+        return false;
+    }
+}
+
+#if USE_SEQLOCK
+// Loads never take the lock (see above).
+WEAK uint64_t __atomic_load_8(uint64_t* ptr, int memorder) {
+    atomic8_lock_t* lock = get_lock(ptr);
+    for (;;) {
+        uint32_t seq = __atomic_load_n(&lock->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1)
+            continue;  // Write in progress (on the other core).
+        uint64_t tmp = *(volatile uint64_t*)ptr;
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&lock->seq, __ATOMIC_RELAXED) == seq)
+            return tmp;
+    }
+}
+#else
 WEAK uint64_t __atomic_load_8(uint64_t* ptr, int memorder) {
-    LOCK();
+    LOCK(ptr);
     uint64_t tmp = *ptr;
-    UNLOCK();
+    UNLOCK(ptr);
     return tmp;
 }
+#endif
 
 WEAK void __atomic_store_8(uint64_t* ptr, uint64_t val, int memorder) {
-    LOCK();
+    LOCK(ptr);
     *ptr = val;
-    UNLOCK();
+    UNLOCK(ptr);
 }
 
 WEAK uint64_t __atomic_exchange_8(uint64_t* ptr, uint64_t val, int memorder) {
-    LOCK();
+    LOCK(ptr);
     uint64_t tmp = *ptr;
     *ptr = val;
-    UNLOCK();
+    UNLOCK(ptr);
     return tmp;
 }
 
@@ -42,7 +135,7 @@ WEAK bool __atomic_compare_exchange_8(uint64_t* ptr,
                                       bool weak,
                                       int success_memorder,
                                       int failure_memorder) {
-    LOCK();
+    LOCK(ptr);
     bool result;
     if (*ptr == *expected) {
         *ptr = desired;
@@ -51,24 +144,24 @@ WEAK bool __atomic_compare_exchange_8(uint64_t* ptr,
         *expected = *ptr;
         result = false;
     }
-    UNLOCK();
+    UNLOCK(ptr);
     return result;
 }
 
 WEAK bool __atomic_test_and_set_8(uint64_t* ptr, int memorder) {
-    LOCK();
+    LOCK(ptr);
     bool result = !!*ptr;
     *ptr = 1;
-    UNLOCK();
+    UNLOCK(ptr);
     return result;
 }
 
 #define DEFINE_ATOMIC_FETCH_OP(name, op_assign)                                                 \
     WEAK uint64_t CAT3(__atomic_fetch_, name, _8)(uint64_t * ptr, uint64_t val, int memorder) { \
-        LOCK();                                                                                 \
+        LOCK(ptr);                                                                              \
         uint64_t tmp = *ptr;                                                                    \
         op_assign;                                                                              \
-        UNLOCK();                                                                               \
+        UNLOCK(ptr);                                                                            \
         return tmp;                                                                             \
     }
 
@@ -83,9 +176,9 @@ DEFINE_ATOMIC_FETCH_OP(nand, *ptr = ~(*ptr & val))
 
 #define DEFINE_ATOMIC_OP_FETCH(name, op_assign)                                                 \
     WEAK uint64_t CAT3(__atomic_, name, _fetch_8)(uint64_t * ptr, uint64_t val, int memorder) { \
-        LOCK();                                                                                 \
+        LOCK(ptr);                                                                              \
         uint64_t tmp = (op_assign);                                                             \
-        UNLOCK();                                                                               \
+        UNLOCK(ptr);                                                                            \
         return tmp;                                                                             \
     }
 
@@ -0,0 +1,45 @@
+// Copyright 2019 Tricot Inc.
+// Use of this source code is governed by the license in the LICENSE file.
+
+#include "xsp_percpu_counter.h"
+
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/portmacro.h"
+
+void xsp_percpu_counter_init(xsp_percpu_counter_t* counter) {
+    memset(counter, 0, sizeof(*counter));
+}
+
+void xsp_percpu_counter_add(xsp_percpu_counter_t* counter, uint64_t delta) {
+    // Masking interrupts on this core keeps us on this core and keeps anything else on this core
+    // from touching the shard; only readers on the other core may look at it concurrently.
+    unsigned state = portENTER_CRITICAL_NESTED();
+    xsp_percpu_counter_shard_t* shard = &counter->shards[xPortGetCoreID()];
+    __atomic_store_n(&shard->seq, shard->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    shard->value += delta;
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    __atomic_store_n(&shard->seq, shard->seq + 1, __ATOMIC_RELAXED);
+    portEXIT_CRITICAL_NESTED(state);
+}
+
+uint64_t xsp_percpu_counter_read(const xsp_percpu_counter_t* counter) {
+    uint64_t sum = 0;
+    for (int i = 0; i < portNUM_PROCESSORS; i++) {
+        const xsp_percpu_counter_shard_t* shard = &counter->shards[i];
+        for (;;) {
+            uint32_t seq = __atomic_load_n(&shard->seq, __ATOMIC_ACQUIRE);
+            if (seq & 1)
+                continue;  // Add in progress (on the other core).
+            uint64_t value = *(const volatile uint64_t*)&shard->value;
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+            if (__atomic_load_n(&shard->seq, __ATOMIC_RELAXED) == seq) {
+                sum += value;
+                break;
+            }
+        }
+    }
+    return sum;
+}
@@ -0,0 +1,52 @@
+// Copyright 2019 Tricot Inc.
+// Use of this source code is governed by the license in the LICENSE file.
+
+#ifndef XSP_CHANFD_H_
+#define XSP_CHANFD_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define XSP_CHANFD_NONBLOCK 2
+
+#define XSP_CHANFD_IOCTL_BASE (0x43464400)  // (Big-endian) 'C', 'F', 'D', ....
+
+// Gets a "handle" for the channel FD, which remains valid so long as the FD remains open. The first
+// (and only) ioctl argument is the out parameter, an xsp_chanfd_handle_t*.
+#define XSP_CHANFD_IOCTL_GET_HANDLE (XSP_CHANFD_IOCTL_BASE + 0)
+
+void xsp_chanfd_register();
+
+// Creates a channel FD, which is a pipe-like byte stream (both ends of which are the same FD)
+// backed by a ring buffer of the given capacity (which will be rounded up to a power of 2).
+//
+// There must be at most one writer (producer) and at most one reader (consumer) at any given time.
+// Data is transferred without locking; locks are only taken to wake up blocked readers/writers and
+// `select()`.
+int xsp_chanfd(size_t capacity, int flags);
+
+typedef struct xsp_chanfd_struct* xsp_chanfd_handle_t;
+
+// Like using `write()`, but may be called from an ISR and never blocks. Returns the number of bytes
+// written (which may be less than `count`, including 0, if there isn't enough space).
+size_t xsp_chanfd_write(xsp_chanfd_handle_t cfd, const void* buf, size_t count);
+
+// Zero-copy reading: gets a pointer to the readable data (in `*data`) and returns its size. This is
+// the size of the contiguous part of the data, which may be less than the total amount of readable
+// data (if it wraps around the end of the ring buffer); returns 0 if there's no data (never
+// blocks). The data remains valid until it is released using `xsp_chanfd_release_read()`.
+size_t xsp_chanfd_acquire_read(xsp_chanfd_handle_t cfd, const void** data);
+
+// Releases (i.e., consumes) `count` bytes, which must be at most the size returned by the previous
+// `xsp_chanfd_acquire_read()`.
+void xsp_chanfd_release_read(xsp_chanfd_handle_t cfd, size_t count);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // XSP_CHANFD_H_
@@ -0,0 +1,703 @@
+// Copyright 2019 Tricot Inc.
+// Use of this source code is governed by the license in the LICENSE file.
+
+#include "xsp_chanfd.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <unistd.h>
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_vfs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "freertos/portmacro.h"
+
+#include "sdkconfig.h"
+
+#define MAX_NUM_CHANFD CONFIG_XSP_CHANFD_MAX_NUM_CHANFD
+
+#define MAX_CAPACITY ((size_t)1 << 30)
+
+#define LOCK_TYPE portMUX_TYPE
+
+#define INIT_LOCK(l) vPortCPUInitializeMutex(l)
+#define DEINIT_LOCK(l) \
+    do {               \
+        (void)l;       \
+    } while (0)
+
+#define LOCK(l) portENTER_CRITICAL(l)
+#define UNLOCK(l) portEXIT_CRITICAL(l)
+
+// NOTE: xsp_chanfd_ctx_t's lock precedes xsp_chanfd_t's lock in the (acquisition) order.
+
+#define CFD_EVENT_SPACE_BIT 1  // Used to wait for space to become available.
+#define CFD_EVENT_DATA_BIT 2   // Used to wait for data to become available.
+
+typedef struct xsp_chanfd_struct {
+    LOCK_TYPE lock;
+    unsigned refcount;
+    bool nonblock;
+    bool closed;
+
+    EventGroupHandle_t events;
+    unsigned space_waiters;  // Number of things waiting for space.
+    unsigned data_waiters;   // Number of things waiting for data.
+
+    bool select_active;
+
+    // The ring buffer. `head` and `tail` are free-running (i.e., they are reduced modulo the
+    // capacity only when indexing) and are accessed without the lock: `head` is only written by the
+    // producer and `tail` only by the consumer.
+    uint32_t head;      // Total number of bytes written.
+    uint32_t tail;      // Total number of bytes read.
+    uint32_t capacity;  // A power of 2.
+    uint8_t buf[];
+} xsp_chanfd_t;
+
+typedef struct xsp_chanfd_ctx {
+    LOCK_TYPE lock;
+    struct {
+        int fd;  // Should be initialized to -1.
+        xsp_chanfd_t* cfd;
+    } chanfds[MAX_NUM_CHANFD];
+    // Note: Only one select() at a time (like xsp_eventfd).
+    SemaphoreHandle_t* select_signal;
+    fd_set select_readfds_in;     // Only meaningful when select_signal is set.
+    fd_set select_writefds_in;    // Only meaningful when select_signal is set.
+    fd_set* select_readfds_out;   // Only meaningful when select_signal is set.
+    fd_set* select_writefds_out;  // Only meaningful when select_signal is set.
+} xsp_chanfd_ctx_t;
+
+static const char TAG[] = "CHANFD";
+
+static esp_vfs_id_t g_chanfd_vfs_id = -1;
+static xsp_chanfd_ctx_t* g_chanfd_ctx = NULL;
+
+static uint32_t ring_used(xsp_chanfd_t* cfd) {
+    uint32_t head = __atomic_load_n(&cfd->head, __ATOMIC_ACQUIRE);
+    uint32_t tail = __atomic_load_n(&cfd->tail, __ATOMIC_ACQUIRE);
+    return head - tail;
+}
+
+// Producer only.
+static size_t ring_write(xsp_chanfd_t* cfd, const void* buf, size_t count) {
+    uint32_t head = __atomic_load_n(&cfd->head, __ATOMIC_RELAXED);
+    uint32_t tail = __atomic_load_n(&cfd->tail, __ATOMIC_ACQUIRE);
+    uint32_t space = cfd->capacity - (head - tail);
+    uint32_t n = (count < space) ? (uint32_t)count : space;
+    if (n == 0)
+        return 0;
+
+    uint32_t offset = head & (cfd->capacity - 1);
+    uint32_t first = cfd->capacity - offset;
+    if (first > n)
+        first = n;
+    memcpy(&cfd->buf[offset], buf, first);
+    memcpy(&cfd->buf[0], (const uint8_t*)buf + first, n - first);
+
+    __atomic_store_n(&cfd->head, head + n, __ATOMIC_RELEASE);
+    return n;
+}
+
+// Consumer only.
+static size_t ring_acquire_read(xsp_chanfd_t* cfd, const void** data) {
+    uint32_t head = __atomic_load_n(&cfd->head, __ATOMIC_ACQUIRE);
+    uint32_t tail = __atomic_load_n(&cfd->tail, __ATOMIC_RELAXED);
+    uint32_t used = head - tail;
+    uint32_t offset = tail & (cfd->capacity - 1);
+    uint32_t contiguous = cfd->capacity - offset;
+    *data = &cfd->buf[offset];
+    return (used < contiguous) ? used : contiguous;
+}
+
+// Consumer only.
+static void ring_release_read(xsp_chanfd_t* cfd, size_t count) {
+    uint32_t tail = __atomic_load_n(&cfd->tail, __ATOMIC_RELAXED);
+    assert(count <= __atomic_load_n(&cfd->head, __ATOMIC_ACQUIRE) - tail);
+    __atomic_store_n(&cfd->tail, tail + (uint32_t)count, __ATOMIC_RELEASE);
+}
+
+// Consumer only.
+static size_t ring_read(xsp_chanfd_t* cfd, void* buf, size_t count) {
+    size_t total = 0;
+    // At most two iterations (if the data wraps around).
+    while (total < count) {
+        const void* data;
+        size_t n = ring_acquire_read(cfd, &data);
+        if (n == 0)
+            break;
+        if (n > count - total)
+            n = count - total;
+        memcpy((uint8_t*)buf + total, data, n);
+        ring_release_read(cfd, n);
+        total += n;
+    }
+    return total;
+}
+
+static void cfd_ref_locked(xsp_chanfd_t* cfd) {
+    cfd->refcount++;
+}
+
+// Note: `cfd` should be locked to call this, but it will be unlocked afterwards.
+static void cfd_unref_locked(xsp_chanfd_t* cfd) {
+    if (cfd->refcount == 1) {
+        UNLOCK(&cfd->lock);
+        vEventGroupDelete(cfd->events);
+        DEINIT_LOCK(&cfd->lock);
+        free(cfd);
+    } else {
+        cfd->refcount--;
+        UNLOCK(&cfd->lock);
+    }
+}
+
+static xsp_chanfd_t* cfd_lookup_locked(xsp_chanfd_ctx_t* ctx, int fd, size_t* idx) {
+    if (fd < 0)
+        return NULL;
+
+    for (size_t i = 0; i < MAX_NUM_CHANFD; i++) {
+        if (ctx->chanfds[i].fd == fd) {
+            if (idx)
+                *idx = i;
+            return ctx->chanfds[i].cfd;
+        }
+    }
+
+    return NULL;
+}
+
+// Looks up the given FD and returns its `xsp_chanfd_t` with its lock acquired (but without
+// incrementing the refcount). On failure, sets errno and returns null.
+static xsp_chanfd_t* cfd_lookup(void* raw_ctx, int fd) {
+    xsp_chanfd_ctx_t* ctx = (xsp_chanfd_ctx_t*)raw_ctx;
+    LOCK(&ctx->lock);
+
+    xsp_chanfd_t* cfd = cfd_lookup_locked(ctx, fd, NULL);
+    if (!cfd) {
+        UNLOCK(&ctx->lock);
+        // The VFS only calls us for registered FDs, but another task may have closed `fd`
+        // concurrently.
+        errno = EBADF;
+        return NULL;
+    }
+
+    LOCK(&cfd->lock);
+    UNLOCK(&ctx->lock);
+    return cfd;
+}
+
+// If `in_isr`, `*woken` is set if a higher-priority task was woken (and the caller should yield at
+// the end of the ISR).
+static void maybe_signal_select_locked(xsp_chanfd_ctx_t* ctx, bool in_isr, BaseType_t* woken) {
+    if (!ctx->select_signal)
+        return;
+
+    bool should_signal = false;
+    for (size_t i = 0; i < MAX_NUM_CHANFD; i++) {
+        int fd = ctx->chanfds[i].fd;
+        if (fd == -1)
+            continue;
+
+        bool select_readable = !!FD_ISSET(fd, &ctx->select_readfds_in);
+        bool select_writable = !!FD_ISSET(fd, &ctx->select_writefds_in);
+        if (select_readable || select_writable) {
+            xsp_chanfd_t* cfd = ctx->chanfds[i].cfd;
+            uint32_t used = ring_used(cfd);
+            if ((select_readable && used > 0) || (select_writable && used < cfd->capacity)) {
+                should_signal = true;
+                break;
+            }
+        }
+    }
+
+    if (should_signal) {
+        // This must be done under `ctx->lock`, since otherwise `cfd_end_select()` may clear (and
+        // the VFS may then delete) the semaphore. Giving a semaphore is OK in a critical section;
+        // any resulting context switch is deferred until the critical section is exited.
+        if (in_isr)
+            esp_vfs_select_triggered_isr(ctx->select_signal, woken);
+        else
+            esp_vfs_select_triggered(ctx->select_signal);
+    }
+}
+
+// Signals select() if still appropriate.
+static void maybe_signal_select(xsp_chanfd_ctx_t* ctx, bool in_isr, BaseType_t* woken) {
+    LOCK(&ctx->lock);
+    maybe_signal_select_locked(ctx, in_isr, woken);
+    UNLOCK(&ctx->lock);
+}
+
+// Wakes up anything waiting for the state to change, after data was written (if `wrote`) or read.
+// Note: The check of the ring state by waiters is done under the lock, so taking the lock here
+// (after the ring was updated) ensures that wake-ups aren't lost.
+static void cfd_signal(xsp_chanfd_t* cfd, bool wrote, bool in_isr) {
+    EventBits_t bit = wrote ? CFD_EVENT_DATA_BIT : CFD_EVENT_SPACE_BIT;
+    BaseType_t woken = pdFALSE;
+
+    LOCK(&cfd->lock);
+    if ((wrote ? cfd->data_waiters : cfd->space_waiters) > 0) {
+        if (in_isr) {
+            // Note: This defers setting the bits to the timer daemon task; `woken` is set if that
+            // task has a higher priority than the interrupted one.
+            xEventGroupSetBitsFromISR(cfd->events, bit, &woken);
+        } else {
+            xEventGroupSetBits(cfd->events, bit);
+        }
+    }
+    // We'll need to grab the global lock, so we need to release the CFD lock.
+    bool select_active = cfd->select_active;
+    UNLOCK(&cfd->lock);
+
+    if (select_active)
+        maybe_signal_select(g_chanfd_ctx, in_isr, &woken);
+
+    // Yield at the end of the ISR, so that the woken task can run immediately instead of at the
+    // next tick.
+    if (in_isr && woken == pdTRUE)
+        portYIELD_FROM_ISR();
+}
+
+// Waits for the given bit (`CFD_EVENT_DATA_BIT` or `CFD_EVENT_SPACE_BIT`), if the ring is still
+// empty or full (respectively). Returns false if the FD was closed. `cfd` must be referenced (but
+// not locked).
+static bool cfd_wait(xsp_chanfd_t* cfd, EventBits_t bit) {
+    bool rv = true;
+    unsigned* waiters = (bit == CFD_EVENT_DATA_BIT) ? &cfd->data_waiters : &cfd->space_waiters;
+
+    LOCK(&cfd->lock);
+    uint32_t used = ring_used(cfd);
+    if (!cfd->closed && ((bit == CFD_EVENT_DATA_BIT) ? used == 0 : used == cfd->capacity)) {
+        (*waiters)++;
+        UNLOCK(&cfd->lock);
+        xEventGroupWaitBits(cfd->events, bit, pdFALSE, pdFALSE, portMAX_DELAY);
+        LOCK(&cfd->lock);
+        (*waiters)--;
+        if (*waiters == 0)
+            xEventGroupClearBits(cfd->events, bit);
+    }
+    if (cfd->closed)
+        rv = false;
+    UNLOCK(&cfd->lock);
+
+    return rv;
+}
+
+static ssize_t cfd_write_p(void* raw_ctx, int fd, const void* buf, size_t count) {
+    // Shouldn't get here from an ISR, since the VFS isn't ISR-safe.
+    assert(!xPortInIsrContext());
+
+    if (count == 0)
+        return 0;
+
+    xsp_chanfd_t* cfd = cfd_lookup(raw_ctx, fd);
+    if (!cfd)
+        return -1;  // errno already set.
+    cfd_ref_locked(cfd);
+    bool nonblock = cfd->nonblock;
+    UNLOCK(&cfd->lock);
+
+    ssize_t rv = 0;
+    for (;;) {
+        size_t n = ring_write(cfd, (const uint8_t*)buf + rv, count - (size_t)rv);
+        if (n > 0) {
+            rv += (ssize_t)n;
+            cfd_signal(cfd, true, false);
+        }
+        if ((size_t)rv == count)
+            break;
+
+        // If nonblocking, fail (or return a short count); else block (until everything is written).
+        if (nonblock) {
+            if (rv == 0) {
+                errno = EAGAIN;
+                rv = -1;
+            }
+            break;
+        }
+        if (!cfd_wait(cfd, CFD_EVENT_SPACE_BIT)) {
+            ESP_LOGE(TAG, "FD closed while blocked in write()");
+            // Like any other use of an FD that's no longer open.
+            errno = EBADF;
+            rv = -1;
+            break;
+        }
+    }
+
+    LOCK(&cfd->lock);
+    cfd_unref_locked(cfd);
+    return rv;
+}
+
+static ssize_t cfd_read_p(void* raw_ctx, int fd, void* buf, size_t count) {
+    // Shouldn't get here from an ISR, since the VFS isn't ISR-safe.
+    assert(!xPortInIsrContext());
+
+    if (count == 0)
+        return 0;
+
+    xsp_chanfd_t* cfd = cfd_lookup(raw_ctx, fd);
+    if (!cfd)
+        return -1;  // errno already set.
+    cfd_ref_locked(cfd);
+    bool nonblock = cfd->nonblock;
+    UNLOCK(&cfd->lock);
+
+    ssize_t rv;
+    for (;;) {
+        size_t n = ring_read(cfd, buf, count);
+        if (n > 0) {
+            rv = (ssize_t)n;
+            cfd_signal(cfd, false, false);
+            break;
+        }
+
+        // If nonblocking, fail; else block.
+        if (nonblock) {
+            errno = EAGAIN;
+            rv = -1;
+            break;
+        }
+        if (!cfd_wait(cfd, CFD_EVENT_DATA_BIT)) {
+            ESP_LOGE(TAG, "FD closed while blocked in read()");
+            // Like any other use of an FD that's no longer open.
+            errno = EBADF;
+            rv = -1;
+            break;
+        }
+    }
+
+    LOCK(&cfd->lock);
+    cfd_unref_locked(cfd);
+    return rv;
+}
+
+static int cfd_close_p(void* raw_ctx, int fd) {
+    // Shouldn't get here from an ISR, since the VFS isn't ISR-safe.
+    assert(!xPortInIsrContext());
+
+    xsp_chanfd_ctx_t* ctx = (xsp_chanfd_ctx_t*)raw_ctx;
+    LOCK(&ctx->lock);
+
+    size_t idx;
+    xsp_chanfd_t* cfd = cfd_lookup_locked(ctx, fd, &idx);
+    if (!cfd) {
+        UNLOCK(&ctx->lock);
+        // Another task may have closed `fd` concurrently.
+        errno = EBADF;
+        return -1;
+    }
+
+    ctx->chanfds[idx].fd = -1;
+    ctx->chanfds[idx].cfd = NULL;
+    UNLOCK(&ctx->lock);
+
+    // This takes the VFS's FD table mutex, so it must not be done under our (spin)locks. Since the
+    // FD is no longer in our table, lookups of it already fail (and the VFS won't reuse the FD
+    // until it's unregistered). The table's reference keeps `cfd` alive.
+    esp_err_t err = esp_vfs_unregister_fd(g_chanfd_vfs_id, fd);
+    if (err != ESP_OK)
+        ESP_LOGE(TAG, "esp_vfs_unregister_fd() failed: %s", esp_err_to_name(err));
+
+    LOCK(&cfd->lock);
+    cfd->closed = true;
+    xEventGroupSetBits(cfd->events, CFD_EVENT_SPACE_BIT | CFD_EVENT_DATA_BIT);
+
+    // This is a caller error, but not a fatal one: the `select()` will just never report this FD.
+    if (cfd->select_active)
+        ESP_LOGE(TAG, "Closing FD while it's being used in select()");
+    cfd->select_active = false;
+
+    cfd_unref_locked(cfd);
+    return 0;
+}
+
+static int cfd_fcntl_p(void* raw_ctx, int fd, int cmd, va_list args) {
+    // Shouldn't get here from an ISR, since the VFS isn't ISR-safe.
+    assert(!xPortInIsrContext());
+
+    xsp_chanfd_t* cfd = cfd_lookup(raw_ctx, fd);
+    if (!cfd)
+        return -1;  // errno already set.
+
+    int rv = -1;
+    switch (cmd) {
+    case F_GETFL:
+        rv = 0;
+        if (cfd->nonblock)
+            rv |= O_NONBLOCK;
+        break;
+
+    case F_SETFL: {
+        int arg = va_arg(args, int);
+        // As on Linux, other flags (e.g., the access mode, which is always read/write) are ignored.
+        cfd->nonblock = !!(arg & O_NONBLOCK);
+        rv = 0;
+        break;
+    }
+
+    default:
+        errno = ENOSYS;
+        break;
+    }
+
+    UNLOCK(&cfd->lock);
+    return rv;
+}
+
+static int cfd_ioctl_p(void* raw_ctx, int fd, int cmd, va_list args) {
+    // Shouldn't get here from an ISR, since the VFS isn't ISR-safe.
+    assert(!xPortInIsrContext());
+
+    xsp_chanfd_t* cfd = cfd_lookup(raw_ctx, fd);
+    if (!cfd)
+        return -1;  // errno already set.
+
+    int rv = -1;
+    switch (cmd) {
+    case XSP_CHANFD_IOCTL_GET_HANDLE: {
+        xsp_chanfd_handle_t* arg = va_arg(args, xsp_chanfd_handle_t*);
+        if (!arg) {
+            errno = EINVAL;
+            break;
+        }
+        *arg = cfd;
+        rv = 0;
+        break;
+    }
+
+    default:
+        errno = EINVAL;
+        break;
+    }
+
+    UNLOCK(&cfd->lock);
+    return rv;
+}
+
+static esp_err_t cfd_start_select(int nfds,
+                                  fd_set* readfds,
+                                  fd_set* writefds,
+                                  fd_set* exceptfds,
+                                  SemaphoreHandle_t* signal_sem) {
+    // Shouldn't get here from an ISR, since the VFS isn't ISR-safe.
+    assert(!xPortInIsrContext());
+
+    // We're only registered with the VFS (in `xsp_chanfd_register()`) after the context is set up.
+    assert(g_chanfd_ctx);
+    if (!signal_sem)
+        return ESP_ERR_INVALID_ARG;
+
+    LOCK(&g_chanfd_ctx->lock);
+
+    if (g_chanfd_ctx->select_signal) {
+        UNLOCK(&g_chanfd_ctx->lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    g_chanfd_ctx->select_signal = signal_sem;
+    if (readfds)
+        g_chanfd_ctx->select_readfds_in = *readfds;
+    else
+        FD_ZERO(&g_chanfd_ctx->select_readfds_in);
+    if (writefds)
+        g_chanfd_ctx->select_writefds_in = *writefds;
+    else
+        FD_ZERO(&g_chanfd_ctx->select_writefds_in);
+    g_chanfd_ctx->select_readfds_out = readfds;
+    g_chanfd_ctx->select_writefds_out = writefds;
+
+    for (size_t i = 0; i < MAX_NUM_CHANFD; i++) {
+        int fd = g_chanfd_ctx->chanfds[i].fd;
+        if (fd == -1)
+            continue;
+
+        bool select_readable = !!FD_ISSET(fd, &g_chanfd_ctx->select_readfds_in);
+        bool select_writable = !!FD_ISSET(fd, &g_chanfd_ctx->select_writefds_in);
+        if (select_readable || select_writable) {
+            xsp_chanfd_t* cfd = g_chanfd_ctx->chanfds[i].cfd;
+            LOCK(&cfd->lock);
+            cfd->select_active = true;
+            UNLOCK(&cfd->lock);
+        }
+    }
+
+    maybe_signal_select_locked(g_chanfd_ctx, false, NULL);
+
+    UNLOCK(&g_chanfd_ctx->lock);
+    return ESP_OK;
+}
+
+static void cfd_end_select() {
+    // Shouldn't get here from an ISR, since the VFS isn't ISR-safe.
+    assert(!xPortInIsrContext());
+
+    assert(g_chanfd_ctx);
+
+    LOCK(&g_chanfd_ctx->lock);
+
+    assert(g_chanfd_ctx->select_signal);
+
+    for (size_t i = 0; i < MAX_NUM_CHANFD; i++) {
+        int fd = g_chanfd_ctx->chanfds[i].fd;
+        if (fd == -1)
+            continue;
+
+        bool select_readable = !!FD_ISSET(fd, &g_chanfd_ctx->select_readfds_in);
+        bool select_writable = !!FD_ISSET(fd, &g_chanfd_ctx->select_writefds_in);
+        if (select_readable || select_writable) {
+            xsp_chanfd_t* cfd = g_chanfd_ctx->chanfds[i].cfd;
+            LOCK(&cfd->lock);
+            uint32_t used = ring_used(cfd);
+            cfd->select_active = false;
+            UNLOCK(&cfd->lock);
+
+            if (select_readable) {
+                if (used > 0)
+                    FD_SET(fd, g_chanfd_ctx->select_readfds_out);
+                else
+                    FD_CLR(fd, g_chanfd_ctx->select_readfds_out);
+            }
+            if (select_writable) {
+                if (used < cfd->capacity)
+                    FD_SET(fd, g_chanfd_ctx->select_writefds_out);
+                else
+                    FD_CLR(fd, g_chanfd_ctx->select_writefds_out);
+            }
+        }
+    }
+
+    g_chanfd_ctx->select_signal = NULL;
+    FD_ZERO(&g_chanfd_ctx->select_readfds_in);
+    FD_ZERO(&g_chanfd_ctx->select_writefds_in);
+    g_chanfd_ctx->select_readfds_out = NULL;
+    g_chanfd_ctx->select_writefds_out = NULL;
+
+    UNLOCK(&g_chanfd_ctx->lock);
+}
+
+void xsp_chanfd_register() {
+    static const esp_vfs_t vfs = {
+            .flags = ESP_VFS_FLAG_CONTEXT_PTR,
+            .write_p = &cfd_write_p,
+            .read_p = &cfd_read_p,
+            .close_p = &cfd_close_p,
+            .fcntl_p = &cfd_fcntl_p,
+            .ioctl_p = &cfd_ioctl_p,
+            .start_select = &cfd_start_select,
+            .end_select = &cfd_end_select,
+    };
+
+    ESP_ERROR_CHECK(!g_chanfd_ctx ? ESP_OK : ESP_FAIL);
+
+    g_chanfd_ctx = (xsp_chanfd_ctx_t*)malloc(sizeof(xsp_chanfd_ctx_t));
+    ESP_ERROR_CHECK(g_chanfd_ctx ? ESP_OK : ESP_ERR_NO_MEM);
+    INIT_LOCK(&g_chanfd_ctx->lock);
+    for (size_t i = 0; i < MAX_NUM_CHANFD; i++) {
+        g_chanfd_ctx->chanfds[i].fd = -1;
+        g_chanfd_ctx->chanfds[i].cfd = NULL;
+    }
+    g_chanfd_ctx->select_signal = NULL;
+    FD_ZERO(&g_chanfd_ctx->select_readfds_in);
+    FD_ZERO(&g_chanfd_ctx->select_writefds_in);
+    g_chanfd_ctx->select_readfds_out = NULL;
+    g_chanfd_ctx->select_writefds_out = NULL;
+
+    ESP_ERROR_CHECK(esp_vfs_register_with_id(&vfs, g_chanfd_ctx, &g_chanfd_vfs_id));
+}
+
+int xsp_chanfd(size_t capacity, int flags) {
+    if (!g_chanfd_ctx) {
+        errno = EFAULT;
+        return -1;
+    }
+    if (capacity == 0 || capacity > MAX_CAPACITY) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // Round up to a power of 2.
+    size_t actual_capacity = 1;
+    while (actual_capacity < capacity)
+        actual_capacity <<= 1;
+
+    xsp_chanfd_t* cfd = (xsp_chanfd_t*)malloc(sizeof(xsp_chanfd_t) + actual_capacity);
+    if (!cfd) {
+        errno = ENOMEM;
+        return -1;
+    }
+    cfd->events = xEventGroupCreate();
+    if (!cfd->events) {
+        free(cfd);
+        errno = ENOMEM;
+        return -1;
+    }
+    INIT_LOCK(&cfd->lock);
+    cfd->refcount = 1;
+    cfd->nonblock = !!(flags & XSP_CHANFD_NONBLOCK);
+    cfd->closed = false;
+    cfd->space_waiters = 0;
+    cfd->data_waiters = 0;
+    cfd->select_active = false;
+    cfd->head = 0;
+    cfd->tail = 0;
+    cfd->capacity = (uint32_t)actual_capacity;
+
+    // This takes the VFS's FD table mutex, so it must not be done under our (spin)locks (see
+    // `cfd_close_p()`). Until the FD is published in our table, lookups of it fail.
+    int fd = -1;
+    esp_err_t err = esp_vfs_register_fd(g_chanfd_vfs_id, &fd);
+    if (err == ESP_OK) {
+        LOCK(&g_chanfd_ctx->lock);
+        size_t idx = 0;
+        for (; idx < MAX_NUM_CHANFD; idx++) {
+            if (g_chanfd_ctx->chanfds[idx].fd == -1)
+                break;
+        }
+        if (idx < MAX_NUM_CHANFD) {
+            g_chanfd_ctx->chanfds[idx].fd = fd;
+            g_chanfd_ctx->chanfds[idx].cfd = cfd;
+        }
+        UNLOCK(&g_chanfd_ctx->lock);
+        if (idx < MAX_NUM_CHANFD)
+            return fd;
+
+        err = ESP_ERR_NO_MEM;  // Our table is full.
+        esp_err_t unregister_err = esp_vfs_unregister_fd(g_chanfd_vfs_id, fd);
+        if (unregister_err != ESP_OK)
+            ESP_LOGE(TAG, "esp_vfs_unregister_fd() failed: %s", esp_err_to_name(unregister_err));
+    }
+
+    vEventGroupDelete(cfd->events);
+    DEINIT_LOCK(&cfd->lock);
+    free(cfd);
+    errno = (err == ESP_ERR_INVALID_ARG) ? EINVAL : ENFILE;
+    return -1;
+}
+
+size_t xsp_chanfd_write(xsp_chanfd_handle_t cfd, const void* buf, size_t count) {
+    size_t n = ring_write(cfd, buf, count);
+    if (n > 0)
+        cfd_signal(cfd, true, !!xPortInIsrContext());
+    return n;
+}
+
+size_t xsp_chanfd_acquire_read(xsp_chanfd_handle_t cfd, const void** data) {
+    return ring_acquire_read(cfd, data);
+}
+
+void xsp_chanfd_release_read(xsp_chanfd_handle_t cfd, size_t count) {
+    if (count == 0)
+        return;
+    ring_release_read(cfd, count);
+    cfd_signal(cfd, false, !!xPortInIsrContext());
+}
@@ -14,7 +14,10 @@ namespace xsp {
 
 class Loop final {
 public:
-    explicit Loop(LoopEventHandler* loop_event_handler, size_t task_queue_size = 0);
+    // `config` may be null, in which case the default configuration is used.
+    explicit Loop(LoopEventHandler* loop_event_handler,
+                  size_t task_queue_size = 0,
+                  const xsp_loop_config_t* config = nullptr);
     ~Loop();
 
     // Copy and move not supported.
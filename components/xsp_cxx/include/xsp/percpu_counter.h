@@ -0,0 +1,42 @@
+// Copyright 2019 Tricot Inc.
+// Use of this source code is governed by the license in the LICENSE file.
+
+#ifndef XSP_CXX_INCLUDE_XSP_PERCPU_COUNTER_H_
+#define XSP_CXX_INCLUDE_XSP_PERCPU_COUNTER_H_
+
+#include <stdint.h>
+
+#include "xsp_percpu_counter.h"
+
+namespace xsp {
+
+// A wrapper around `xsp_percpu_counter_t`, with (some of) the ergonomics of
+// `std::atomic<uint64_t>`. Adding is cheap, but loading is relatively expensive (see
+// xsp_percpu_counter.h). Note that unlike `std::atomic`, adding doesn't return the previous value.
+class PercpuCounter final {
+public:
+    PercpuCounter() { xsp_percpu_counter_init(&counter_); }
+    ~PercpuCounter() = default;
+
+    // Copy and move not supported.
+    PercpuCounter(const PercpuCounter&) = delete;
+    PercpuCounter& operator=(const PercpuCounter&) = delete;
+
+    void Add(uint64_t delta) { xsp_percpu_counter_add(&counter_, delta); }
+    uint64_t Load() const { return xsp_percpu_counter_read(&counter_); }
+
+    // `std::atomic`-like operators.
+    void operator+=(uint64_t delta) { Add(delta); }
+    void operator++() { Add(1); }
+    void operator++(int) { Add(1); }
+    operator uint64_t() const { return Load(); }
+
+    xsp_percpu_counter_t* handle() { return &counter_; }
+
+private:
+    xsp_percpu_counter_t counter_;
+};
+
+}  // namespace xsp
+
+#endif  // XSP_CXX_INCLUDE_XSP_PERCPU_COUNTER_H_
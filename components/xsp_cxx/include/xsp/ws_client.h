@@ -11,6 +11,8 @@
 
 #include "xsp_ws_client.h"
 
+#include "xsp/loop.h"
+
 namespace xsp {
 
 // A thin wrapper around xsp_ws_client.
@@ -36,10 +38,12 @@ public:
 
     void Shutdown() {
         if (handle_) {
-            auto success = Close();
-            assert(success);
+            // Closing fails if an asynchronous open was canceled (the client is then closed, and
+            // freed, once the open task is done).
+            auto err = xsp_ws_client_close(handle_);
+            assert(err == ESP_OK || err == ESP_ERR_INVALID_STATE);
 
-            auto err = xsp_ws_client_cleanup(handle_);
+            err = xsp_ws_client_cleanup(handle_);
             assert(err == ESP_OK);
 
             handle_ = nullptr;
@@ -47,7 +51,28 @@ public:
     }
 
     bool Open() { return xsp_ws_client_open(handle_) == ESP_OK; }
+    // See xsp_ws_client_open_async(). The client must not be used until `on_open` is called (or
+    // the open is canceled); it may be destroyed (which cancels the open) before the loop is.
+    bool OpenAsync(Loop* loop, xsp_ws_client_on_open_func_t on_open, void* ctx) {
+        return xsp_ws_client_open_async(handle_, loop->handle(), on_open, ctx) == ESP_OK;
+    }
+    // See xsp_ws_client_cancel_open_async().
+    bool CancelOpenAsync() { return xsp_ws_client_cancel_open_async(handle_) == ESP_OK; }
     bool Close() { return xsp_ws_client_close(handle_) == ESP_OK; }
+    // See xsp_ws_client_close_async(). The client must not be used (or destroyed) until `on_closed`
+    // is called.
+    bool CloseAsync(Loop* loop, xsp_ws_client_on_closed_func_t on_closed, void* ctx) {
+        return xsp_ws_client_close_async(handle_, loop->handle(), on_closed, ctx) == ESP_OK;
+    }
+
+    // See xsp_ws_client_set_cork(), xsp_ws_client_flush(), and xsp_ws_client_flush_nonblocking().
+    // FlushNonblocking() returns false only on error (like WriteFrameNonblocking() below).
+    void SetCork(bool corked) { xsp_ws_client_set_cork(handle_, corked); }
+    bool Flush(int timeout_ms) { return xsp_ws_client_flush(handle_, timeout_ms) == ESP_OK; }
+    bool FlushNonblocking() {
+        auto err = xsp_ws_client_flush_nonblocking(handle_);
+        return err == ESP_OK || err == ESP_ERR_TIMEOUT;
+    }
 
     bool PollWrite(int timeout_ms) {
         return xsp_ws_client_poll_write(handle_, timeout_ms) != ESP_ERR_TIMEOUT;
@@ -60,6 +85,40 @@ public:
         return xsp_ws_client_write_frame(handle_, fin, opcode, static_cast<int>(payload_size),
                                          payload, timeout_ms) == ESP_OK;
     }
+    // See xsp_ws_client_write_frame_in_place(): the payload must be at
+    // `buffer + XSP_WS_CLIENT_FRAME_HEADROOM`, and `buffer` is modified.
+    bool WriteFrameInPlace(bool fin,
+                           xsp_ws_frame_opcode_t opcode,
+                           size_t payload_size,
+                           void* buffer,
+                           int timeout_ms) {
+        return xsp_ws_client_write_frame_in_place(handle_, fin, opcode,
+                                                  static_cast<int>(payload_size), buffer,
+                                                  timeout_ms) == ESP_OK;
+    }
+    // See xsp_ws_client_write_frame_nonblocking() and xsp_ws_client_continue_write(). These return
+    // false only on error; use HasPendingWrite() to tell if the frame was completely written.
+    bool WriteFrameNonblocking(bool fin,
+                               xsp_ws_frame_opcode_t opcode,
+                               size_t payload_size,
+                               const void* payload) {
+        auto err = xsp_ws_client_write_frame_nonblocking(handle_, fin, opcode,
+                                                         static_cast<int>(payload_size), payload);
+        return err == ESP_OK || err == ESP_ERR_TIMEOUT;
+    }
+    bool WriteFrameInPlaceNonblocking(bool fin,
+                                      xsp_ws_frame_opcode_t opcode,
+                                      size_t payload_size,
+                                      void* buffer) {
+        auto err = xsp_ws_client_write_frame_in_place_nonblocking(
+                handle_, fin, opcode, static_cast<int>(payload_size), buffer);
+        return err == ESP_OK || err == ESP_ERR_TIMEOUT;
+    }
+    bool ContinueWrite() {
+        auto err = xsp_ws_client_continue_write(handle_);
+        return err == ESP_OK || err == ESP_ERR_TIMEOUT;
+    }
+    bool HasPendingWrite() { return xsp_ws_client_has_pending_write(handle_); }
     bool WriteCloseFrame(int status, const char* reason, int timeout_ms) {
         return xsp_ws_client_write_close_frame(handle_, status, reason, timeout_ms) == ESP_OK;
     }
@@ -81,6 +140,45 @@ public:
         return rv;
     }
 
+    // See xsp_ws_client_read_frame_view(). Returns ESP_ERR_INVALID_SIZE (without consuming the
+    // frame) if the frame doesn't fit in the client's read buffer, or ESP_ERR_TIMEOUT if it isn't
+    // completely available in time (the read may then be retried).
+    esp_err_t ReadFrameView(bool* fin,
+                            xsp_ws_frame_opcode_t* opcode,
+                            const void** payload,
+                            size_t* payload_size,
+                            int timeout_ms) {
+        int payload_size2 = 0;
+        auto err = xsp_ws_client_read_frame_view(handle_, fin, opcode, payload, &payload_size2,
+                                                 timeout_ms);
+        *payload_size = static_cast<size_t>(payload_size2);
+        return err;
+    }
+
+    // See xsp_ws_client_read_frame_chunk(). Returns ESP_ERR_TIMEOUT if no data is available in time
+    // (the read may then be retried).
+    esp_err_t ReadFrameChunk(bool* fin,
+                             xsp_ws_frame_opcode_t* opcode,
+                             size_t* payload_size,
+                             size_t* chunk_offset,
+                             size_t chunk_buffer_size,
+                             void* chunk_buffer,
+                             size_t* chunk_size,
+                             bool* last_chunk,
+                             int timeout_ms) {
+        int payload_size2 = 0;
+        int chunk_offset2 = 0;
+        int chunk_size2 = 0;
+        auto err = xsp_ws_client_read_frame_chunk(
+                handle_, fin, opcode, &payload_size2, &chunk_offset2,
+                static_cast<int>(chunk_buffer_size), chunk_buffer, &chunk_size2, last_chunk,
+                timeout_ms);
+        *payload_size = static_cast<size_t>(payload_size2);
+        *chunk_offset = static_cast<size_t>(chunk_offset2);
+        *chunk_size = static_cast<size_t>(chunk_size2);
+        return err;
+    }
+
     const char* response_subprotocols() { return xsp_ws_client_get_response_subprotocols(handle_); }
 
     xsp_ws_client_handle_t handle() { return handle_; }
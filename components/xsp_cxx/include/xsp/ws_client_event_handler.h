@@ -6,6 +6,7 @@
 
 #include <stddef.h>
 
+#include "xsp_ws_client_handler.h"
 #include "xsp_ws_client_types.h"
 
 namespace xsp {
@@ -22,6 +23,21 @@ public:
     virtual void OnWsClientPingReceived(size_t payload_size, const void* payload) {}
     virtual void OnWsClientPongReceived(size_t payload_size, const void* payload) {}
     virtual void OnWsClientMessageSent(bool success) {}
+    // Called for each chunk of a data frame that's too big to be read in its entirety. Should
+    // return true if handled; if it returns false (as the default does), the connection is closed
+    // with status 1009 (message too big).
+    virtual bool OnWsClientDataFrameChunkReceived(bool fin,
+                                                  xsp_ws_frame_opcode_t opcode,
+                                                  size_t payload_size,
+                                                  size_t chunk_offset,
+                                                  size_t chunk_size,
+                                                  const void* chunk,
+                                                  bool last_chunk) {
+        return false;
+    }
+    // Called when the connection state changes (only if automatic reconnection is enabled).
+    virtual void OnWsClientConnectionStateChanged(xsp_ws_client_handler_connection_state_t state,
+                                                  int status) {}
 
 protected:
     WsClientEventHandler() = default;
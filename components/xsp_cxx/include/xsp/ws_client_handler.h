@@ -30,9 +30,24 @@ public:
     void Shutdown();
 
     bool SendMessage(bool binary, size_t message_size, const void* message);
+    // See xsp_ws_client_handler_send_message_with_callback().
+    bool SendMessage(bool binary,
+                     size_t message_size,
+                     const void* message,
+                     on_ws_client_message_sent_func_t on_sent,
+                     void* on_sent_ctx);
+    // See xsp_ws_client_handler_send_streamed_message().
+    bool SendStreamedMessage(bool binary,
+                             xsp_ws_client_handler_producer_func_t producer,
+                             void* producer_ctx,
+                             on_ws_client_message_sent_func_t on_sent,
+                             void* on_sent_ctx);
+    bool ResumeStreamedMessage();
     bool Close(int close_status);
     bool Ping(size_t payload_size, const void* payload);
 
+    xsp_ws_client_handler_send_queue_stats_t GetSendQueueStats();
+
     WsClientEventHandler* ws_client_event_handler() const { return evt_handler_; }
     void set_ws_client_event_handler(WsClientEventHandler* ws_client_event_handler) {
         evt_handler_ = ws_client_event_handler;
@@ -70,6 +85,29 @@ private:
     static void OnMessageSentThunk(xsp_ws_client_handler_handle_t handler, void* ctx, bool success);
     void OnMessageSent(bool success);
 
+    static void OnDataFrameChunkReceivedThunk(xsp_ws_client_handler_handle_t handler,
+                                              void* ctx,
+                                              bool fin,
+                                              xsp_ws_frame_opcode_t opcode,
+                                              int payload_size,
+                                              int chunk_offset,
+                                              int chunk_size,
+                                              const void* chunk,
+                                              bool last_chunk);
+    void OnDataFrameChunkReceived(bool fin,
+                                  xsp_ws_frame_opcode_t opcode,
+                                  int payload_size,
+                                  int chunk_offset,
+                                  int chunk_size,
+                                  const void* chunk,
+                                  bool last_chunk);
+
+    static void OnConnectionStateChangedThunk(xsp_ws_client_handler_handle_t handler,
+                                              void* ctx,
+                                              xsp_ws_client_handler_connection_state_t state,
+                                              int status);
+    void OnConnectionStateChanged(xsp_ws_client_handler_connection_state_t state, int status);
+
     WsClient ws_client_;
     xsp_ws_client_handler_handle_t handle_ = nullptr;
     WsClientEventHandler* evt_handler_ = nullptr;
@@ -14,11 +14,13 @@
 
 namespace xsp {
 
-Loop::Loop(LoopEventHandler* loop_event_handler, size_t task_queue_size)
+Loop::Loop(LoopEventHandler* loop_event_handler,
+           size_t task_queue_size,
+           const xsp_loop_config_t* config)
         : loop_event_handler_(loop_event_handler) {
     xsp_loop_event_handler_t loop_evt_handler = {&Loop::OnLoopStartThunk, &Loop::OnLoopStopThunk,
                                                  &Loop::OnLoopIdleThunk, this};
-    handle_ = xsp_loop_init(nullptr, &loop_evt_handler);
+    handle_ = xsp_loop_init(config, &loop_evt_handler);
     assert(handle_);
 
     if (task_queue_size > 0) {
@@ -19,7 +19,9 @@ WsClientHandler::WsClientHandler(const xsp_ws_client_handler_config_t* config,
     xsp_ws_client_event_handler_t evt_handler_thunks = {
             &WsClientHandler::OnClosedThunk,       &WsClientHandler::OnDataFrameReceivedThunk,
             &WsClientHandler::OnPingReceivedThunk, &WsClientHandler::OnPongReceivedThunk,
-            &WsClientHandler::OnMessageSentThunk,  this};
+            &WsClientHandler::OnMessageSentThunk,  &WsClientHandler::OnDataFrameChunkReceivedThunk,
+            &WsClientHandler::OnConnectionStateChangedThunk,
+            this};
     handle_ = xsp_ws_client_handler_init(config, &evt_handler_thunks, ws_client_.handle(),
                                          loop->handle());
     assert(handle_);
@@ -45,6 +47,29 @@ bool WsClientHandler::SendMessage(bool binary, size_t message_size, const void*
                                               message) == ESP_OK;
 }
 
+bool WsClientHandler::SendMessage(bool binary,
+                                  size_t message_size,
+                                  const void* message,
+                                  on_ws_client_message_sent_func_t on_sent,
+                                  void* on_sent_ctx) {
+    return xsp_ws_client_handler_send_message_with_callback(handle_, binary,
+                                                            static_cast<int>(message_size), message,
+                                                            on_sent, on_sent_ctx) == ESP_OK;
+}
+
+bool WsClientHandler::SendStreamedMessage(bool binary,
+                                          xsp_ws_client_handler_producer_func_t producer,
+                                          void* producer_ctx,
+                                          on_ws_client_message_sent_func_t on_sent,
+                                          void* on_sent_ctx) {
+    return xsp_ws_client_handler_send_streamed_message(handle_, binary, producer, producer_ctx,
+                                                       on_sent, on_sent_ctx) == ESP_OK;
+}
+
+bool WsClientHandler::ResumeStreamedMessage() {
+    return xsp_ws_client_handler_resume_streamed_message(handle_) == ESP_OK;
+}
+
 bool WsClientHandler::Close(int close_status) {
     return xsp_ws_client_handler_close(handle_, close_status) == ESP_OK;
 }
@@ -53,6 +78,13 @@ bool WsClientHandler::Ping(size_t payload_size, const void* payload) {
     return xsp_ws_client_handler_ping(handle_, static_cast<int>(payload_size), payload) == ESP_OK;
 }
 
+xsp_ws_client_handler_send_queue_stats_t WsClientHandler::GetSendQueueStats() {
+    xsp_ws_client_handler_send_queue_stats_t stats = {};
+    auto err = xsp_ws_client_handler_get_send_queue_stats(handle_, &stats);
+    assert(err == ESP_OK);
+    return stats;
+}
+
 // static
 void WsClientHandler::OnClosedThunk(xsp_ws_client_handler_handle_t handler, void* ctx, int status) {
     static_cast<WsClientHandler*>(ctx)->OnClosed(status);
@@ -121,4 +153,50 @@ void WsClientHandler::OnMessageSent(bool success) {
         evt_handler_->OnWsClientMessageSent(success);
 }
 
+// static
+void WsClientHandler::OnDataFrameChunkReceivedThunk(xsp_ws_client_handler_handle_t handler,
+                                                    void* ctx,
+                                                    bool fin,
+                                                    xsp_ws_frame_opcode_t opcode,
+                                                    int payload_size,
+                                                    int chunk_offset,
+                                                    int chunk_size,
+                                                    const void* chunk,
+                                                    bool last_chunk) {
+    static_cast<WsClientHandler*>(ctx)->OnDataFrameChunkReceived(
+            fin, opcode, payload_size, chunk_offset, chunk_size, chunk, last_chunk);
+}
+
+void WsClientHandler::OnDataFrameChunkReceived(bool fin,
+                                               xsp_ws_frame_opcode_t opcode,
+                                               int payload_size,
+                                               int chunk_offset,
+                                               int chunk_size,
+                                               const void* chunk,
+                                               bool last_chunk) {
+    if (evt_handler_ &&
+        evt_handler_->OnWsClientDataFrameChunkReceived(
+                fin, opcode, static_cast<size_t>(payload_size), static_cast<size_t>(chunk_offset),
+                static_cast<size_t>(chunk_size), chunk, last_chunk)) {
+        return;
+    }
+    // Not handled, so reject the frame, as the C API does without a chunk event handler (closing
+    // the connection with status 1009, but still reconnecting if enabled).
+    xsp_ws_client_handler_reject_frame(handle_);
+}
+
+// static
+void WsClientHandler::OnConnectionStateChangedThunk(xsp_ws_client_handler_handle_t handler,
+                                                    void* ctx,
+                                                    xsp_ws_client_handler_connection_state_t state,
+                                                    int status) {
+    static_cast<WsClientHandler*>(ctx)->OnConnectionStateChanged(state, status);
+}
+
+void WsClientHandler::OnConnectionStateChanged(xsp_ws_client_handler_connection_state_t state,
+                                               int status) {
+    if (evt_handler_)
+        evt_handler_->OnWsClientConnectionStateChanged(state, status);
+}
+
 }  // namespace xsp
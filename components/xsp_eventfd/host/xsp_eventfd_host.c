@@ -0,0 +1,240 @@
+// Copyright 2019 Tricot Inc.
+// Use of this source code is governed by the license in the LICENSE file.
+
+// Host (Linux) implementation of xsp_eventfd.h, on top of the native eventfd(2). This is not built
+// for the ESP32; see README.md.
+//
+// The native event FD is always opened in nonblocking mode (so that `xsp_eventfd_write()` never
+// blocks), and blocking mode and bitmask mode are emulated on top of it. Since we can't hook into
+// the VFS the way ESP-IDF lets us, this requires linking with
+// `-Wl,--wrap=read,--wrap=write,--wrap=fcntl,--wrap=close,--wrap=ioctl`.
+//
+// In bitmask mode, the value is kept here, and the native event FD is only used to signal
+// readiness: it is made nonzero whenever the value goes from zero to nonzero, and drained on read.
+// (Thus `select()`/`poll()` may spuriously report a bitmask event FD as readable if it races with a
+// read, but never misses a write.)
+
+#ifndef XSP_EVENTFD_HOST
+#error "XSP_EVENTFD_HOST must be defined"
+#endif
+
+#include "xsp_eventfd.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+// Handles are just pointers into this table (indexed by FD).
+#define MAX_FD 1024
+
+struct xsp_eventfd_struct {
+    int fd;
+    bool in_use;    // Set while `fd` is from `xsp_eventfd()` (accessed atomically).
+    bool nonblock;  // The emulated `O_NONBLOCK` (accessed atomically).
+    bool bitmask;
+    uint64_t bits;  // The value, in bitmask mode (accessed atomically).
+};
+
+static struct xsp_eventfd_struct g_handles[MAX_FD];
+
+ssize_t __real_read(int fd, void* buf, size_t count);
+ssize_t __real_write(int fd, const void* buf, size_t count);
+int __real_fcntl(int fd, int cmd, ...);
+int __real_close(int fd);
+int __real_ioctl(int fd, unsigned long request, ...);
+
+static struct xsp_eventfd_struct* efd_lookup(int fd) {
+    if (fd < 0 || fd >= MAX_FD || !__atomic_load_n(&g_handles[fd].in_use, __ATOMIC_ACQUIRE))
+        return NULL;
+    return &g_handles[fd];
+}
+
+// Waits until the (native, nonblocking) FD may be ready for `events`.
+static void efd_wait(int fd, short events) {
+    struct pollfd pfd = {.fd = fd, .events = events, .revents = 0};
+    poll(&pfd, 1, -1);
+}
+
+// Bitmask mode: ORs `to_add` into the value. Never blocks.
+static void efd_bitmask_or(struct xsp_eventfd_struct* efd, uint64_t to_add) {
+    if (__atomic_fetch_or(&efd->bits, to_add, __ATOMIC_SEQ_CST) == 0) {
+        // The value was zero, so signal readiness. This can't overflow the native value, since each
+        // write of 1 is preceded by the value going from zero to nonzero, which requires a read.
+        uint64_t one = 1;
+        __real_write(efd->fd, &one, sizeof(one));
+    }
+}
+
+// Bitmask mode: reads and clears the value (blocking if it's zero, unless nonblocking).
+static ssize_t efd_bitmask_read(struct xsp_eventfd_struct* efd, void* buf, size_t count) {
+    if (count < 8) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    for (;;) {
+        // Drain before taking the value, so that a write racing with this leaves the native event
+        // FD readable.
+        uint64_t unused;
+        __real_read(efd->fd, &unused, sizeof(unused));
+        uint64_t value = __atomic_exchange_n(&efd->bits, 0, __ATOMIC_SEQ_CST);
+        if (value) {
+            memcpy(buf, &value, 8);
+            return 8;
+        }
+        if (__atomic_load_n(&efd->nonblock, __ATOMIC_RELAXED)) {
+            errno = EAGAIN;
+            return -1;
+        }
+        efd_wait(efd->fd, POLLIN);
+    }
+}
+
+void xsp_eventfd_register() {}
+
+int xsp_eventfd(unsigned initval, int flags) {
+    if ((flags & ~(XSP_EVENTFD_NONBLOCK | XSP_EVENTFD_BITMASK))) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    bool bitmask = !!(flags & XSP_EVENTFD_BITMASK);
+    int fd = eventfd((bitmask && initval) ? 1 : initval, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (fd < 0)
+        return -1;  // errno already set.
+    if (fd >= MAX_FD) {
+        __real_close(fd);
+        errno = EMFILE;
+        return -1;
+    }
+
+    struct xsp_eventfd_struct* efd = &g_handles[fd];
+    efd->fd = fd;
+    efd->nonblock = !!(flags & XSP_EVENTFD_NONBLOCK);
+    efd->bitmask = bitmask;
+    efd->bits = bitmask ? initval : 0;
+    __atomic_store_n(&efd->in_use, true, __ATOMIC_RELEASE);
+    return fd;
+}
+
+ssize_t __wrap_read(int fd, void* buf, size_t count) {
+    struct xsp_eventfd_struct* efd = efd_lookup(fd);
+    if (!efd)
+        return __real_read(fd, buf, count);
+    if (efd->bitmask)
+        return efd_bitmask_read(efd, buf, count);
+
+    for (;;) {
+        ssize_t rv = __real_read(fd, buf, count);
+        if (rv >= 0 || errno != EAGAIN || __atomic_load_n(&efd->nonblock, __ATOMIC_RELAXED))
+            return rv;
+        efd_wait(fd, POLLIN);
+    }
+}
+
+ssize_t __wrap_write(int fd, const void* buf, size_t count) {
+    struct xsp_eventfd_struct* efd = efd_lookup(fd);
+    if (!efd)
+        return __real_write(fd, buf, count);
+
+    if (efd->bitmask) {
+        if (count < 8) {
+            errno = EINVAL;
+            return -1;
+        }
+        // In bitmask mode, all bits may be set at once.
+        uint64_t to_add;
+        memcpy(&to_add, buf, 8);
+        if (to_add != 0)
+            efd_bitmask_or(efd, to_add);
+        return 8;
+    }
+
+    for (;;) {
+        ssize_t rv = __real_write(fd, buf, count);
+        if (rv >= 0 || errno != EAGAIN || __atomic_load_n(&efd->nonblock, __ATOMIC_RELAXED))
+            return rv;
+        efd_wait(fd, POLLOUT);
+    }
+}
+
+int __wrap_fcntl(int fd, int cmd, ...) {
+    va_list args;
+    va_start(args, cmd);
+    void* arg = va_arg(args, void*);
+    va_end(args);
+
+    struct xsp_eventfd_struct* efd = efd_lookup(fd);
+    if (!efd || (cmd != F_GETFL && cmd != F_SETFL))
+        return __real_fcntl(fd, cmd, arg);
+
+    // Report and set the emulated `O_NONBLOCK`, keeping the native event FD nonblocking.
+    if (cmd == F_GETFL) {
+        int rv = __real_fcntl(fd, F_GETFL);
+        if (rv == -1)
+            return -1;
+        rv &= ~O_NONBLOCK;
+        if (__atomic_load_n(&efd->nonblock, __ATOMIC_RELAXED))
+            rv |= O_NONBLOCK;
+        return rv;
+    }
+
+    int flags = (int)(intptr_t)arg;
+    int rv = __real_fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    if (rv == 0)
+        __atomic_store_n(&efd->nonblock, !!(flags & O_NONBLOCK), __ATOMIC_RELAXED);
+    return rv;
+}
+
+int __wrap_close(int fd) {
+    struct xsp_eventfd_struct* efd = efd_lookup(fd);
+    if (efd)
+        __atomic_store_n(&efd->in_use, false, __ATOMIC_RELEASE);
+    return __real_close(fd);
+}
+
+int __wrap_ioctl(int fd, unsigned long request, ...) {
+    va_list args;
+    va_start(args, request);
+    void* arg = va_arg(args, void*);
+    va_end(args);
+
+    if (request != XSP_EVENTFD_IOCTL_GET_HANDLE)
+        return __real_ioctl(fd, request, arg);
+
+    struct xsp_eventfd_struct* efd = efd_lookup(fd);
+    if (!efd || !arg) {
+        errno = EINVAL;
+        return -1;
+    }
+    *(xsp_eventfd_handle_t*)arg = efd;
+    return 0;
+}
+
+bool xsp_eventfd_write(xsp_eventfd_handle_t efd, uint64_t to_add) {
+    // Assume everything is kosher if `to_add` is 0.
+    if (to_add == 0)
+        return true;
+    if (efd->bitmask) {
+        efd_bitmask_or(efd, to_add);
+        return true;
+    }
+    if (to_add == (uint64_t)-1)
+        return false;
+
+    // The native event FD is nonblocking, so this fails (instead of blocking) on overflow.
+    return __real_write(efd->fd, &to_add, sizeof(to_add)) == (ssize_t)sizeof(to_add);
+}
+
+bool xsp_eventfd_can_read(xsp_eventfd_handle_t efd) {
+    if (efd->bitmask)
+        return __atomic_load_n(&efd->bits, __ATOMIC_SEQ_CST) != 0;
+
+    struct pollfd pfd = {.fd = efd->fd, .events = POLLIN, .revents = 0};
+    return poll(&pfd, 1, 0) == 1 && (pfd.revents & POLLIN);
+}
@@ -7,6 +7,12 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+// `XSP_EVENTFD_HOST` is defined when building the host (Linux) implementation (see host/).
+#ifndef XSP_EVENTFD_HOST
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -14,6 +20,11 @@ extern "C" {
 // TODO(vtl)
 // #define XSP_EVENTFD_SEMAPHORE 1
 #define XSP_EVENTFD_NONBLOCK 2
+// Bitmask mode: writes bitwise-OR the written value into the event FD's value (instead of adding
+// it), so writes never block (and all 64 bits may be written). As usual, a read returns the value
+// and resets it to 0, so the reader gets (and clears) the set of bits written since the last read.
+// This allows up to 64 independent sources to signal a single FD.
+#define XSP_EVENTFD_BITMASK 4
 
 #define XSP_EVENTFD_IOCTL_BASE (0x45464400)  // (Big-endian) 'E', 'F', 'D', ....
 
@@ -28,9 +39,21 @@ int xsp_eventfd(unsigned initval, int flags);
 typedef struct xsp_eventfd_struct* xsp_eventfd_handle_t;
 
 // Like using `write()`, but may be called from an ISR and never blocks. Returns true on success
-// (false if it would block).
+// (false if it would block, which never happens in bitmask mode).
 bool xsp_eventfd_write(xsp_eventfd_handle_t efd, uint64_t to_add);
 
+// Returns true if the event FD can be read from without blocking (i.e., its value is nonzero). May
+// be called from an ISR.
+bool xsp_eventfd_can_read(xsp_eventfd_handle_t efd);
+
+#ifndef XSP_EVENTFD_HOST
+// Sets a task to be notified (using `xTaskNotifyGive()`, or `vTaskNotifyGiveFromISR()` from an ISR)
+// whenever the value is increased; `task` may be null to stop notifications. This allows a task to
+// wait on event FDs using `ulTaskNotifyTake()` instead of `select()`. Note that the task's
+// notification value is shared with any other users of task notifications for that task.
+void xsp_eventfd_set_notify_task(xsp_eventfd_handle_t efd, TaskHandle_t task);
+#endif
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif
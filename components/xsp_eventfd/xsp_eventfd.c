@@ -18,6 +18,7 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
 #include "freertos/portmacro.h"
+#include "freertos/task.h"
 
 #include "sdkconfig.h"
 
@@ -45,6 +46,7 @@ typedef struct xsp_eventfd_struct {
     unsigned refcount;
     uint64_t value;
     bool nonblock;
+    bool bitmask;  // If set, writes OR into the value (and never block).
     bool closed;
 
     EventGroupHandle_t events;
@@ -52,6 +54,8 @@ typedef struct xsp_eventfd_struct {
     unsigned inc_waiters;  // Number of things waiting for the value to increase.
 
     bool select_active;
+
+    TaskHandle_t notify_task;  // Task to notify when the value increases (may be null).
 } xsp_eventfd_t;
 
 typedef struct xsp_eventfd_ctx {
@@ -92,6 +96,23 @@ static void efd_unref_locked(xsp_eventfd_t* efd) {
     }
 }
 
+// Returns true if `to_add` can be written without blocking.
+static bool efd_can_write_locked(xsp_eventfd_t* efd, uint64_t to_add) {
+    return efd->bitmask || efd->value + to_add >= efd->value;
+}
+
+// Returns true if the event FD is writable (in the sense of `select()`).
+static bool efd_is_writable_locked(xsp_eventfd_t* efd) {
+    return efd->bitmask || efd->value < (uint64_t)-1;
+}
+
+static void efd_add_locked(xsp_eventfd_t* efd, uint64_t to_add) {
+    if (efd->bitmask)
+        efd->value |= to_add;
+    else
+        efd->value += to_add;
+}
+
 static xsp_eventfd_t* efd_lookup_locked(xsp_eventfd_ctx_t* ctx, int fd, size_t* idx) {
     if (fd < 0)
         return NULL;
@@ -141,10 +162,11 @@ static void maybe_signal_select_locked(xsp_eventfd_ctx_t* ctx, bool in_isr) {
         if (select_readable || select_writable) {
             xsp_eventfd_t* efd = g_eventfd_ctx->eventfds[i].efd;
             LOCK(&efd->lock);
-            uint64_t value = efd->value;
+            bool readable = efd->value > 0;
+            bool writable = efd_is_writable_locked(efd);
             UNLOCK(&efd->lock);
 
-            if ((select_readable && value > 0) || (select_writable && value < (uint64_t)-1)) {
+            if ((select_readable && readable) || (select_writable && writable)) {
                 should_signal = true;
                 break;
             }
@@ -181,10 +203,6 @@ static ssize_t efd_write_p(void* raw_ctx, int fd, const void* buf, size_t count)
 
     uint64_t to_add;
     memcpy(&to_add, buf, 8);
-    if (to_add == (uint64_t)-1) {
-        errno = EINVAL;
-        return -1;
-    }
 
     // Assume everything is kosher if `to_add` is 0.
     if (to_add == 0)
@@ -193,9 +211,17 @@ static ssize_t efd_write_p(void* raw_ctx, int fd, const void* buf, size_t count)
     xsp_eventfd_t* efd = efd_lookup(raw_ctx, fd);
     if (!efd)
         return -1;  // errno already set.
+
+    // In bitmask mode, all bits may be set at once.
+    if (to_add == (uint64_t)-1 && !efd->bitmask) {
+        UNLOCK(&efd->lock);
+        errno = EINVAL;
+        return -1;
+    }
+
     efd_ref_locked(efd);
 
-    while (efd->value + to_add < efd->value) {
+    while (!efd_can_write_locked(efd, to_add)) {
         // Overflow. If nonblocking, fail; else block.
         if (efd->nonblock) {
             efd_unref_locked(efd);
@@ -218,15 +244,18 @@ static ssize_t efd_write_p(void* raw_ctx, int fd, const void* buf, size_t count)
             xEventGroupClearBits(efd->events, EFD_EVENT_DEC_BIT);
     }
 
-    efd->value += to_add;
+    efd_add_locked(efd, to_add);
 
     if (efd->inc_waiters > 0)
         xEventGroupSetBits(efd->events, EFD_EVENT_INC_BIT);
 
     // We'll need to grab the global lock, so we need to release the EFD lock.
     bool select_active = efd->select_active;
+    TaskHandle_t notify_task = efd->notify_task;
     efd_unref_locked(efd);
 
+    if (notify_task)
+        xTaskNotifyGive(notify_task);
     if (select_active)
         maybe_signal_select(raw_ctx, false);
 
@@ -457,18 +486,19 @@ static void efd_end_select() {
         if (select_readable || select_writable) {
             xsp_eventfd_t* efd = g_eventfd_ctx->eventfds[i].efd;
             LOCK(&efd->lock);
-            uint64_t value = efd->value;
+            bool readable = efd->value > 0;
+            bool writable = efd_is_writable_locked(efd);
             efd->select_active = false;
             UNLOCK(&efd->lock);
 
             if (select_readable) {
-                if (value > 0)
+                if (readable)
                     FD_SET(fd, g_eventfd_ctx->select_readfds_out);
                 else
                     FD_CLR(fd, g_eventfd_ctx->select_readfds_out);
             }
             if (select_writable) {
-                if (value < (uint64_t)-1)
+                if (writable)
                     FD_SET(fd, g_eventfd_ctx->select_writefds_out);
                 else
                     FD_CLR(fd, g_eventfd_ctx->select_writefds_out);
@@ -537,10 +567,12 @@ int xsp_eventfd(unsigned initval, int flags) {
     efd->refcount = 1;
     efd->value = initval;
     efd->nonblock = !!(flags & XSP_EVENTFD_NONBLOCK);
+    efd->bitmask = !!(flags & XSP_EVENTFD_BITMASK);
     efd->closed = false;
     efd->dec_waiters = 0;
     efd->inc_waiters = 0;
     efd->select_active = false;
+    efd->notify_task = NULL;
 
     LOCK(&g_eventfd_ctx->lock);
 
@@ -593,11 +625,11 @@ bool xsp_eventfd_write(xsp_eventfd_handle_t efd, uint64_t to_add) {
     bool in_isr = !!xPortInIsrContext();
 
     LOCK(&efd->lock);
-    if (efd->value + to_add < efd->value) {
+    if (!efd_can_write_locked(efd, to_add)) {
         UNLOCK(&efd->lock);
         return false;
     }
-    efd->value += to_add;
+    efd_add_locked(efd, to_add);
     if (efd->inc_waiters > 0) {
         if (in_isr) {
             // TODO(vtl): Maybe pass pxHigherPriorityTaskWoken and wake it at the end.
@@ -609,9 +641,36 @@ bool xsp_eventfd_write(xsp_eventfd_handle_t efd, uint64_t to_add) {
 
     // We'll need to grab the global lock, so we need to release the EFD lock.
     bool select_active = efd->select_active;
+    TaskHandle_t notify_task = efd->notify_task;
     UNLOCK(&efd->lock);
+
+    if (notify_task) {
+        if (in_isr) {
+            BaseType_t woken = pdFALSE;
+            vTaskNotifyGiveFromISR(notify_task, &woken);
+            // Note: Yielding at the end of the ISR is what makes this path fast, since the notified
+            // task can then run immediately instead of at the next tick.
+            if (woken == pdTRUE)
+                portYIELD_FROM_ISR();
+        } else {
+            xTaskNotifyGive(notify_task);
+        }
+    }
     if (select_active)
         maybe_signal_select(g_eventfd_ctx, in_isr);
 
     return true;
 }
+
+bool xsp_eventfd_can_read(xsp_eventfd_handle_t efd) {
+    LOCK(&efd->lock);
+    bool rv = efd->value > 0;
+    UNLOCK(&efd->lock);
+    return rv;
+}
+
+void xsp_eventfd_set_notify_task(xsp_eventfd_handle_t efd, TaskHandle_t task) {
+    LOCK(&efd->lock);
+    efd->notify_task = task;
+    UNLOCK(&efd->lock);
+}
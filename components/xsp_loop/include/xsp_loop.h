@@ -8,12 +8,19 @@
 
 #include "esp_err.h"
 
+#include "xsp_eventfd.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 typedef struct xsp_loop_config {
     int poll_timeout_ms;
+
+    // If set, event FD watchers (see `xsp_loop_set_fd_watcher_eventfd()`) are woken using task
+    // notifications instead of `select()`, whenever no other FDs are being watched. Note that this
+    // uses the loop task's notification value.
+    bool use_task_notify;
 } xsp_loop_config_t;
 
 typedef struct xsp_loop* xsp_loop_handle_t;
@@ -78,17 +85,28 @@ esp_err_t xsp_loop_run(xsp_loop_handle_t loop);
 // event handler.
 esp_err_t xsp_loop_stop(xsp_loop_handle_t loop);
 
-// Adds an file descriptor watcher.
-// WARNING: This must not be called from an FD event handler function.
+// Adds an file descriptor watcher. If called during a loop iteration (e.g., from an FD event
+// handler function), the watcher is only watched starting with the next iteration.
 xsp_loop_fd_watcher_handle_t xsp_loop_add_fd_watcher(
         xsp_loop_handle_t loop,
         const xsp_loop_fd_event_handler_t* fd_evt_handler);
 
-// Removes a file descriptor watcher.
-// WARNING: This must not be called from an FD event handler function.
+// Removes a file descriptor watcher. This may be called during a loop iteration (e.g., from an FD
+// event handler function, including the watcher's own), in which case no further events are sent to
+// the watcher (and it is freed at the end of the iteration).
 esp_err_t xsp_loop_remove_fd_watcher(xsp_loop_handle_t loop,
                                      xsp_loop_fd_watcher_handle_t fd_watcher);
 
+// Indicates that the given file descriptor watcher is watching an `xsp_eventfd` (whose handle is
+// given). If the loop is configured with `use_task_notify`, then this allows the loop to wait for
+// it without using `select()` (when only watching for reads). `efd` must remain valid for the
+// lifetime of the watcher. This may be called during a loop iteration (e.g., from an FD event
+// handler function, typically right after adding the watcher), in which case it takes effect
+// starting with the next iteration (as for `xsp_loop_add_fd_watcher()`).
+esp_err_t xsp_loop_set_fd_watcher_eventfd(xsp_loop_handle_t loop,
+                                          xsp_loop_fd_watcher_handle_t fd_watcher,
+                                          xsp_eventfd_handle_t efd);
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif
@@ -10,20 +10,33 @@
 
 #include "esp_log.h"
 #include "esp_transport_utils.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
 #include "sdkconfig.h"
 
 typedef struct xsp_loop_fd_watcher {
     xsp_loop_fd_event_handler_t fd_evt_handler;
+    xsp_eventfd_handle_t efd;           // Set if watching an event FD (may be null).
+    xsp_loop_fd_watch_for_t watch_for;  // Only meaningful during a loop iteration.
+    bool notify_wait;                   // Only meaningful during a loop iteration.
+    bool removed;                       // Set if removed during a loop iteration (not yet freed).
     SLIST_ENTRY(xsp_loop_fd_watcher) fd_watchers;
 } xsp_loop_fd_watcher_t;
 
 typedef struct xsp_loop {
     xsp_loop_config_t config;
     xsp_loop_event_handler_t evt_handler;
+    TickType_t poll_timeout_ticks;  // `config.poll_timeout_ms`, rounded up to ticks.
 
     bool is_running;
     bool should_stop;
+    TaskHandle_t task;  // Only valid when running.
+
+    // Set during a loop iteration, during which FD watchers that are removed are only marked as
+    // such (and then freed at the end of the iteration).
+    bool in_iteration;
+    bool any_removed;
 
     SLIST_HEAD(fd_watchers_head, xsp_loop_fd_watcher) fd_watchers_head;
 } xsp_loop_t;
@@ -34,7 +47,14 @@ static const char TAG[] = "LOOP";
 #error "Invalid value for CONFIG_XSP_LOOP_DEFAULT_..."
 #endif
 
-const xsp_loop_config_t xsp_loop_config_default = {CONFIG_XSP_LOOP_DEFAULT_POLL_TIMEOUT_MS};
+#ifdef CONFIG_XSP_LOOP_DEFAULT_USE_TASK_NOTIFY
+#define DEFAULT_USE_TASK_NOTIFY true
+#else
+#define DEFAULT_USE_TASK_NOTIFY false
+#endif
+
+const xsp_loop_config_t xsp_loop_config_default = {CONFIG_XSP_LOOP_DEFAULT_POLL_TIMEOUT_MS,
+                                                   DEFAULT_USE_TASK_NOTIFY};
 
 static bool validate_config(const xsp_loop_config_t* config) {
     if (!config)
@@ -61,6 +81,8 @@ xsp_loop_handle_t xsp_loop_init(const xsp_loop_config_t* config,
     }
 
     loop->config = *config;
+    loop->poll_timeout_ticks =
+            (TickType_t)((config->poll_timeout_ms + (portTICK_PERIOD_MS - 1)) / portTICK_PERIOD_MS);
     if (evt_handler)
         loop->evt_handler = *evt_handler;
 
@@ -93,8 +115,51 @@ esp_err_t xsp_loop_cleanup(xsp_loop_handle_t loop) {
     return ESP_OK;
 }
 
+// Sets (or clears) the loop task as the notify task for all the event FD watchers.
+static void set_notify_task(xsp_loop_handle_t loop, TaskHandle_t task) {
+    if (!loop->config.use_task_notify)
+        return;
+
+    xsp_loop_fd_watcher_t* fd_watcher;
+    SLIST_FOREACH(fd_watcher, &loop->fd_watchers_head, fd_watchers) {
+        if (fd_watcher->efd)
+            xsp_eventfd_set_notify_task(fd_watcher->efd, task);
+    }
+}
+
+// Waits for event FD watchers (with `notify_wait` set) using task notifications, and dispatches
+// can-read events. Returns true if any events were dispatched.
+static bool do_notify_wait(xsp_loop_handle_t loop) {
+    bool any_readable = false;
+    xsp_loop_fd_watcher_t* fd_watcher;
+    SLIST_FOREACH(fd_watcher, &loop->fd_watchers_head, fd_watchers) {
+        if (!fd_watcher->removed && fd_watcher->notify_wait &&
+            xsp_eventfd_can_read(fd_watcher->efd)) {
+            any_readable = true;
+            break;
+        }
+    }
+
+    // Note: Notifications are "sticky", so a write after the check above will cause this to return
+    // immediately. Conversely, we may get spurious wake-ups from stale notifications.
+    ulTaskNotifyTake(pdTRUE, any_readable ? 0 : loop->poll_timeout_ticks);
+
+    bool did_something = false;
+    SLIST_FOREACH(fd_watcher, &loop->fd_watchers_head, fd_watchers) {
+        if (!fd_watcher->removed && fd_watcher->notify_wait &&
+            xsp_eventfd_can_read(fd_watcher->efd)) {
+            xsp_loop_fd_event_handler_t* feh = &fd_watcher->fd_evt_handler;
+            feh->on_loop_can_read_fd(loop, feh->ctx, feh->fd);
+            did_something = true;
+            if (loop->should_stop)
+                break;
+        }
+    }
+    return did_something;
+}
+
 // Returns true if we should continue.
-static bool do_loop_iteration(xsp_loop_handle_t loop) {
+static bool do_loop_iteration_inner(xsp_loop_handle_t loop) {
     if (loop->should_stop)
         return false;
 
@@ -107,8 +172,13 @@ static bool do_loop_iteration(xsp_loop_handle_t loop) {
 
     // First, send notifications that we *will* call select().
     int max_fd = -1;
+    int max_notify_fd = -1;
     xsp_loop_fd_watcher_t* fd_watcher;
     SLIST_FOREACH(fd_watcher, &loop->fd_watchers_head, fd_watchers) {
+        // Watchers added during this iteration (which are added at the head) aren't visited (and
+        // aren't watching for anything until the next iteration).
+        if (fd_watcher->removed)
+            continue;
         xsp_loop_fd_event_handler_t* feh = &fd_watcher->fd_evt_handler;
         xsp_loop_fd_watch_for_t watch_for = XSP_LOOP_FD_WATCH_FOR_NONE;
         if (feh->on_loop_will_select) {
@@ -122,9 +192,19 @@ static bool do_loop_iteration(xsp_loop_handle_t loop) {
                 watch_for |= XSP_LOOP_FD_WATCH_FOR_READ;
         }
 
+        fd_watcher->watch_for = watch_for;
+        // Event FDs that are only watched for reads may be waited on using task notifications.
+        fd_watcher->notify_wait = loop->config.use_task_notify && fd_watcher->efd &&
+                                  watch_for == XSP_LOOP_FD_WATCH_FOR_READ;
+
         if (watch_for) {
-            if (feh->fd > max_fd)
-                max_fd = feh->fd;
+            if (fd_watcher->notify_wait) {
+                if (feh->fd > max_notify_fd)
+                    max_notify_fd = feh->fd;
+            } else {
+                if (feh->fd > max_fd)
+                    max_fd = feh->fd;
+            }
             if ((watch_for & XSP_LOOP_FD_WATCH_FOR_WRITE))
                 FD_SET(feh->fd, &write_fds);
             if ((watch_for & XSP_LOOP_FD_WATCH_FOR_READ))
@@ -132,27 +212,38 @@ static bool do_loop_iteration(xsp_loop_handle_t loop) {
         }
     }
 
-    // TODO(vtl): We shouldn't have to do this conversion each iteration.
-    struct timeval timeout;
-    esp_transport_utils_ms_to_timeval(loop->config.poll_timeout_ms, &timeout);
-    // TODO(vtl): Possibly, we should check for error (-1) vs timeout (0).
-    if (select(max_fd + 1, &read_fds, &write_fds, NULL, &timeout) > 0) {
-        xsp_loop_fd_watcher_t* fd_watcher;
-        SLIST_FOREACH(fd_watcher, &loop->fd_watchers_head, fd_watchers) {
-            xsp_loop_fd_event_handler_t* feh = &fd_watcher->fd_evt_handler;
-
-            if (FD_ISSET(feh->fd, &write_fds)) {
-                feh->on_loop_can_write_fd(loop, feh->ctx, feh->fd);
-                if (loop->should_stop)
-                    return false;
-            }
-            if (FD_ISSET(feh->fd, &read_fds)) {
-                feh->on_loop_can_read_fd(loop, feh->ctx, feh->fd);
-                if (loop->should_stop)
-                    return false;
+    if (loop->config.use_task_notify && max_fd == -1) {
+        // Only event FDs (if anything) are being watched, so we don't need select().
+        did_something = do_notify_wait(loop);
+    } else {
+        if (max_notify_fd > max_fd)
+            max_fd = max_notify_fd;
+
+        // TODO(vtl): We shouldn't have to do this conversion each iteration.
+        struct timeval timeout;
+        esp_transport_utils_ms_to_timeval(loop->config.poll_timeout_ms, &timeout);
+        // TODO(vtl): Possibly, we should check for error (-1) vs timeout (0).
+        if (select(max_fd + 1, &read_fds, &write_fds, NULL, &timeout) > 0) {
+            xsp_loop_fd_watcher_t* fd_watcher;
+            SLIST_FOREACH(fd_watcher, &loop->fd_watchers_head, fd_watchers) {
+                xsp_loop_fd_event_handler_t* feh = &fd_watcher->fd_evt_handler;
+
+                // Note: A watcher may be removed by an earlier event (including its own can-write).
+                if (!fd_watcher->removed && (fd_watcher->watch_for & XSP_LOOP_FD_WATCH_FOR_WRITE) &&
+                    FD_ISSET(feh->fd, &write_fds)) {
+                    feh->on_loop_can_write_fd(loop, feh->ctx, feh->fd);
+                    if (loop->should_stop)
+                        return false;
+                }
+                if (!fd_watcher->removed && (fd_watcher->watch_for & XSP_LOOP_FD_WATCH_FOR_READ) &&
+                    FD_ISSET(feh->fd, &read_fds)) {
+                    feh->on_loop_can_read_fd(loop, feh->ctx, feh->fd);
+                    if (loop->should_stop)
+                        return false;
+                }
             }
+            did_something = true;
         }
-        did_something = true;
     }
     if (loop->should_stop)
         return false;
@@ -168,6 +259,31 @@ static bool do_loop_iteration(xsp_loop_handle_t loop) {
     return true;
 }
 
+// Frees FD watchers that were removed during a loop iteration.
+static void free_removed_fd_watchers(xsp_loop_handle_t loop) {
+    if (!loop->any_removed)
+        return;
+    loop->any_removed = false;
+
+    xsp_loop_fd_watcher_t* fd_watcher;
+    xsp_loop_fd_watcher_t* fd_watcher_temp;
+    SLIST_FOREACH_SAFE(fd_watcher, &loop->fd_watchers_head, fd_watchers, fd_watcher_temp) {
+        if (fd_watcher->removed) {
+            SLIST_REMOVE(&loop->fd_watchers_head, fd_watcher, xsp_loop_fd_watcher, fd_watchers);
+            free(fd_watcher);
+        }
+    }
+}
+
+// Returns true if we should continue.
+static bool do_loop_iteration(xsp_loop_handle_t loop) {
+    loop->in_iteration = true;
+    bool result = do_loop_iteration_inner(loop);
+    loop->in_iteration = false;
+    free_removed_fd_watchers(loop);
+    return result;
+}
+
 esp_err_t xsp_loop_run(xsp_loop_handle_t loop) {
     if (!loop)
         return ESP_ERR_INVALID_ARG;
@@ -176,12 +292,16 @@ esp_err_t xsp_loop_run(xsp_loop_handle_t loop) {
 
     loop->is_running = true;
     loop->should_stop = false;
+    loop->task = xTaskGetCurrentTaskHandle();
+    set_notify_task(loop, loop->task);
     if (loop->evt_handler.on_loop_start)
         loop->evt_handler.on_loop_start(loop, loop->evt_handler.ctx);
     while (do_loop_iteration(loop))
         ;  // Nothing.
     if (loop->evt_handler.on_loop_stop)
         loop->evt_handler.on_loop_stop(loop, loop->evt_handler.ctx);
+    set_notify_task(loop, NULL);
+    loop->task = NULL;
     loop->is_running = false;
 
     return ESP_OK;
@@ -214,6 +334,10 @@ xsp_loop_fd_watcher_handle_t xsp_loop_add_fd_watcher(
         return NULL;
     }
     fd_watcher->fd_evt_handler = *fd_evt_handler;
+    fd_watcher->efd = NULL;
+    fd_watcher->watch_for = XSP_LOOP_FD_WATCH_FOR_NONE;
+    fd_watcher->notify_wait = false;
+    fd_watcher->removed = false;
     SLIST_INSERT_HEAD(&loop->fd_watchers_head, fd_watcher, fd_watchers);
     return fd_watcher;
 }
@@ -222,7 +346,31 @@ esp_err_t xsp_loop_remove_fd_watcher(xsp_loop_handle_t loop,
                                      xsp_loop_fd_watcher_handle_t fd_watcher) {
     if (!loop || !fd_watcher)
         return ESP_ERR_INVALID_ARG;
+    if (fd_watcher->removed)
+        return ESP_ERR_INVALID_STATE;
+    if (fd_watcher->efd && loop->is_running && loop->config.use_task_notify)
+        xsp_eventfd_set_notify_task(fd_watcher->efd, NULL);
+    if (loop->in_iteration) {
+        // It may be in use (e.g., we may be inside one of its event handlers), so just mark it.
+        fd_watcher->removed = true;
+        loop->any_removed = true;
+        return ESP_OK;
+    }
     SLIST_REMOVE(&loop->fd_watchers_head, fd_watcher, xsp_loop_fd_watcher, fd_watchers);
     free(fd_watcher);
     return ESP_OK;
 }
+
+esp_err_t xsp_loop_set_fd_watcher_eventfd(xsp_loop_handle_t loop,
+                                          xsp_loop_fd_watcher_handle_t fd_watcher,
+                                          xsp_eventfd_handle_t efd) {
+    if (!loop || !fd_watcher || !efd)
+        return ESP_ERR_INVALID_ARG;
+    if (fd_watcher->efd)
+        return ESP_ERR_INVALID_STATE;
+
+    fd_watcher->efd = efd;
+    if (loop->is_running && loop->config.use_task_notify)
+        xsp_eventfd_set_notify_task(efd, loop->task);
+    return ESP_OK;
+}
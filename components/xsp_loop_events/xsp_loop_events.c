@@ -186,10 +186,18 @@ xsp_loop_events_handle_t xsp_loop_events_init(const xsp_loop_events_config_t* co
         ESP_LOGE(TAG, "Failed to watch FD");
         goto fail;
     }
+    // This allows the loop to wait on the wake FD using task notifications (if so configured).
+    if (xsp_loop_set_fd_watcher_eventfd(loop, loop_events->fd_watcher, loop_events->wake_handle) !=
+        ESP_OK) {
+        ESP_LOGE(TAG, "Failed to set FD watcher eventfd");
+        goto fail;
+    }
 
     return loop_events;
 
 fail:
+    if (loop_events->fd_watcher)
+        xsp_loop_remove_fd_watcher(loop, loop_events->fd_watcher);  // Ignore any error.
     if (loop_events->wake_fd != -1)
         close(loop_events->wake_fd);
     free(loop_events->event_data_bounce_buffer);
@@ -206,6 +214,12 @@ esp_err_t xsp_loop_events_cleanup(xsp_loop_events_handle_t loop_events) {
     if (loop_events->queue_count > 0)
         ESP_LOGW(TAG, "Cleaning up with %d undispatched events", loop_events->queue_count);
 
+    // Note: The watcher refers to the wake FD's handle, so it must be removed before closing it.
+    // This only fails if the watcher was already removed (which would be a bug), in which case it's
+    // still safe to proceed.
+    esp_err_t err = xsp_loop_remove_fd_watcher(loop_events->loop, loop_events->fd_watcher);
+    if (err != ESP_OK)
+        ESP_LOGE(TAG, "Failed to remove FD watcher: %s", esp_err_to_name(err));
     if (loop_events->wake_fd != -1)
         close(loop_events->wake_fd);
     free(loop_events->event_data_bounce_buffer);
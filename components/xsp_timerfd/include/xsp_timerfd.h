@@ -0,0 +1,48 @@
+// Copyright 2019 Tricot Inc.
+// Use of this source code is governed by the license in the LICENSE file.
+
+#ifndef XSP_TIMERFD_H_
+#define XSP_TIMERFD_H_
+
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define XSP_TIMERFD_NONBLOCK 2
+
+// For `xsp_timerfd_settime()`: `it_value` is an absolute time, in `esp_timer_get_time()`'s time
+// base (i.e., microseconds since boot). Analogous to Linux's `TFD_TIMER_ABSTIME`.
+#define XSP_TIMERFD_TIMER_ABSTIME 1
+
+// Analogous to Linux's `struct itimerspec`.
+typedef struct xsp_timerfd_itimerspec {
+    struct timespec it_interval;  // Interval for periodic timers (zero for one-shot).
+    struct timespec it_value;     // Initial expiration (zero to disarm).
+} xsp_timerfd_itimerspec_t;
+
+void xsp_timerfd_register();
+
+// Creates a timer FD, initially disarmed. Analogous to Linux's `timerfd_create()`, except that the
+// clock is always `esp_timer`'s (i.e., monotonic) and `flags` may only include
+// `XSP_TIMERFD_NONBLOCK`.
+int xsp_timerfd_create(int flags);
+
+// Arms or disarms the timer FD, and resets its expiration count. Analogous to Linux's
+// `timerfd_settime()`: `flags` may include `XSP_TIMERFD_TIMER_ABSTIME` (otherwise
+// `new_value->it_value` is relative to the current time). `old_value` may be null.
+int xsp_timerfd_settime(int fd,
+                        int flags,
+                        const xsp_timerfd_itimerspec_t* new_value,
+                        xsp_timerfd_itimerspec_t* old_value);
+
+// Gets the time until the next expiration (and the interval). Analogous to Linux's
+// `timerfd_gettime()`.
+int xsp_timerfd_gettime(int fd, xsp_timerfd_itimerspec_t* curr_value);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // XSP_TIMERFD_H_
@@ -0,0 +1,634 @@
+// Copyright 2019 Tricot Inc.
+// Use of this source code is governed by the license in the LICENSE file.
+
+#include "xsp_timerfd.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <unistd.h>
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_vfs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "freertos/portmacro.h"
+
+#include "sdkconfig.h"
+
+#define MAX_NUM_TIMERFD CONFIG_XSP_TIMERFD_MAX_NUM_TIMERFD
+
+#define LOCK_TYPE portMUX_TYPE
+
+#define INIT_LOCK(l) vPortCPUInitializeMutex(l)
+#define DEINIT_LOCK(l) \
+    do {               \
+        (void)l;       \
+    } while (0)
+
+#define LOCK(l) portENTER_CRITICAL(l)
+#define UNLOCK(l) portEXIT_CRITICAL(l)
+
+// NOTE: xsp_timerfd_ctx_t's lock precedes xsp_timerfd_t's lock in the (acquisition) order.
+
+#define TFD_EVENT_EXPIRED_BIT 1  // Used to wait for the timer to expire.
+
+typedef struct xsp_timerfd_struct {
+    LOCK_TYPE lock;
+    unsigned refcount;
+    bool nonblock;
+    bool closed;
+
+    esp_timer_handle_t timer;
+    int64_t next_expiration_us;  // In `esp_timer_get_time()` time base; 0 if disarmed.
+    int64_t interval_us;         // 0 if one-shot.
+    uint64_t expirations;        // Number of expirations since the last read (or settime).
+
+    EventGroupHandle_t events;
+    unsigned waiters;  // Number of things waiting for the timer to expire.
+
+    bool select_active;
+} xsp_timerfd_t;
+
+typedef struct xsp_timerfd_ctx {
+    LOCK_TYPE lock;
+    struct {
+        int fd;  // Should be initialized to -1.
+        xsp_timerfd_t* tfd;
+    } timerfds[MAX_NUM_TIMERFD];
+    // Note: Only one select() at a time (like xsp_eventfd).
+    SemaphoreHandle_t* select_signal;
+    fd_set select_readfds_in;     // Only meaningful when select_signal is set.
+    fd_set select_writefds_in;    // Only meaningful when select_signal is set.
+    fd_set* select_readfds_out;   // Only meaningful when select_signal is set.
+    fd_set* select_writefds_out;  // Only meaningful when select_signal is set.
+} xsp_timerfd_ctx_t;
+
+static const char TAG[] = "TIMERFD";
+
+static esp_vfs_id_t g_timerfd_vfs_id = -1;
+static xsp_timerfd_ctx_t* g_timerfd_ctx = NULL;
+
+static void tfd_ref_locked(xsp_timerfd_t* tfd) {
+    tfd->refcount++;
+}
+
+// Note: `tfd` should be locked to call this, but it will be unlocked afterwards.
+static void tfd_unref_locked(xsp_timerfd_t* tfd) {
+    if (tfd->refcount == 1) {
+        UNLOCK(&tfd->lock);
+        // Note: The timer was already stopped on close.
+        esp_timer_delete(tfd->timer);
+        vEventGroupDelete(tfd->events);
+        DEINIT_LOCK(&tfd->lock);
+        free(tfd);
+    } else {
+        tfd->refcount--;
+        UNLOCK(&tfd->lock);
+    }
+}
+
+static xsp_timerfd_t* tfd_lookup_locked(xsp_timerfd_ctx_t* ctx, int fd, size_t* idx) {
+    if (fd < 0)
+        return NULL;
+
+    for (size_t i = 0; i < MAX_NUM_TIMERFD; i++) {
+        if (ctx->timerfds[i].fd == fd) {
+            if (idx)
+                *idx = i;
+            return ctx->timerfds[i].tfd;
+        }
+    }
+
+    return NULL;
+}
+
+// Looks up the given FD and returns its `xsp_timerfd_t` with its lock acquired (but without
+// incrementing the refcount). On failure, sets errno and returns null.
+static xsp_timerfd_t* tfd_lookup(void* raw_ctx, int fd) {
+    xsp_timerfd_ctx_t* ctx = (xsp_timerfd_ctx_t*)raw_ctx;
+    if (!ctx) {
+        errno = EFAULT;
+        return NULL;
+    }
+
+    LOCK(&ctx->lock);
+
+    xsp_timerfd_t* tfd = tfd_lookup_locked(ctx, fd, NULL);
+    if (!tfd) {
+        UNLOCK(&ctx->lock);
+        errno = EBADF;
+        return NULL;
+    }
+
+    LOCK(&tfd->lock);
+    UNLOCK(&ctx->lock);
+    return tfd;
+}
+
+static void maybe_signal_select_locked(xsp_timerfd_ctx_t* ctx) {
+    if (!ctx->select_signal)
+        return;
+
+    bool should_signal = false;
+    for (size_t i = 0; i < MAX_NUM_TIMERFD; i++) {
+        int fd = ctx->timerfds[i].fd;
+        if (fd == -1)
+            continue;
+
+        // Timer FDs are never writable, so we only care about readability.
+        if (FD_ISSET(fd, &ctx->select_readfds_in)) {
+            xsp_timerfd_t* tfd = ctx->timerfds[i].tfd;
+            LOCK(&tfd->lock);
+            uint64_t expirations = tfd->expirations;
+            UNLOCK(&tfd->lock);
+
+            if (expirations > 0) {
+                should_signal = true;
+                break;
+            }
+        }
+    }
+
+    // This must be done under `ctx->lock`, since otherwise `tfd_end_select()` may clear (and the
+    // VFS may then delete) the semaphore.
+    if (should_signal)
+        esp_vfs_select_triggered(ctx->select_signal);
+}
+
+static int64_t timespec_to_us(const struct timespec* ts) {
+    // Round up, so that we never expire early.
+    return (int64_t)ts->tv_sec * 1000000 + (ts->tv_nsec + 999) / 1000;
+}
+
+static void us_to_timespec(int64_t us, struct timespec* ts) {
+    ts->tv_sec = (time_t)(us / 1000000);
+    ts->tv_nsec = (long)(us % 1000000) * 1000;
+}
+
+static bool is_valid_timespec(const struct timespec* ts) {
+    return ts->tv_sec >= 0 && ts->tv_nsec >= 0 && ts->tv_nsec < 1000000000;
+}
+
+static void get_itimerspec_locked(xsp_timerfd_t* tfd, int64_t now, xsp_timerfd_itimerspec_t* its) {
+    us_to_timespec(tfd->interval_us, &its->it_interval);
+    if (tfd->next_expiration_us) {
+        int64_t remaining = tfd->next_expiration_us - now;
+        // If it's due but the callback hasn't run yet, report the smallest nonzero value (zero
+        // would mean "disarmed").
+        us_to_timespec(remaining > 0 ? remaining : 1, &its->it_value);
+    } else {
+        us_to_timespec(0, &its->it_value);
+    }
+}
+
+// Called (on the esp_timer task) when `tfd`'s timer goes off.
+static void tfd_timer_callback(void* arg) {
+    xsp_timerfd_ctx_t* ctx = g_timerfd_ctx;
+    LOCK(&ctx->lock);
+
+    // `arg` is only valid if it's still in the table (it may have been closed and freed just as the
+    // timer was going off). Note that if its memory was reused for a new timer FD, the checks below
+    // keep us from counting a spurious expiration.
+    xsp_timerfd_t* tfd = NULL;
+    for (size_t i = 0; i < MAX_NUM_TIMERFD; i++) {
+        if (ctx->timerfds[i].tfd == arg) {
+            tfd = ctx->timerfds[i].tfd;
+            break;
+        }
+    }
+    if (!tfd) {
+        UNLOCK(&ctx->lock);
+        return;
+    }
+
+    LOCK(&tfd->lock);
+
+    // It may have been rearmed (or disarmed) by xsp_timerfd_settime() just as it was going off.
+    int64_t now = esp_timer_get_time();
+    if (!tfd->next_expiration_us || now < tfd->next_expiration_us) {
+        UNLOCK(&tfd->lock);
+        UNLOCK(&ctx->lock);
+        return;
+    }
+
+    if (tfd->interval_us) {
+        // Count any expirations that we missed (e.g., if the esp_timer task was busy), so that
+        // periodic timers don't drift.
+        uint64_t n = 1 + (uint64_t)((now - tfd->next_expiration_us) / tfd->interval_us);
+        tfd->expirations += n;
+        tfd->next_expiration_us += (int64_t)n * tfd->interval_us;
+        // The timer may have been restarted by xsp_timerfd_settime() after it went off but before
+        // we got the lock (in which case starting it would fail), so stop it first.
+        esp_timer_stop(tfd->timer);  // Ignore the error if it's not running.
+        esp_err_t err =
+                esp_timer_start_once(tfd->timer, (uint64_t)(tfd->next_expiration_us - now));
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "esp_timer_start_once() failed: %s", esp_err_to_name(err));
+            tfd->next_expiration_us = 0;
+        }
+    } else {
+        tfd->expirations++;
+        tfd->next_expiration_us = 0;
+    }
+
+    if (tfd->waiters > 0)
+        xEventGroupSetBits(tfd->events, TFD_EVENT_EXPIRED_BIT);
+
+    bool select_active = tfd->select_active;
+    UNLOCK(&tfd->lock);
+
+    if (select_active)
+        maybe_signal_select_locked(ctx);
+
+    UNLOCK(&ctx->lock);
+}
+
+static ssize_t tfd_write_p(void* raw_ctx, int fd, const void* buf, size_t count) {
+    // Timer FDs can't be written to.
+    errno = EINVAL;
+    return -1;
+}
+
+static ssize_t tfd_read_p(void* raw_ctx, int fd, void* buf, size_t count) {
+    // Shouldn't get here from an ISR, since the VFS isn't ISR-safe.
+    assert(!xPortInIsrContext());
+
+    if (count < 8) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    xsp_timerfd_t* tfd = tfd_lookup(raw_ctx, fd);
+    if (!tfd)
+        return -1;  // errno already set.
+    tfd_ref_locked(tfd);
+
+    while (tfd->expirations == 0) {
+        // If nonblocking, fail; else block.
+        if (tfd->nonblock) {
+            tfd_unref_locked(tfd);
+            errno = EAGAIN;
+            return -1;
+        }
+
+        tfd->waiters++;
+        UNLOCK(&tfd->lock);
+        xEventGroupWaitBits(tfd->events, TFD_EVENT_EXPIRED_BIT, pdFALSE, pdFALSE, portMAX_DELAY);
+        LOCK(&tfd->lock);
+        tfd->waiters--;
+        if (tfd->closed) {
+            tfd_unref_locked(tfd);
+            ESP_LOGE(TAG, "FD closed while blocked in read()");
+            // Like any other use of an FD that's no longer open.
+            errno = EBADF;
+            return -1;
+        }
+        if (tfd->waiters == 0)
+            xEventGroupClearBits(tfd->events, TFD_EVENT_EXPIRED_BIT);
+    }
+
+    memcpy(buf, &tfd->expirations, 8);
+    tfd->expirations = 0;
+
+    tfd_unref_locked(tfd);
+    return 8;
+}
+
+static int tfd_close_p(void* raw_ctx, int fd) {
+    // Shouldn't get here from an ISR, since the VFS isn't ISR-safe.
+    assert(!xPortInIsrContext());
+
+    xsp_timerfd_ctx_t* ctx = (xsp_timerfd_ctx_t*)raw_ctx;
+    LOCK(&ctx->lock);
+
+    size_t idx;
+    xsp_timerfd_t* tfd = tfd_lookup_locked(ctx, fd, &idx);
+    if (!tfd) {
+        UNLOCK(&ctx->lock);
+        // The VFS only calls us for registered FDs, but another task may have closed `fd`
+        // concurrently.
+        errno = EBADF;
+        return -1;
+    }
+
+    ctx->timerfds[idx].fd = -1;
+    ctx->timerfds[idx].tfd = NULL;
+    UNLOCK(&ctx->lock);
+
+    // This takes the VFS's FD table mutex, so it must not be done under our (spin)locks. Since the
+    // FD is no longer in our table, lookups of it already fail (and the VFS won't reuse the FD
+    // until it's unregistered). The table's reference keeps `tfd` alive.
+    esp_err_t err = esp_vfs_unregister_fd(g_timerfd_vfs_id, fd);
+    if (err != ESP_OK)
+        ESP_LOGE(TAG, "esp_vfs_unregister_fd() failed: %s", esp_err_to_name(err));
+
+    LOCK(&tfd->lock);
+    tfd->closed = true;
+    esp_timer_stop(tfd->timer);  // Ignore the error if it's not running.
+    tfd->next_expiration_us = 0;
+    xEventGroupSetBits(tfd->events, TFD_EVENT_EXPIRED_BIT);
+
+    // This is a caller error, but not a fatal one: the `select()` will just never report this FD.
+    if (tfd->select_active)
+        ESP_LOGE(TAG, "Closing FD while it's being used in select()");
+    tfd->select_active = false;
+
+    tfd_unref_locked(tfd);
+    return 0;
+}
+
+static int tfd_fcntl_p(void* raw_ctx, int fd, int cmd, va_list args) {
+    // Shouldn't get here from an ISR, since the VFS isn't ISR-safe.
+    assert(!xPortInIsrContext());
+
+    xsp_timerfd_t* tfd = tfd_lookup(raw_ctx, fd);
+    if (!tfd)
+        return -1;  // errno already set.
+
+    int rv = -1;
+    switch (cmd) {
+    case F_GETFL:
+        rv = 0;
+        if (tfd->nonblock)
+            rv |= O_NONBLOCK;
+        break;
+
+    case F_SETFL: {
+        int arg = va_arg(args, int);
+        // As on Linux, other flags (e.g., the access mode) are ignored.
+        tfd->nonblock = !!(arg & O_NONBLOCK);
+        rv = 0;
+        break;
+    }
+
+    default:
+        errno = ENOSYS;
+        break;
+    }
+
+    UNLOCK(&tfd->lock);
+    return rv;
+}
+
+static esp_err_t tfd_start_select(int nfds,
+                                  fd_set* readfds,
+                                  fd_set* writefds,
+                                  fd_set* exceptfds,
+                                  SemaphoreHandle_t* signal_sem) {
+    // Shouldn't get here from an ISR, since the VFS isn't ISR-safe.
+    assert(!xPortInIsrContext());
+
+    // We're only registered with the VFS (in `xsp_timerfd_register()`) after the context is set up.
+    assert(g_timerfd_ctx);
+    if (!signal_sem)
+        return ESP_ERR_INVALID_ARG;
+
+    LOCK(&g_timerfd_ctx->lock);
+
+    if (g_timerfd_ctx->select_signal) {
+        UNLOCK(&g_timerfd_ctx->lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    g_timerfd_ctx->select_signal = signal_sem;
+    if (readfds)
+        g_timerfd_ctx->select_readfds_in = *readfds;
+    else
+        FD_ZERO(&g_timerfd_ctx->select_readfds_in);
+    if (writefds)
+        g_timerfd_ctx->select_writefds_in = *writefds;
+    else
+        FD_ZERO(&g_timerfd_ctx->select_writefds_in);
+    g_timerfd_ctx->select_readfds_out = readfds;
+    g_timerfd_ctx->select_writefds_out = writefds;
+
+    for (size_t i = 0; i < MAX_NUM_TIMERFD; i++) {
+        int fd = g_timerfd_ctx->timerfds[i].fd;
+        if (fd == -1)
+            continue;
+
+        if (FD_ISSET(fd, &g_timerfd_ctx->select_readfds_in)) {
+            xsp_timerfd_t* tfd = g_timerfd_ctx->timerfds[i].tfd;
+            LOCK(&tfd->lock);
+            tfd->select_active = true;
+            UNLOCK(&tfd->lock);
+        }
+    }
+
+    maybe_signal_select_locked(g_timerfd_ctx);
+
+    UNLOCK(&g_timerfd_ctx->lock);
+    return ESP_OK;
+}
+
+static void tfd_end_select() {
+    // Shouldn't get here from an ISR, since the VFS isn't ISR-safe.
+    assert(!xPortInIsrContext());
+
+    assert(g_timerfd_ctx);
+
+    LOCK(&g_timerfd_ctx->lock);
+
+    assert(g_timerfd_ctx->select_signal);
+
+    for (size_t i = 0; i < MAX_NUM_TIMERFD; i++) {
+        int fd = g_timerfd_ctx->timerfds[i].fd;
+        if (fd == -1)
+            continue;
+
+        if (FD_ISSET(fd, &g_timerfd_ctx->select_readfds_in)) {
+            xsp_timerfd_t* tfd = g_timerfd_ctx->timerfds[i].tfd;
+            LOCK(&tfd->lock);
+            uint64_t expirations = tfd->expirations;
+            tfd->select_active = false;
+            UNLOCK(&tfd->lock);
+
+            if (expirations > 0)
+                FD_SET(fd, g_timerfd_ctx->select_readfds_out);
+            else
+                FD_CLR(fd, g_timerfd_ctx->select_readfds_out);
+        }
+        // Never writable.
+        if (FD_ISSET(fd, &g_timerfd_ctx->select_writefds_in))
+            FD_CLR(fd, g_timerfd_ctx->select_writefds_out);
+    }
+
+    g_timerfd_ctx->select_signal = NULL;
+    FD_ZERO(&g_timerfd_ctx->select_readfds_in);
+    FD_ZERO(&g_timerfd_ctx->select_writefds_in);
+    g_timerfd_ctx->select_readfds_out = NULL;
+    g_timerfd_ctx->select_writefds_out = NULL;
+
+    UNLOCK(&g_timerfd_ctx->lock);
+}
+
+void xsp_timerfd_register() {
+    static const esp_vfs_t vfs = {
+            .flags = ESP_VFS_FLAG_CONTEXT_PTR,
+            .write_p = &tfd_write_p,
+            .read_p = &tfd_read_p,
+            .close_p = &tfd_close_p,
+            .fcntl_p = &tfd_fcntl_p,
+            .start_select = &tfd_start_select,
+            .end_select = &tfd_end_select,
+    };
+
+    ESP_ERROR_CHECK(!g_timerfd_ctx ? ESP_OK : ESP_FAIL);
+
+    g_timerfd_ctx = (xsp_timerfd_ctx_t*)malloc(sizeof(xsp_timerfd_ctx_t));
+    ESP_ERROR_CHECK(g_timerfd_ctx ? ESP_OK : ESP_ERR_NO_MEM);
+    INIT_LOCK(&g_timerfd_ctx->lock);
+    for (size_t i = 0; i < MAX_NUM_TIMERFD; i++) {
+        g_timerfd_ctx->timerfds[i].fd = -1;
+        g_timerfd_ctx->timerfds[i].tfd = NULL;
+    }
+    g_timerfd_ctx->select_signal = NULL;
+    FD_ZERO(&g_timerfd_ctx->select_readfds_in);
+    FD_ZERO(&g_timerfd_ctx->select_writefds_in);
+    g_timerfd_ctx->select_readfds_out = NULL;
+    g_timerfd_ctx->select_writefds_out = NULL;
+
+    ESP_ERROR_CHECK(esp_vfs_register_with_id(&vfs, g_timerfd_ctx, &g_timerfd_vfs_id));
+}
+
+int xsp_timerfd_create(int flags) {
+    if (!g_timerfd_ctx) {
+        errno = EFAULT;
+        return -1;
+    }
+    if ((flags & ~XSP_TIMERFD_NONBLOCK)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    xsp_timerfd_t* tfd = (xsp_timerfd_t*)malloc(sizeof(xsp_timerfd_t));
+    if (!tfd) {
+        errno = ENOMEM;
+        return -1;
+    }
+    tfd->events = xEventGroupCreate();
+    if (!tfd->events) {
+        free(tfd);
+        errno = ENOMEM;
+        return -1;
+    }
+    const esp_timer_create_args_t timer_args = {
+            .callback = &tfd_timer_callback,
+            .arg = tfd,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "xsp_timerfd",
+    };
+    if (esp_timer_create(&timer_args, &tfd->timer) != ESP_OK) {
+        vEventGroupDelete(tfd->events);
+        free(tfd);
+        errno = ENOMEM;
+        return -1;
+    }
+    INIT_LOCK(&tfd->lock);
+    tfd->refcount = 1;
+    tfd->nonblock = !!(flags & XSP_TIMERFD_NONBLOCK);
+    tfd->closed = false;
+    tfd->next_expiration_us = 0;
+    tfd->interval_us = 0;
+    tfd->expirations = 0;
+    tfd->waiters = 0;
+    tfd->select_active = false;
+
+    // This takes the VFS's FD table mutex, so it must not be done under our (spin)locks (see
+    // `tfd_close_p()`). Until the FD is published in our table, lookups of it fail.
+    int fd = -1;
+    esp_err_t err = esp_vfs_register_fd(g_timerfd_vfs_id, &fd);
+    if (err == ESP_OK) {
+        LOCK(&g_timerfd_ctx->lock);
+        size_t idx = 0;
+        for (; idx < MAX_NUM_TIMERFD; idx++) {
+            if (g_timerfd_ctx->timerfds[idx].fd == -1)
+                break;
+        }
+        if (idx < MAX_NUM_TIMERFD) {
+            g_timerfd_ctx->timerfds[idx].fd = fd;
+            g_timerfd_ctx->timerfds[idx].tfd = tfd;
+        }
+        UNLOCK(&g_timerfd_ctx->lock);
+        if (idx < MAX_NUM_TIMERFD)
+            return fd;
+
+        err = ESP_ERR_NO_MEM;  // Our table is full.
+        esp_err_t unregister_err = esp_vfs_unregister_fd(g_timerfd_vfs_id, fd);
+        if (unregister_err != ESP_OK)
+            ESP_LOGE(TAG, "esp_vfs_unregister_fd() failed: %s", esp_err_to_name(unregister_err));
+    }
+
+    esp_timer_delete(tfd->timer);
+    vEventGroupDelete(tfd->events);
+    DEINIT_LOCK(&tfd->lock);
+    free(tfd);
+    errno = (err == ESP_ERR_INVALID_ARG) ? EINVAL : ENFILE;
+    return -1;
+}
+
+int xsp_timerfd_settime(int fd,
+                        int flags,
+                        const xsp_timerfd_itimerspec_t* new_value,
+                        xsp_timerfd_itimerspec_t* old_value) {
+    if ((flags & ~XSP_TIMERFD_TIMER_ABSTIME) || !new_value ||
+        !is_valid_timespec(&new_value->it_interval) || !is_valid_timespec(&new_value->it_value)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    int64_t value_us = timespec_to_us(&new_value->it_value);
+    int64_t interval_us = timespec_to_us(&new_value->it_interval);
+
+    xsp_timerfd_t* tfd = tfd_lookup(g_timerfd_ctx, fd);
+    if (!tfd)
+        return -1;  // errno already set.
+
+    int64_t now = esp_timer_get_time();
+    if (old_value)
+        get_itimerspec_locked(tfd, now, old_value);
+
+    // Note: If the callback is about to run for the old setting, it'll see the new
+    // `next_expiration_us` and ignore it.
+    esp_timer_stop(tfd->timer);  // Ignore the error if it's not running.
+    tfd->expirations = 0;
+    if (value_us) {
+        // An absolute time that has already passed expires immediately (as on Linux).
+        int64_t delay_us = value_us;
+        if ((flags & XSP_TIMERFD_TIMER_ABSTIME))
+            delay_us = (value_us > now) ? value_us - now : 0;
+        tfd->next_expiration_us = now + delay_us;
+        tfd->interval_us = interval_us;
+        esp_timer_start_once(tfd->timer, (uint64_t)delay_us);
+    } else {
+        tfd->next_expiration_us = 0;
+        tfd->interval_us = 0;
+    }
+
+    UNLOCK(&tfd->lock);
+    return 0;
+}
+
+int xsp_timerfd_gettime(int fd, xsp_timerfd_itimerspec_t* curr_value) {
+    if (!curr_value) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    xsp_timerfd_t* tfd = tfd_lookup(g_timerfd_ctx, fd);
+    if (!tfd)
+        return -1;  // errno already set.
+
+    get_itimerspec_locked(tfd, esp_timer_get_time(), curr_value);
+
+    UNLOCK(&tfd->lock);
+    return 0;
+}
@@ -5,15 +5,21 @@
 #define XSP_WS_CLIENT_H_
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "esp_err.h"
 
+#include "xsp_loop.h"
 #include "xsp_ws_client_types.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// The space required before the payload for `xsp_ws_client_write_frame_in_place()`: the maximum
+// size of a frame header (from the client).
+#define XSP_WS_CLIENT_FRAME_HEADROOM 14
+
 typedef struct xsp_ws_client_config {
     // WebSocket URL (ws/wss or http/https) of server.
     const char* url;
@@ -42,19 +48,84 @@ typedef enum xsp_ws_client_state {
     XSP_WS_CLIENT_STATE_FAILED_NO_CLOSE  // The client has failed, and Close should not be sent.
 } xsp_ws_client_state_t;
 
+// Statistics, accumulated over the lifetime of the client (or since they were last reset).
+typedef struct xsp_ws_client_stats {
+    uint32_t frames_written;
+    // Number of writes to (and total bytes written to) the underlying transport, including frame
+    // headers. (Note that for SSL, each transport write is typically at least one TLS record.)
+    uint32_t transport_writes;
+    uint64_t bytes_written;
+
+    uint32_t frames_read;
+    // Number of reads from (and total bytes read from) the underlying transport.
+    uint32_t transport_reads;
+    uint64_t bytes_read;
+
+    // Number of (successful) opens, and the total time spent in them (in microseconds), including
+    // DNS resolution, connecting, the TLS handshake (if any), and the HTTP upgrade request.
+    uint32_t opens;
+    uint64_t open_time_us;
+} xsp_ws_client_stats_t;
+
 // Initializes the WebSocket client.
 xsp_ws_client_handle_t xsp_ws_client_init(const xsp_ws_client_config_t* config);
 
-// Cleans up (shuts down) the WebSocket client.
+// Cleans up (shuts down) the WebSocket client. If an asynchronous open is in progress, it is
+// canceled (see `xsp_ws_client_cancel_open_async()`), if it wasn't already, and the client is freed
+// once the open task is done; in that case, this must be called before the loop is cleaned up.
 esp_err_t xsp_ws_client_cleanup(xsp_ws_client_handle_t client);
 
-// Opens a WebSocket connection.
+// Opens a WebSocket connection. Note that this blocks, for DNS resolution, connecting, the TLS
+// handshake (if any), and the HTTP upgrade request.
 esp_err_t xsp_ws_client_open(xsp_ws_client_handle_t client);
 
-// Closes a WebSocket connection.
+// Called (on the loop's task) when an asynchronous open completes, with the result of the open (as
+// for `xsp_ws_client_open()`).
+typedef void (*xsp_ws_client_on_open_func_t)(xsp_ws_client_handle_t client,
+                                             void* ctx,
+                                             esp_err_t result);
+
+// Opens a WebSocket connection asynchronously, without blocking the loop: the open is done on a
+// separate (short-lived) task, and `on_open` is called from the loop when it completes. Until then,
+// the client must not otherwise be used (and `xsp_ws_client_open()`, `xsp_ws_client_close()`,
+// etc. fail with ESP_ERR_INVALID_STATE); the loop must keep running (or be run again) until the
+// open completes, unless it is canceled. Requires `xsp_eventfd` to be registered. Should only be
+// called from "inside" the loop or while the loop is not running.
+esp_err_t xsp_ws_client_open_async(xsp_ws_client_handle_t client,
+                                   xsp_loop_handle_t loop,
+                                   xsp_ws_client_on_open_func_t on_open,
+                                   void* ctx);
+
+// Cancels an asynchronous open: `on_open` will not be called, and the loop no longer needs to be
+// run for it. The open task can't be interrupted, so the client remains unusable (as while being
+// opened) until it is done, at which point the connection (if any) is closed; the client may be
+// cleaned up in the meantime. Fails with ESP_ERR_INVALID_STATE if no asynchronous open is in
+// progress (or it was already canceled). Should only be called from "inside" the loop or while the
+// loop is not running, and before the loop is cleaned up.
+esp_err_t xsp_ws_client_cancel_open_async(xsp_ws_client_handle_t client);
+
+// Closes a WebSocket connection. The transport is shut down gracefully: the socket is shut down
+// for writing (so that everything written is sent) and, if a Close frame has been written, this
+// waits (for up to CONFIG_XSP_WS_CLIENT_CLOSE_TIMEOUT_MS) for the server to close the connection.
 // NOTE: This does *not* send a Close (control) frame.
 esp_err_t xsp_ws_client_close(xsp_ws_client_handle_t client);
 
+// Called (on the loop's task) when an asynchronous close completes.
+typedef void (*xsp_ws_client_on_closed_func_t)(xsp_ws_client_handle_t client, void* ctx);
+
+// Closes a WebSocket connection asynchronously, like `xsp_ws_client_close()` but without blocking
+// the loop: writing any buffered (or pending) data (when the socket is writable), and then waiting
+// for the server to close the connection, is done using the loop (all within
+// CONFIG_XSP_WS_CLIENT_CLOSE_TIMEOUT_MS), and `on_closed` is called from the loop when done. (If
+// there's nothing to write or wait for, the client is closed and `on_closed` is called immediately,
+// before this returns.) Until then, the client must not otherwise be used (as for
+// `xsp_ws_client_open_async()`). Should only be called from "inside" the loop or while the loop is
+// not running.
+esp_err_t xsp_ws_client_close_async(xsp_ws_client_handle_t client,
+                                    xsp_loop_handle_t loop,
+                                    xsp_ws_client_on_closed_func_t on_closed,
+                                    void* ctx);
+
 // Returns the state of the client, which must be valid.
 xsp_ws_client_state_t xsp_ws_client_get_state(xsp_ws_client_handle_t client);
 
@@ -64,19 +135,44 @@ xsp_ws_client_state_t xsp_ws_client_get_state(xsp_ws_client_handle_t client);
 // sent it (and indicates the server rejects all choices provided by the client).
 const char* xsp_ws_client_get_response_subprotocols(xsp_ws_client_handle_t client);
 
+// Gets the client's statistics.
+esp_err_t xsp_ws_client_get_stats(xsp_ws_client_handle_t client, xsp_ws_client_stats_t* stats);
+
+// Resets the client's statistics.
+esp_err_t xsp_ws_client_reset_stats(xsp_ws_client_handle_t client);
+
 // Returns a file descriptor suitable for use with `select()`, or -1 on error. This may only be
 // called when both reading and writing are permitted.
 // WARNING: There may be pre-buffered data to be read which must be checked separately, which would
 // prevent `select()` from working as desired; see `xsp_ws_client_has_buffered_read_data()` below.
 int xsp_ws_client_get_select_fd(xsp_ws_client_handle_t client);
 
-// Returns true if there is pre-buffered data to be read.
+// Returns true if there is a complete pre-buffered frame to be read (i.e., one that can be read
+// without reading from the transport).
 bool xsp_ws_client_has_buffered_read_data(xsp_ws_client_handle_t client);
 
 // Waits until data can (start to) be written.
 esp_err_t xsp_ws_client_poll_write(xsp_ws_client_handle_t client, int timeout_ms);
 
-// Writes a frame.
+// Corks (or uncorks) the client. While corked, (the ends of) frames written using
+// `xsp_ws_client_write_frame()` or `xsp_ws_client_write_frame_nonblocking()` are kept in the write
+// frame buffer, so that several small frames can be written using a single transport write (and,
+// for SSL, a single TLS record). Buffered frames are written when the buffer is full, before a
+// frame is written in place, on `xsp_ws_client_flush()` (or `xsp_ws_client_flush_nonblocking()`),
+// and when the client is closed. Note that uncorking doesn't flush.
+esp_err_t xsp_ws_client_set_cork(xsp_ws_client_handle_t client, bool cork);
+
+// Writes any buffered frames (see `xsp_ws_client_set_cork()`).
+esp_err_t xsp_ws_client_flush(xsp_ws_client_handle_t client, int timeout_ms);
+
+// Writes any buffered frames without blocking, like `xsp_ws_client_write_frame_nonblocking()`:
+// returns ESP_OK if they were completely written; otherwise, returns ESP_ERR_TIMEOUT, and the rest
+// should be written using `xsp_ws_client_continue_write()`. Fails with ESP_ERR_INVALID_STATE if a
+// nonblocking write is pending.
+esp_err_t xsp_ws_client_flush_nonblocking(xsp_ws_client_handle_t client);
+
+// Writes a frame. The frame header and payload are written together, in writes of up to
+// CONFIG_XSP_WS_CLIENT_WRITE_FRAME_BUFFER_SIZE bytes.
 // NOTE: timeout_ms is per-write at the lower layer (i.e., is a timeout for "progress").
 esp_err_t xsp_ws_client_write_frame(xsp_ws_client_handle_t client,
                                     bool fin,
@@ -85,6 +181,49 @@ esp_err_t xsp_ws_client_write_frame(xsp_ws_client_handle_t client,
                                     const void* payload,
                                     int timeout_ms);
 
+// Starts writing a frame without blocking: writes as much of it as the transport accepts without
+// blocking. Returns ESP_OK if the frame was completely written; otherwise, returns ESP_ERR_TIMEOUT,
+// and the rest of the frame should be written using `xsp_ws_client_continue_write()` (when the
+// client is writable). `payload` must remain valid until the frame has been completely written.
+// Only one frame may be pending at a time (otherwise, this fails with ESP_ERR_INVALID_STATE); any
+// other (blocking) write, flush, or close first completes the pending frame (blocking). As for
+// `xsp_ws_client_write_frame()`, if corked, the end of the frame is left in the write frame buffer
+// (and ESP_OK is returned), and the buffer is only written when it's full.
+esp_err_t xsp_ws_client_write_frame_nonblocking(xsp_ws_client_handle_t client,
+                                                bool fin,
+                                                xsp_ws_frame_opcode_t opcode,
+                                                int payload_size,
+                                                const void* payload);
+
+// Writes a frame in place (see `xsp_ws_client_write_frame_in_place()`) without blocking (see
+// `xsp_ws_client_write_frame_nonblocking()`). The frame is written directly from `buffer` (after
+// any frames buffered while corked), which must remain valid until it has been completely written.
+esp_err_t xsp_ws_client_write_frame_in_place_nonblocking(xsp_ws_client_handle_t client,
+                                                         bool fin,
+                                                         xsp_ws_frame_opcode_t opcode,
+                                                         int payload_size,
+                                                         void* buffer);
+
+// Continues writing the frame pending from `xsp_ws_client_write_frame_nonblocking()` (or
+// `xsp_ws_client_write_frame_in_place_nonblocking()`), or a `xsp_ws_client_flush_nonblocking()`,
+// without blocking. Returns ESP_OK once it has been completely written (or, if corked, buffered),
+// or ESP_ERR_TIMEOUT if it hasn't.
+esp_err_t xsp_ws_client_continue_write(xsp_ws_client_handle_t client);
+
+// Returns true if a nonblocking write (of a frame, or a flush) has yet to be completed.
+bool xsp_ws_client_has_pending_write(xsp_ws_client_handle_t client);
+
+// Writes a frame, like `xsp_ws_client_write_frame()`, but without copying the payload. The payload
+// must be at `buffer + XSP_WS_CLIENT_FRAME_HEADROOM`; the frame header is put before it (in the
+// headroom) and the payload is masked in place, and the whole frame is written using a single
+// transport write. The contents of `buffer` are modified, even on failure.
+esp_err_t xsp_ws_client_write_frame_in_place(xsp_ws_client_handle_t client,
+                                             bool fin,
+                                             xsp_ws_frame_opcode_t opcode,
+                                             int payload_size,
+                                             void* buffer,
+                                             int timeout_ms);
+
 // Writes a Close frame with the given status and (optional) reason. Note that the reason should be
 // valid UTF-8.
 esp_err_t xsp_ws_client_write_close_frame(xsp_ws_client_handle_t client,
@@ -96,7 +235,9 @@ esp_err_t xsp_ws_client_write_close_frame(xsp_ws_client_handle_t client,
 esp_err_t xsp_ws_client_poll_read(xsp_ws_client_handle_t client, int timeout_ms);
 
 // Reads a frame.
-// NOTE: timeout_ms is per-read at the lower layer (i.e., is a timeout for "progress").
+// NOTE: timeout_ms is per-read at the lower layer (i.e., is a timeout for "progress"). If the frame
+// header can't be read in time, this returns ESP_ERR_TIMEOUT (keeping any part of the header that
+// was read), and the read may be retried; if the payload can't be read in time, the client fails.
 esp_err_t xsp_ws_client_read_frame(xsp_ws_client_handle_t client,
                                    bool* fin,
                                    xsp_ws_frame_opcode_t* opcode,
@@ -105,6 +246,49 @@ esp_err_t xsp_ws_client_read_frame(xsp_ws_client_handle_t client,
                                    int* payload_size,
                                    int timeout_ms);
 
+// Reads a frame, like `xsp_ws_client_read_frame()`, but without copying the payload: `*payload` is
+// set to point to the payload in the client's own read buffer. The payload remains valid until the
+// next call to read a frame (or until the client is closed).
+// If the frame (including its header) is too large for the read buffer (see
+// CONFIG_XSP_WS_CLIENT_READ_BUFFER_SIZE), this returns ESP_ERR_INVALID_SIZE without consuming any
+// data; the frame may then be read using `xsp_ws_client_read_frame()` or
+// `xsp_ws_client_read_frame_chunk()`.
+// If the frame isn't completely available within `timeout_ms` (per transport read), this returns
+// ESP_ERR_TIMEOUT without consuming any data (what has been read is kept in the read buffer), so
+// the read can be retried (e.g., with a timeout of 0 when the client is next readable).
+esp_err_t xsp_ws_client_read_frame_view(xsp_ws_client_handle_t client,
+                                        bool* fin,
+                                        xsp_ws_frame_opcode_t* opcode,
+                                        const void** payload,
+                                        int* payload_size,
+                                        int timeout_ms);
+
+// Reads (part of) a frame, for frames that may be too large to buffer in their entirety. Each call
+// reads the next chunk of the current frame's payload (starting a new frame if necessary) into
+// `chunk_buffer`: `*chunk_offset` is the position of the chunk within the payload (whose total
+// size is `*payload_size`), `*chunk_size` is the number of bytes read (at most
+// `chunk_buffer_size`), and `*last_chunk` is set on the final chunk of the frame. `*fin` and
+// `*opcode` are the same for all chunks of a frame. A chunk is only ever read using at most one
+// transport read (so this may return less than is available); a frame with an empty payload has a
+// single, empty chunk.
+// If no data is available within `timeout_ms`, this returns ESP_ERR_TIMEOUT; the state of the
+// frame (including any partly-read header) is kept, and the next call continues it. Thus, with a
+// timeout of 0, this only consumes data that's already available (and never blocks, except
+// possibly for the rest of a TLS record).
+// While a frame is being read in chunks (or a frame header has been partly read), the other read
+// functions fail with ESP_ERR_INVALID_STATE (except that `xsp_ws_client_read_frame()` may continue
+// a partly-read header).
+esp_err_t xsp_ws_client_read_frame_chunk(xsp_ws_client_handle_t client,
+                                         bool* fin,
+                                         xsp_ws_frame_opcode_t* opcode,
+                                         int* payload_size,
+                                         int* chunk_offset,
+                                         int chunk_buffer_size,
+                                         void* chunk_buffer,
+                                         int* chunk_size,
+                                         bool* last_chunk,
+                                         int timeout_ms);
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif
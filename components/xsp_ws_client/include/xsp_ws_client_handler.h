@@ -9,18 +9,36 @@
 //     *   Users may want to set their own policy for message data allocation and storage.
 // *   It sends *messages* provided by the user (fragmenting them as required).
 //     *   This makes it easy to use.
-//     *   Note however that this precludes sending "streamed" messages (i.e., a message whose data
-//         is provided dynamically).
-// *   It receives and sends frames *synchronously*.
-//     *   This is because `xsp_ws_client` is synchronous.
+//     *   It can also send "streamed" messages (i.e., a message whose data is provided
+//         dynamically), pulling data from a producer callback a frame at a time, so that large
+//         messages don't have to be in memory.
+// *   Frames that are too big to be read in their entirety may (optionally) be received in chunks.
+// *   It receives frames without blocking: it only consumes data that's available when the client
+//     is readable, keeping the state of a partly-received frame (in `xsp_ws_client`) until more
+//     arrives, so that a slow peer doesn't stall the loop.
+//     *   If a frame stays partly received for longer than `read_timeout_ms` (without progress),
+//         the connection is closed.
+// *   It writes data frames without blocking (see `xsp_ws_client_write_frame_nonblocking()`),
+//     continuing them when the socket is writable, so that a slow reader doesn't stall the loop.
+//     Frames of streamed messages are produced directly into the handler's buffer, and written in
+//     place (see `xsp_ws_client_write_frame_in_place_nonblocking()`).
+//     *   Control frames (pongs, pings, and close frames) are still written synchronously (first
+//         finishing any partly-written data frame).
 // *   It sends messages asynchronously.
 //     *   This allows larger messages to be sent without blocking, and frames to be received
 //         while doing so (for multi-frame messages).
+//     *   Messages are queued (up to a configurable limit), and sent in order; each completion is
+//         reported separately.
+// *   It may (optionally) reconnect automatically when the connection is lost.
+//     *   Reconnects are delayed with exponential backoff and (full) jitter, so that many clients
+//         that lose their connections at the same time (e.g., due to a server restart) don't all
+//         reconnect at the same time.
 
 #ifndef XSP_WS_CLIENT_HANDLER_H_
 #define XSP_WS_CLIENT_HANDLER_H_
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "esp_err.h"
 
@@ -36,10 +54,60 @@ typedef struct xsp_ws_client_handler_config {
     int max_frame_read_size;        // Must be at least 125.
     int max_data_frame_write_size;  // Must be at least 1.
 
+    // The maximum time that a frame may remain partly received without progress (i.e., without any
+    // more of it, even part of its header, being received), since reads don't block; a slow frame
+    // that keeps arriving may take longer. This is checked when the loop iterates (see
+    // `poll_timeout_ms` for `xsp_loop`).
     int read_timeout_ms;
     int write_timeout_ms;
+
+    // Automatic reconnection is enabled if `reconnect_base_delay_ms` is nonzero (in which case
+    // `reconnect_max_delay_ms` must be at least it). After n consecutive failed attempts, the
+    // delay before the next reconnect attempt is chosen uniformly at random between 0 and
+    // min(reconnect_max_delay_ms, reconnect_base_delay_ms * 2^n). This requires `xsp_eventfd` and
+    // `xsp_timerfd` to be registered.
+    int reconnect_base_delay_ms;
+    int reconnect_max_delay_ms;
+
+    // If set, the client is corked (see `xsp_ws_client_set_cork()`), so that frames written during
+    // a loop iteration (e.g., many small messages, or pongs) are coalesced, and flushed (without
+    // blocking, continuing when the socket is writable) before the loop next waits (or when the
+    // write frame buffer fills).
+    bool cork;
+
+    // Limits on the send queue: the maximum number of messages (at least 1) and their maximum total
+    // size (0 for no limit) that may be scheduled to be sent (including the one being sent). Note
+    // that a message bigger than `send_queue_max_bytes` may still be sent if the queue is empty.
+    int send_queue_max_messages;
+    int send_queue_max_bytes;
 } xsp_ws_client_handler_config_t;
 
+// Send queue statistics, accumulated since the handler was initialized (or since they were last
+// reset).
+typedef struct xsp_ws_client_handler_send_queue_stats {
+    // Current number and total size of messages in the send queue.
+    int queued_messages;
+    int queued_bytes;
+    // Maximums of the above (high-water marks).
+    int max_queued_messages;
+    int max_queued_bytes;
+
+    // Number of messages completed successfully and unsuccessfully.
+    uint32_t messages_sent;
+    uint32_t messages_failed;
+    // Number of messages that couldn't be scheduled because the queue was full.
+    uint32_t messages_rejected;
+} xsp_ws_client_handler_send_queue_stats_t;
+
+// Connection states (only relevant if automatic reconnection is enabled).
+typedef enum xsp_ws_client_handler_connection_state {
+    XSP_WS_CLIENT_HANDLER_CONNECTION_STATE_CONNECTED = 0,
+    // The connection was lost, and a reconnect attempt is scheduled.
+    XSP_WS_CLIENT_HANDLER_CONNECTION_STATE_DISCONNECTED,
+    // A reconnect attempt is in progress.
+    XSP_WS_CLIENT_HANDLER_CONNECTION_STATE_CONNECTING,
+} xsp_ws_client_handler_connection_state_t;
+
 typedef struct xsp_ws_client_handler* xsp_ws_client_handler_handle_t;
 
 typedef void (*on_ws_client_closed_func_t)(xsp_ws_client_handler_handle_t handler,
@@ -51,6 +119,16 @@ typedef void (*on_ws_client_data_frame_received_func_t)(xsp_ws_client_handler_ha
                                                         xsp_ws_frame_opcode_t opcode,
                                                         int payload_size,
                                                         const void* payload);
+typedef void (*on_ws_client_data_frame_chunk_received_func_t)(
+        xsp_ws_client_handler_handle_t handler,
+        void* ctx,
+        bool fin,
+        xsp_ws_frame_opcode_t opcode,
+        int payload_size,
+        int chunk_offset,
+        int chunk_size,
+        const void* chunk,
+        bool last_chunk);
 typedef void (*on_ws_client_ping_received_func_t)(xsp_ws_client_handler_handle_t handler,
                                                   void* ctx,
                                                   int payload_size,
@@ -62,6 +140,23 @@ typedef void (*on_ws_client_pong_received_func_t)(xsp_ws_client_handler_handle_t
 typedef void (*on_ws_client_message_sent_func_t)(xsp_ws_client_handler_handle_t handler,
                                                  void* ctx,
                                                  bool success);
+// Producer for a streamed message (see `xsp_ws_client_handler_send_streamed_message()`). It should
+// put up to `max_size` (i.e., `max_data_frame_write_size`) bytes of the message's data into
+// `buffer`, and return the amount, setting `*done` if that's the end of the message; each call
+// results in a frame. If no data is available yet, it should return 0 without setting `*done`; it
+// won't be called again until `xsp_ws_client_handler_resume_streamed_message()` is called. If it
+// returns a negative value, the message fails (and, if part of it was already sent, the connection
+// is closed).
+typedef int (*xsp_ws_client_handler_producer_func_t)(xsp_ws_client_handler_handle_t handler,
+                                                     void* ctx,
+                                                     int max_size,
+                                                     void* buffer,
+                                                     bool* done);
+typedef void (*on_ws_client_connection_state_changed_func_t)(
+        xsp_ws_client_handler_handle_t handler,
+        void* ctx,
+        xsp_ws_client_handler_connection_state_t state,
+        int status);
 
 typedef struct xsp_ws_client_event_handler {
     // Event generated when the connection is closed (or failed).
@@ -76,10 +171,24 @@ typedef struct xsp_ws_client_event_handler {
     // Event generated when a pong frame is received.
     on_ws_client_pong_received_func_t on_ws_client_pong_received;
 
-    // Event generated when a message scheduled using `xsp_ws_client_loop_send_message()` has
-    // completed transmission (or the transmission has failed).
+    // Event generated when a message scheduled using `xsp_ws_client_handler_send_message()` (or
+    // one of its variants, without a callback) has completed transmission (or the transmission has
+    // failed). Messages are completed in order.
     on_ws_client_message_sent_func_t on_ws_client_message_sent;
 
+    // Optional event generated for each chunk of a data frame that's too big to be read in its
+    // entirety (i.e., bigger than `max_frame_read_size`), in which case
+    // `on_ws_client_data_frame_received` isn't generated for the frame. Chunks are provided in
+    // order, with the last having `last_chunk` set. If this is not set, such frames are rejected
+    // (and the connection closed with status 1009).
+    on_ws_client_data_frame_chunk_received_func_t on_ws_client_data_frame_chunk_received;
+
+    // Optional event generated when the connection state changes, if automatic reconnection is
+    // enabled. When disconnected, `status` is the close status (as for `on_ws_client_closed`);
+    // otherwise it is XSP_WS_STATUS_NONE. Note that a fragmented message that was being received
+    // when the connection was lost will never be completed.
+    on_ws_client_connection_state_changed_func_t on_ws_client_connection_state_changed;
+
     void* ctx;
 } xsp_ws_client_event_handler_t;
 
@@ -88,13 +197,22 @@ extern const xsp_ws_client_handler_config_t xsp_ws_client_handler_config_default
 
 // Initializes the WebSocket client handler; doesn't take ownership of the client or the loop, and
 // both should remain valid for the lifetime of the handler. The client must already be connected.
+//
+// If automatic reconnection is enabled, then when the connection is lost (or the server closes it)
+// the handler closes the client and later reopens it (using `xsp_ws_client_open_async()`), instead
+// of generating the `on_ws_client_closed` event; that event is then only generated once the
+// handler is closed using `xsp_ws_client_handler_close()` (or the loop is stopped).
 xsp_ws_client_handler_handle_t xsp_ws_client_handler_init(
         const xsp_ws_client_handler_config_t* config,
         const xsp_ws_client_event_handler_t* evt_handler,
         xsp_ws_client_handle_t client,
         xsp_loop_handle_t loop);
 
-// Cleans up (shuts down) the WebSocket client handler (does not clean up the client).
+// Cleans up (shuts down) the WebSocket client handler (does not clean up the client). If the client
+// is being (asynchronously) reopened for a reconnect, the open is canceled (see
+// `xsp_ws_client_cancel_open_async()`). Fails with ESP_ERR_INVALID_STATE if the client is being
+// (asynchronously) closed; in that case, the loop should be run until the `on_ws_client_closed`
+// event.
 esp_err_t xsp_ws_client_handler_cleanup(xsp_ws_client_handler_handle_t handler);
 
 // Returns the WS client for the handler (must be initialized and not cleaned up).
@@ -103,21 +221,68 @@ xsp_ws_client_handle_t xsp_ws_client_handler_get_ws_client(xsp_ws_client_handler
 // Returns the loop for the handler (must be initialized and not cleaned up).
 xsp_loop_handle_t xsp_ws_client_handler_get_loop(xsp_ws_client_handler_handle_t handler);
 
-// Schedules the given message to be sent. If successfully scheduled, the
-// `on_ws_client_message_sent` event handler will be called upon (successful or unsuccessful)
-// completion of the send; `message` must remain valid until then or until handler shutdown. Should
-// only be called from "inside" the loop.
+// Schedules the given message to be sent, after any previously-scheduled messages. If successfully
+// scheduled, the `on_ws_client_message_sent` event handler will be called upon (successful or
+// unsuccessful) completion of the send; `message` must remain valid until then or until handler
+// shutdown. Queued messages that can no longer be sent are completed unsuccessfully, at the latest
+// just before the `on_ws_client_closed` event. Fails with ESP_ERR_INVALID_STATE if the send queue
+// is full (see `send_queue_max_messages` and `send_queue_max_bytes`). Should only be called from
+// "inside" the loop. If automatic reconnection is enabled, messages may be scheduled while
+// disconnected; a message that hasn't been completely sent when the connection is lost is sent
+// again (in its entirety) once reconnected.
 // TODO(vtl): Possibly this should try to send the first frame immediately.
 esp_err_t xsp_ws_client_handler_send_message(xsp_ws_client_handler_handle_t handler,
                                              bool binary,
                                              int message_size,
                                              const void* message);
 
+// Like `xsp_ws_client_handler_send_message()`, but calls `on_sent` (with `on_sent_ctx`) instead of
+// the `on_ws_client_message_sent` event handler upon completion (if `on_sent` is non-null).
+esp_err_t xsp_ws_client_handler_send_message_with_callback(xsp_ws_client_handler_handle_t handler,
+                                                           bool binary,
+                                                           int message_size,
+                                                           const void* message,
+                                                           on_ws_client_message_sent_func_t on_sent,
+                                                           void* on_sent_ctx);
+
+// Schedules a streamed message to be sent (after any previously-scheduled messages), whose data
+// will be pulled from `producer` (see `xsp_ws_client_handler_producer_func_t`) as it can be sent.
+// Upon completion, `on_sent` (if non-null, else the `on_ws_client_message_sent` event handler) is
+// called. Streamed messages count towards `send_queue_max_messages`, but not
+// `send_queue_max_bytes`. If the connection is lost after part of the message was sent, the
+// message fails (it can't be sent again, even if automatic reconnection is enabled). Should only be
+// called from "inside" the loop.
+esp_err_t xsp_ws_client_handler_send_streamed_message(
+        xsp_ws_client_handler_handle_t handler,
+        bool binary,
+        xsp_ws_client_handler_producer_func_t producer,
+        void* producer_ctx,
+        on_ws_client_message_sent_func_t on_sent,
+        void* on_sent_ctx);
+
+// Resumes sending the current streamed message, after its producer indicated that no data was
+// available (by returning 0 without setting `*done`). Should only be called from "inside" the loop.
+esp_err_t xsp_ws_client_handler_resume_streamed_message(xsp_ws_client_handler_handle_t handler);
+
+// Gets the handler's send queue statistics.
+esp_err_t xsp_ws_client_handler_get_send_queue_stats(
+        xsp_ws_client_handler_handle_t handler,
+        xsp_ws_client_handler_send_queue_stats_t* stats);
+
+// Resets the handler's send queue statistics (the maximums are reset to the current values).
+esp_err_t xsp_ws_client_handler_reset_send_queue_stats(xsp_ws_client_handler_handle_t handler);
+
 // Closes the connection. Note that this sends a close message (if possible) and stops the handler;
 // it does not close the underlying client, nor does it stop the loop. Should only be called from
-// "inside" the loop.
+// "inside" the loop. If automatic reconnection is enabled, this also stops reconnecting.
 esp_err_t xsp_ws_client_handler_close(xsp_ws_client_handler_handle_t handler, int close_status);
 
+// Rejects the data frame being received, closing the connection with status 1009 (message too
+// big), exactly as if there were no `on_ws_client_data_frame_chunk_received` event handler. Unlike
+// `xsp_ws_client_handler_close()`, this doesn't stop automatic reconnection. Should only be called
+// from the `on_ws_client_data_frame_chunk_received` event handler.
+esp_err_t xsp_ws_client_handler_reject_frame(xsp_ws_client_handler_handle_t handler);
+
 // Sends a ping.
 esp_err_t xsp_ws_client_handler_ping(xsp_ws_client_handler_handle_t handler,
                                      int payload_size,
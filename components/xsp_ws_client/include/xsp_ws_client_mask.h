@@ -0,0 +1,26 @@
+// Copyright 2019 Tricot Inc.
+// Use of this source code is governed by the license in the LICENSE file.
+
+#ifndef XSP_WS_CLIENT_MASK_H_
+#define XSP_WS_CLIENT_MASK_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Masks (or unmasks) `size` bytes from `src` into `dst` (see RFC6455 section 5.3), i.e., XORs each
+// byte with `masking_key[(key_offset + i) % 4]`. `key_offset` is the position within the payload of
+// the first byte (so that a payload may be masked in pieces). `src` and `dst` may be the same (to
+// mask in place), but must not otherwise overlap. Neither need be aligned, but this is fastest if
+// they are equally aligned (modulo the word size).
+void xsp_ws_mask(const unsigned char masking_key[4],
+                 int key_offset,
+                 int size,
+                 const void* src,
+                 void* dst);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // XSP_WS_CLIENT_MASK_H_
@@ -3,28 +3,47 @@
 
 #include "xsp_ws_client.h"
 
+#include <errno.h>
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#include <sys/ioctl.h>
 #include <sys/random.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
 
 #include "esp_http_client.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "esp_transport.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "mbedtls/base64.h"
 #include "mbedtls/sha1.h"
 
+#include "xsp_eventfd.h"
+#include "xsp_ws_client_mask.h"
+
 #include "sdkconfig.h"
 
-#if CONFIG_XSP_WS_CLIENT_WRITE_FRAME_BUFFER_SIZE < 4 || \
-        CONFIG_XSP_WS_CLIENT_WRITE_FRAME_BUFFER_SIZE % 4 != 0
+// The buffer must be able to hold at least a maximal frame header (14 bytes) and some payload.
+#if CONFIG_XSP_WS_CLIENT_WRITE_FRAME_BUFFER_SIZE < 16
 #error "Invalid value for CONFIG_XSP_WS_CLIENT_WRITE_FRAME_BUFFER_SIZE"
 #endif
 
-#if CONFIG_XSP_WS_CLIENT_CLOSE_DELAY_MS < 0
-#error "Invalid value for CONFIG_XSP_WS_CLIENT_CLOSE_DELAY_MS"
+#if CONFIG_XSP_WS_CLIENT_READ_BUFFER_SIZE < 0
+#error "Invalid value for CONFIG_XSP_WS_CLIENT_READ_BUFFER_SIZE"
+#endif
+
+#if CONFIG_XSP_WS_CLIENT_OPEN_ASYNC_TASK_STACK_SIZE < 2048 || \
+        CONFIG_XSP_WS_CLIENT_OPEN_ASYNC_TASK_PRIORITY < 0
+#error "Invalid value for CONFIG_XSP_WS_CLIENT_OPEN_ASYNC_TASK_..."
+#endif
+
+#if CONFIG_XSP_WS_CLIENT_CLOSE_TIMEOUT_MS < 0
+#error "Invalid value for CONFIG_XSP_WS_CLIENT_CLOSE_TIMEOUT_MS"
 #endif
 
 typedef struct xsp_ws_client {
@@ -40,9 +59,66 @@ typedef struct xsp_ws_client {
     char* request_subprotocols;
 
     xsp_ws_client_state_t state;
+    // Set while an asynchronous open (see `xsp_ws_client_open_async()`) is in progress, i.e., until
+    // `on_open` is called or, if it was canceled, until the open task is done.
+    bool opening;
+    struct open_async_op* open_op;  // Non-null while `opening`.
+    // Set while an asynchronous close (see `xsp_ws_client_close_async()`) is in progress.
+    bool closing;
+    // Set once a Close frame has been written (so the server should close the connection).
+    bool close_frame_written;
+
+    // Buffer (of size CONFIG_XSP_WS_CLIENT_WRITE_FRAME_BUFFER_SIZE) for writing frames. The data in
+    // [write_buf_written, write_buf_used) has yet to be written: if corked, (the ends of) frames;
+    // or, after a nonblocking write or flush that couldn't complete, the rest of the data.
+    unsigned char* write_buf;
+    int write_buf_used;
+    int write_buf_written;
+    bool corked;
+
+    // State for a nonblocking frame write (see `xsp_ws_client_write_frame_nonblocking()`), set
+    // while the frame hasn't yet been completely put in the write buffer: the rest of the frame
+    // (from `pending_payload_offset`) is yet to be put in it. For a frame written in place (see
+    // `xsp_ws_client_write_frame_in_place_nonblocking()`), the "payload" is the whole (already
+    // masked) frame, which is written directly (after the write buffer), and
+    // `pending_payload_offset` is the amount of it that has been written.
+    bool write_pending;
+    bool pending_in_place;
+    bool pending_header_added;
+    bool pending_fin;
+    xsp_ws_frame_opcode_t pending_opcode;
+    unsigned char pending_masking_key[4];
+    const unsigned char* pending_payload;
+    int pending_payload_size;
+    int pending_payload_offset;
+
+    // Buffer (of size CONFIG_XSP_WS_CLIENT_READ_BUFFER_SIZE, if nonzero) for reading; the data in
+    // [read_buf_start, read_buf_end) has been read from the transport but not yet consumed.
+    unsigned char* read_buf;
+    int read_buf_start;
+    int read_buf_end;
+    // Size of the frame returned by xsp_ws_client_read_frame_view(), at the start of the buffered
+    // data; it is only consumed on the next read.
+    int view_size;
+
+    // State for xsp_ws_client_read_frame_chunk(): the number of payload bytes remaining to be read
+    // for the current frame, or -1 if not reading a frame in chunks.
+    int chunk_remaining;
+    bool chunk_fin;
+    xsp_ws_frame_opcode_t chunk_opcode;
+    int chunk_payload_size;
+
+    // The part of a frame header read so far, if reading it timed out (see `read_frame_header()`);
+    // the next read continues it.
+    unsigned char read_header_data[10];
+    int read_header_size;
+
+    xsp_ws_client_stats_t stats;
 
     // Set after open (connection established).
     char* response_subprotocols;
+    // Data read by the HTTP client past the end of the handshake response, if it didn't fit in the
+    // read buffer (otherwise, it's put in the read buffer).
     int overread_size;
     void* overread_data;
     int overread_consumed;
@@ -122,6 +198,17 @@ xsp_ws_client_handle_t xsp_ws_client_init(const xsp_ws_client_config_t* config)
             goto fail;
     }
 
+    client->write_buf = (unsigned char*)malloc(CONFIG_XSP_WS_CLIENT_WRITE_FRAME_BUFFER_SIZE);
+    if (!client->write_buf)
+        goto fail;
+
+#if CONFIG_XSP_WS_CLIENT_READ_BUFFER_SIZE > 0
+    client->read_buf = (unsigned char*)malloc(CONFIG_XSP_WS_CLIENT_READ_BUFFER_SIZE);
+    if (!client->read_buf)
+        goto fail;
+#endif
+
+    client->chunk_remaining = -1;
     client->state = XSP_WS_CLIENT_STATE_CLOSED;
 
     return client;
@@ -132,19 +219,44 @@ fail:
     return NULL;
 }
 
-esp_err_t xsp_ws_client_cleanup(xsp_ws_client_handle_t client) {
-    if (!client)
-        return ESP_FAIL;
+// Protects the state shared by the task and the loop's side of an asynchronous open: the op's
+// `refcount`, `abandoned`, and `cleanup_client`, and (once the open is canceled) the client's
+// `opening` and `open_op`. (This can't be in the op, since the open task may free the op while the
+// loop's side is getting it from the client.)
+static portMUX_TYPE g_open_async_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void cancel_open_async(xsp_ws_client_handle_t client, bool cleanup_client);
+static bool cleanup_after_canceled_open(xsp_ws_client_handle_t client);
 
+static void free_client(xsp_ws_client_handle_t client) {
     if (client->transport)
         esp_transport_destroy(client->transport);  // Ignore any error.
     free(client->overread_data);
+    free(client->read_buf);
+    free(client->write_buf);
     free(client->response_subprotocols);
     free(client->request_subprotocols);
     free(client->password);
     free(client->username);
     free(client->url);
     free(client);
+}
+
+esp_err_t xsp_ws_client_cleanup(xsp_ws_client_handle_t client) {
+    if (!client)
+        return ESP_FAIL;
+    if (client->closing)
+        return ESP_ERR_INVALID_STATE;
+
+    if (cleanup_after_canceled_open(client))
+        return ESP_OK;
+    if (client->opening) {
+        // The open task may still be using the client, so it's freed once the task is done.
+        cancel_open_async(client, true);
+        return ESP_OK;
+    }
+
+    free_client(client);
     return ESP_OK;
 }
 
@@ -266,12 +378,10 @@ static esp_err_t http_event_handler(esp_http_client_event_t* evt) {
     return ESP_OK;
 }
 
-esp_err_t xsp_ws_client_open(xsp_ws_client_handle_t client) {
-    if (!client)
-        return ESP_ERR_INVALID_ARG;
-    if (client->transport || client->state != XSP_WS_CLIENT_STATE_CLOSED)
-        return ESP_ERR_INVALID_STATE;
-
+// Does the work of `xsp_ws_client_open()` (after argument and state checks). This blocks (for DNS,
+// connecting, the TLS handshake, and the HTTP upgrade request).
+static esp_err_t do_open(xsp_ws_client_handle_t client) {
+    int64_t start_us = esp_timer_get_time();
     esp_err_t err;
     esp_http_client_handle_t http_client = NULL;
 
@@ -399,9 +509,23 @@ esp_err_t xsp_ws_client_open(xsp_ws_client_handle_t client) {
         err = ESP_FAIL;
         goto done;
     }
-    if (overread_size > 0) {
-        client->overread_size = overread_size;
+    client->overread_size = 0;
+    client->overread_consumed = 0;
+    client->read_buf_start = 0;
+    client->read_buf_end = 0;
+    if (overread_size > 0 && overread_size <= CONFIG_XSP_WS_CLIENT_READ_BUFFER_SIZE) {
+        // Usually, the overread data (which is limited by the HTTP client's buffer size) fits in
+        // our read buffer, so put it there directly; the first frames can then be read in place.
+        memcpy(client->read_buf, overread_data, (size_t)overread_size);
+        client->read_buf_end = overread_size;
+    } else if (overread_size > 0) {
         client->overread_data = malloc((size_t)overread_size);
+        if (!client->overread_data) {
+            ESP_LOGE(TAG, "Failed to allocate overread buffer");
+            err = ESP_ERR_NO_MEM;
+            goto done;
+        }
+        client->overread_size = overread_size;
         memcpy(client->overread_data, overread_data, (size_t)overread_size);
     }
 
@@ -418,6 +542,8 @@ esp_err_t xsp_ws_client_open(xsp_ws_client_handle_t client) {
         goto done;
     }
     client->state = XSP_WS_CLIENT_STATE_OK;
+    client->stats.opens++;
+    client->stats.open_time_us += (uint64_t)(esp_timer_get_time() - start_us);
 
 done:
     if (http_client)
@@ -427,17 +553,265 @@ done:
     return err;
 }
 
-esp_err_t xsp_ws_client_close(xsp_ws_client_handle_t client) {
+esp_err_t xsp_ws_client_open(xsp_ws_client_handle_t client) {
+    if (!client)
+        return ESP_ERR_INVALID_ARG;
+    if (client->opening || client->closing || client->transport ||
+        client->state != XSP_WS_CLIENT_STATE_CLOSED) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    return do_open(client);
+}
+
+static void finish_close(xsp_ws_client_handle_t client);
+
+// State for an asynchronous open. This is shared by the open task and the loop's side (the FD
+// watcher), and is freed when both are done with it: the open task is done once it has finished
+// opening (and signalled the event FD), and the loop's side once `on_open` is called or the open is
+// canceled.
+typedef struct open_async_op {
+    unsigned refcount;    // Protected by `g_open_async_lock`.
+    bool abandoned;       // Protected by `g_open_async_lock`. Set if canceled.
+    bool cleanup_client;  // Protected by `g_open_async_lock`. Set if the client should be freed.
+
+    xsp_ws_client_handle_t client;
+    xsp_loop_handle_t loop;
+    xsp_ws_client_on_open_func_t on_open;
+    void* ctx;
+
+    int fd;  // Event FD, signalled by the open task when done.
+    xsp_eventfd_handle_t efd;
+    xsp_loop_fd_watcher_handle_t fd_watcher;
+
+    esp_err_t result;  // Only valid once the event FD has been signalled.
+} open_async_op_t;
+
+// Drops a reference to `op`, freeing it if it was the last. If the open was canceled, this also
+// closes (and possibly frees) the client, which nothing else is using by then.
+static void open_async_op_unref(open_async_op_t* op) {
+    portENTER_CRITICAL(&g_open_async_lock);
+    bool last = --op->refcount == 0;
+    bool abandoned = op->abandoned;
+    portEXIT_CRITICAL(&g_open_async_lock);
+    if (!last)
+        return;
+
+    if (abandoned) {
+        xsp_ws_client_handle_t client = op->client;
+        // The open may have succeeded; nothing has been written, so this doesn't need a shutdown.
+        finish_close(client);
+        // The client may be cleaned up (see `xsp_ws_client_cleanup()`) until `opening` is cleared.
+        portENTER_CRITICAL(&g_open_async_lock);
+        bool cleanup_client = op->cleanup_client;
+        if (!cleanup_client) {
+            client->opening = false;
+            client->open_op = NULL;
+        }
+        portEXIT_CRITICAL(&g_open_async_lock);
+        if (cleanup_client)
+            free_client(client);
+    }
+    close(op->fd);
+    free(op);
+}
+
+static void open_async_task(void* pvParameters) {
+    open_async_op_t* op = (open_async_op_t*)pvParameters;
+    op->result = do_open(op->client);
+
+    portENTER_CRITICAL(&g_open_async_lock);
+    bool abandoned = op->abandoned;
+    portEXIT_CRITICAL(&g_open_async_lock);
+    if (!abandoned)
+        xsp_eventfd_write(op->efd, 1);  // This never fails (the value is at most 1).
+
+    open_async_op_unref(op);
+    vTaskDelete(NULL);
+}
+
+static void open_async_op_cleanup(open_async_op_t* op) {
+    if (op->fd_watcher)
+        xsp_loop_remove_fd_watcher(op->loop, op->fd_watcher);  // Ignore any error.
+    if (op->fd != -1)
+        close(op->fd);
+    free(op);
+}
+
+static void on_open_async_can_read_fd(xsp_loop_handle_t loop, void* ctx, int fd) {
+    open_async_op_t* op = (open_async_op_t*)ctx;
+
+    xsp_ws_client_handle_t client = op->client;
+    xsp_ws_client_on_open_func_t on_open = op->on_open;
+    void* on_open_ctx = op->ctx;
+    esp_err_t result = op->result;
+    // Note: Removing the FD watcher from inside its event handler is OK.
+    xsp_loop_remove_fd_watcher(op->loop, op->fd_watcher);  // Ignore any error.
+    op->fd_watcher = NULL;
+    // The open task has signalled, so it no longer uses the client (only `op`).
+    client->opening = false;
+    client->open_op = NULL;
+    open_async_op_unref(op);
+
+    on_open(client, on_open_ctx, result);
+}
+
+// Cancels an asynchronous open (`client->opening` must be set). The loop's side is done
+// immediately; the rest happens when the open task is done (which may be now).
+static void cancel_open_async(xsp_ws_client_handle_t client, bool cleanup_client) {
+    open_async_op_t* op = client->open_op;
+    xsp_loop_remove_fd_watcher(op->loop, op->fd_watcher);  // Ignore any error.
+    op->fd_watcher = NULL;
+
+    portENTER_CRITICAL(&g_open_async_lock);
+    op->abandoned = true;
+    op->cleanup_client = cleanup_client;
+    portEXIT_CRITICAL(&g_open_async_lock);
+
+    open_async_op_unref(op);
+}
+
+// If an asynchronous open was canceled, but its task isn't done yet, has the task free the client
+// when it's done and returns true. (The loop's side is already done, so it mustn't drop its
+// reference again.)
+static bool cleanup_after_canceled_open(xsp_ws_client_handle_t client) {
+    portENTER_CRITICAL(&g_open_async_lock);
+    bool canceled = client->opening && !client->open_op->fd_watcher;
+    if (canceled)
+        client->open_op->cleanup_client = true;
+    portEXIT_CRITICAL(&g_open_async_lock);
+    return canceled;
+}
+
+esp_err_t xsp_ws_client_cancel_open_async(xsp_ws_client_handle_t client) {
     if (!client)
         return ESP_ERR_INVALID_ARG;
+    // Note: If the open was already canceled, the loop's side is done (but `opening` remains set
+    // until the open task is done, and the op may be freed at any time).
+    portENTER_CRITICAL(&g_open_async_lock);
+    bool can_cancel = client->opening && client->open_op->fd_watcher;
+    portEXIT_CRITICAL(&g_open_async_lock);
+    if (!can_cancel)
+        return ESP_ERR_INVALID_STATE;
+
+    cancel_open_async(client, false);
+    return ESP_OK;
+}
+
+esp_err_t xsp_ws_client_open_async(xsp_ws_client_handle_t client,
+                                   xsp_loop_handle_t loop,
+                                   xsp_ws_client_on_open_func_t on_open,
+                                   void* ctx) {
+    if (!client || !loop || !on_open)
+        return ESP_ERR_INVALID_ARG;
+    if (client->opening || client->closing || client->transport ||
+        client->state != XSP_WS_CLIENT_STATE_CLOSED) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    open_async_op_t* op = (open_async_op_t*)calloc(1, sizeof(open_async_op_t));
+    if (!op) {
+        ESP_LOGE(TAG, "Allocation failed");
+        return ESP_ERR_NO_MEM;
+    }
+    op->refcount = 2;  // One for the open task, and one for the loop's side.
+    op->client = client;
+    op->loop = loop;
+    op->on_open = on_open;
+    op->ctx = ctx;
+
+    op->fd = xsp_eventfd(0, XSP_EVENTFD_NONBLOCK);
+    if (op->fd == -1) {
+        ESP_LOGE(TAG, "Eventfd creation failed");
+        goto fail;
+    }
+    if (ioctl(op->fd, XSP_EVENTFD_IOCTL_GET_HANDLE, &op->efd) != 0) {
+        ESP_LOGE(TAG, "Failed to obtain eventfd handle");
+        goto fail;
+    }
+
+    xsp_loop_fd_event_handler_t loop_fd_event_handler = {
+            NULL, NULL, on_open_async_can_read_fd, op, op->fd,
+    };
+    op->fd_watcher = xsp_loop_add_fd_watcher(loop, &loop_fd_event_handler);
+    if (!op->fd_watcher) {
+        ESP_LOGE(TAG, "Failed to watch FD");
+        goto fail;
+    }
+    // This allows the loop to wait on the event FD using task notifications (if so configured).
+    if (xsp_loop_set_fd_watcher_eventfd(loop, op->fd_watcher, op->efd) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to set FD watcher eventfd");
+        goto fail;
+    }
+
+    client->opening = true;
+    client->open_op = op;
+    if (xTaskCreate(&open_async_task, "WS_OPEN", CONFIG_XSP_WS_CLIENT_OPEN_ASYNC_TASK_STACK_SIZE,
+                    op, CONFIG_XSP_WS_CLIENT_OPEN_ASYNC_TASK_PRIORITY, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create open task");
+        client->opening = false;
+        client->open_op = NULL;
+        goto fail;
+    }
+    return ESP_OK;
+
+fail:
+    open_async_op_cleanup(op);
+    return ESP_FAIL;
+}
+
+static esp_err_t continue_write(xsp_ws_client_handle_t client, int timeout_ms, bool flush);
+static bool flush_write_buf(xsp_ws_client_handle_t client, int timeout_ms);
+
+// Reads (and discards) data from the socket without blocking. Returns true if the server has
+// closed the connection (or on error), or false if there's nothing more to read for now.
+static bool drain_socket(int fd) {
+    char buf[64];
+    for (;;) {
+        int result = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+        if (result > 0)
+            continue;
+        return !(result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+    }
+}
+
+// Returns the transport's socket FD, or -1 if there's no transport (or on error).
+static int get_transport_fd(xsp_ws_client_handle_t client) {
+    return client->transport ? esp_transport_get_select_fd(client->transport) : -1;
+}
+
+// Returns true if there's buffered or pending data to be written before shutting down.
+static bool has_unwritten_data(xsp_ws_client_handle_t client) {
+    return can_write(client->state) && (client->write_pending || client->write_buf_used > 0);
+}
+
+// Shuts down the socket for writing, so that everything written is sent (followed by a FIN), and
+// discards anything that has been received (since closing a socket with unread data makes lwIP send
+// a RST instead). Returns true if we should then wait for the server to close the connection (i.e.,
+// if a Close frame has been written and the connection hasn't failed).
+static bool shutdown_socket(xsp_ws_client_handle_t client, int fd) {
+    shutdown(fd, SHUT_WR);  // Ignore any error.
+    return !drain_socket(fd) && client->close_frame_written &&
+           client->state != XSP_WS_CLIENT_STATE_FAILED_NO_CLOSE;
+}
+
+// Starts shutting down the transport (if any) gracefully: writes anything buffered (blocking), and
+// shuts down the socket (see `shutdown_socket()`). Returns the socket FD if we should then wait for
+// the server to close the connection, or -1 if not.
+static int start_shutdown(xsp_ws_client_handle_t client) {
+    int fd = get_transport_fd(client);
+    if (fd < 0)
+        return -1;
+    flush_write_buf(client, CONFIG_XSP_WS_CLIENT_CLOSE_TIMEOUT_MS);  // Ignore any error.
+    return shutdown_socket(client, fd) ? fd : -1;
+}
+
+// Finishes closing: closes the transport (if any) and resets the state.
+static void finish_close(xsp_ws_client_handle_t client) {
     client->state = XSP_WS_CLIENT_STATE_CLOSED;
     free(client->response_subprotocols);
     client->response_subprotocols = NULL;
     if (client->transport) {
-        // TODO(vtl): This delay is to try to ensure that everything we wrote gets sent out. Surely
-        // there's a better way to do this....
-        vTaskDelay((CONFIG_XSP_WS_CLIENT_CLOSE_DELAY_MS + (portTICK_PERIOD_MS - 1)) /
-                   portTICK_PERIOD_MS);
         esp_transport_close(client->transport);    // Ignore any error.
         esp_transport_destroy(client->transport);  // Ignore any error.
         client->transport = NULL;
@@ -446,6 +820,147 @@ esp_err_t xsp_ws_client_close(xsp_ws_client_handle_t client) {
         free(client->overread_data);
         client->overread_data = NULL;
     }
+    client->write_buf_used = 0;
+    client->write_pending = false;
+    client->write_buf_written = 0;
+    client->read_buf_start = 0;
+    client->read_buf_end = 0;
+    client->view_size = 0;
+    client->chunk_remaining = -1;
+    client->read_header_size = 0;
+    client->close_frame_written = false;
+}
+
+esp_err_t xsp_ws_client_close(xsp_ws_client_handle_t client) {
+    if (!client)
+        return ESP_ERR_INVALID_ARG;
+    if (client->opening || client->closing)
+        return ESP_ERR_INVALID_STATE;
+
+    int fd = start_shutdown(client);
+    if (fd >= 0) {
+        // Wait (up to the timeout) for the server to close the connection.
+        int64_t deadline_us = esp_timer_get_time() + CONFIG_XSP_WS_CLIENT_CLOSE_TIMEOUT_MS * 1000LL;
+        for (;;) {
+            int64_t remaining_us = deadline_us - esp_timer_get_time();
+            if (remaining_us <= 0)
+                break;
+            fd_set read_fds;
+            FD_ZERO(&read_fds);
+            FD_SET(fd, &read_fds);
+            struct timeval timeout = {
+                    .tv_sec = (time_t)(remaining_us / 1000000),
+                    .tv_usec = (suseconds_t)(remaining_us % 1000000),
+            };
+            if (select(fd + 1, &read_fds, NULL, NULL, &timeout) <= 0 || drain_socket(fd))
+                break;
+        }
+    }
+    finish_close(client);
+    return ESP_OK;
+}
+
+// State for an asynchronous close.
+typedef struct close_async_op {
+    xsp_ws_client_handle_t client;
+    xsp_loop_handle_t loop;
+    xsp_ws_client_on_closed_func_t on_closed;
+    void* ctx;
+
+    int64_t deadline_us;
+    // Set while buffered or pending data is being written (without blocking), before the socket is
+    // shut down.
+    bool flushing;
+    xsp_loop_fd_watcher_handle_t fd_watcher;  // Watches the socket FD (owned by the transport).
+} close_async_op_t;
+
+static void close_async_op_complete(close_async_op_t* op) {
+    xsp_ws_client_handle_t client = op->client;
+    xsp_ws_client_on_closed_func_t on_closed = op->on_closed;
+    void* ctx = op->ctx;
+    // Note: Removing the FD watcher from inside its event handler is OK.
+    xsp_loop_remove_fd_watcher(op->loop, op->fd_watcher);  // Ignore any error.
+    free(op);
+
+    client->closing = false;
+    finish_close(client);
+    on_closed(client, ctx);
+}
+
+static xsp_loop_fd_watch_for_t on_close_async_will_select(xsp_loop_handle_t loop,
+                                                          void* ctx,
+                                                          int fd) {
+    close_async_op_t* op = (close_async_op_t*)ctx;
+    // Note: This is checked every loop iteration, which happens at least every loop poll timeout.
+    if (esp_timer_get_time() >= op->deadline_us) {
+        close_async_op_complete(op);
+        return XSP_LOOP_FD_WATCH_FOR_NONE;
+    }
+    return op->flushing ? XSP_LOOP_FD_WATCH_FOR_WRITE : XSP_LOOP_FD_WATCH_FOR_READ;
+}
+
+static void on_close_async_can_write_fd(xsp_loop_handle_t loop, void* ctx, int fd) {
+    close_async_op_t* op = (close_async_op_t*)ctx;
+    if (!op->flushing)
+        return;
+    // Note: On failure, the client fails (so we won't wait for the server).
+    if (continue_write(op->client, -1, true) == ESP_ERR_TIMEOUT)
+        return;
+    op->flushing = false;
+    if (!shutdown_socket(op->client, fd))
+        close_async_op_complete(op);
+}
+
+static void on_close_async_can_read_fd(xsp_loop_handle_t loop, void* ctx, int fd) {
+    close_async_op_t* op = (close_async_op_t*)ctx;
+    if (drain_socket(fd))
+        close_async_op_complete(op);
+}
+
+esp_err_t xsp_ws_client_close_async(xsp_ws_client_handle_t client,
+                                    xsp_loop_handle_t loop,
+                                    xsp_ws_client_on_closed_func_t on_closed,
+                                    void* ctx) {
+    if (!client || !loop || !on_closed)
+        return ESP_ERR_INVALID_ARG;
+    if (client->opening || client->closing)
+        return ESP_ERR_INVALID_STATE;
+
+    // If there's anything to write, it's written without blocking (when the socket is writable)
+    // before the socket is shut down.
+    int fd = get_transport_fd(client);
+    bool flushing = fd >= 0 && has_unwritten_data(client);
+    if (fd >= 0 && !flushing && !shutdown_socket(client, fd))
+        fd = -1;
+    if (fd >= 0) {
+        close_async_op_t* op = (close_async_op_t*)calloc(1, sizeof(close_async_op_t));
+        if (op) {
+            op->client = client;
+            op->loop = loop;
+            op->on_closed = on_closed;
+            op->ctx = ctx;
+            op->deadline_us =
+                    esp_timer_get_time() + CONFIG_XSP_WS_CLIENT_CLOSE_TIMEOUT_MS * 1000LL;
+            op->flushing = flushing;
+            xsp_loop_fd_event_handler_t loop_fd_event_handler = {
+                    on_close_async_will_select, on_close_async_can_write_fd,
+                    on_close_async_can_read_fd, op, fd,
+            };
+            op->fd_watcher = xsp_loop_add_fd_watcher(loop, &loop_fd_event_handler);
+            if (op->fd_watcher) {
+                client->closing = true;
+                return ESP_OK;
+            }
+            ESP_LOGE(TAG, "Failed to watch FD");
+            free(op);
+        } else {
+            ESP_LOGE(TAG, "Allocation failed");
+        }
+    }
+
+    // There's nothing to wait for (or we couldn't wait), so just close now.
+    finish_close(client);
+    on_closed(client, ctx);
     return ESP_OK;
 }
 
@@ -457,6 +972,124 @@ const char* xsp_ws_client_get_response_subprotocols(xsp_ws_client_handle_t clien
     return client->response_subprotocols;
 }
 
+typedef struct frame_header {
+    bool fin;
+    int reserved;  // Reserved bits (should be 0).
+    int opcode;    // Not necessarily valid.
+    bool masked;
+    int payload_size;           // -1 if too big.
+    bool minimal_payload_size;  // Whether the payload size was minimally encoded.
+} frame_header_t;
+
+// Parses a frame header from the `size` bytes at `data`, returning the size of the complete header.
+// If this is greater than `size`, more data is needed and `*header` is not set.
+// NOTE: This does not include the masking key, since frames from the server must not be masked.
+static int parse_frame_header(const unsigned char* data, int size, frame_header_t* header) {
+    // See RFC6455.
+    if (size < 2)
+        return 2;
+    int size_bits = data[1] & 0x7f;
+    int header_size = (size_bits == 126) ? 4 : (size_bits == 127) ? 10 : 2;
+    if (size < header_size)
+        return header_size;
+
+    header->fin = (data[0] & 0x80) != 0;
+    header->reserved = data[0] & 0x70;
+    header->opcode = data[0] & 0x0f;
+    header->masked = (data[1] & 0x80) != 0;
+    if (size_bits == 126) {
+        // Network byte order (big endian) 16-bit value.
+        header->payload_size = ((int)data[2] << 8) | (int)data[3];
+        header->minimal_payload_size = header->payload_size > 125;
+    } else if (size_bits == 127) {
+        // Network byte order (big endian) 64-bit value.
+        if (data[2] != 0 || data[3] != 0 || data[4] != 0 || data[5] != 0 || (data[6] & 0x80) != 0) {
+            header->payload_size = -1;  // Too big!
+            header->minimal_payload_size = true;
+        } else {
+            header->payload_size = ((int)data[6] << 24) | ((int)data[7] << 16) |
+                                   ((int)data[8] << 8) | (int)data[9];
+            header->minimal_payload_size = header->payload_size > 0xffff;
+        }
+    } else {
+        header->payload_size = size_bits;
+        header->minimal_payload_size = true;
+    }
+    return header_size;
+}
+
+// Gets the data that has been read from the transport but not yet consumed (excluding any frame
+// view), returning its size.
+// Note: The read buffer is only filled once the overread data (from the HTTP client) has been
+// consumed, so the buffered data is always contiguous.
+static int get_buffered_data(xsp_ws_client_handle_t client, const unsigned char** data) {
+    if (client->overread_data) {
+        *data = (const unsigned char*)client->overread_data + client->overread_consumed +
+                client->view_size;
+        return client->overread_size - client->overread_consumed - client->view_size;
+    }
+    *data = client->read_buf + client->read_buf_start + client->view_size;
+    return client->read_buf_end - client->read_buf_start - client->view_size;
+}
+
+// Consumes buffered data; there must not be a frame view.
+static void consume_buffered_data(xsp_ws_client_handle_t client, int size) {
+    if (client->overread_data) {
+        client->overread_consumed += size;
+        if (client->overread_consumed == client->overread_size) {
+            free(client->overread_data);
+            client->overread_data = NULL;
+        }
+        return;
+    }
+    client->read_buf_start += size;
+    if (client->read_buf_start == client->read_buf_end) {
+        client->read_buf_start = 0;
+        client->read_buf_end = 0;
+    }
+}
+
+// Consumes the frame returned by xsp_ws_client_read_frame_view() (if any).
+static void release_view(xsp_ws_client_handle_t client) {
+    int size = client->view_size;
+    client->view_size = 0;
+    if (size > 0)
+        consume_buffered_data(client, size);
+}
+
+// Returns true if a complete frame has been read (from the transport) but not yet consumed (or, if
+// reading a frame in chunks, if the next chunk can be read without reading from the transport).
+static bool has_buffered_frame(xsp_ws_client_handle_t client) {
+    const unsigned char* data;
+    int size = get_buffered_data(client, &data);
+    // When reading a frame in chunks, any buffered data can be read as a chunk. Similarly, if a
+    // frame header was partly read, the read can continue with any buffered data.
+    if (client->chunk_remaining >= 0)
+        return size > 0 || client->chunk_remaining == 0;
+    if (client->read_header_size > 0)
+        return size > 0;
+    frame_header_t header;
+    int header_size = parse_frame_header(data, size, &header);
+    if (header_size > size)
+        return false;
+    // If the payload size is bad, reading the frame will fail immediately.
+    return header.payload_size < 0 || size - header_size >= header.payload_size;
+}
+
+esp_err_t xsp_ws_client_get_stats(xsp_ws_client_handle_t client, xsp_ws_client_stats_t* stats) {
+    if (!client || !stats)
+        return ESP_ERR_INVALID_ARG;
+    *stats = client->stats;
+    return ESP_OK;
+}
+
+esp_err_t xsp_ws_client_reset_stats(xsp_ws_client_handle_t client) {
+    if (!client)
+        return ESP_ERR_INVALID_ARG;
+    memset(&client->stats, 0, sizeof(client->stats));
+    return ESP_OK;
+}
+
 int xsp_ws_client_get_select_fd(xsp_ws_client_handle_t client) {
     if (!client)
         return -1;
@@ -474,7 +1107,7 @@ bool xsp_ws_client_has_buffered_read_data(xsp_ws_client_handle_t client) {
         return false;
     if (!can_read(client->state))
         return false;
-    return client->overread_consumed < client->overread_size;
+    return has_buffered_frame(client);
 }
 
 esp_err_t xsp_ws_client_poll_write(xsp_ws_client_handle_t client, int timeout_ms) {
@@ -491,16 +1124,15 @@ esp_err_t xsp_ws_client_poll_write(xsp_ws_client_handle_t client, int timeout_ms
     return err;
 }
 
-static bool write_frame_header(esp_transport_handle_t transport,
-                               bool fin,
-                               xsp_ws_frame_opcode_t opcode,
-                               int payload_size,
-                               unsigned char masking_key[4],
-                               int timeout_ms) {
+// Puts the frame header into `header` (which must have room for 14 bytes), returning its size.
+static int make_frame_header(bool fin,
+                             xsp_ws_frame_opcode_t opcode,
+                             int payload_size,
+                             const unsigned char masking_key[4],
+                             unsigned char* header) {
     // See RFC6455.
     // Max size = (flags) + (mask flag/payload size) + (ext. payload size) + (masking key)
     //          = 1 + 1 + 8 + 4 = 14.
-    unsigned char header[14];
     int size = 0;
 
     header[size++] = (unsigned char)((fin ? 0x80 : 0) | opcode);
@@ -530,9 +1162,306 @@ static bool write_frame_header(esp_transport_handle_t transport,
     memcpy(&header[size], masking_key, 4);
     size += 4;
 
-    // NOTE: If esp_transport_write() returns 0, we can't tell if it's due to timeout or due to some
-    // other failure.
-    return esp_transport_write(transport, (const char*)header, size, timeout_ms) == size;
+    return size;
+}
+
+// Writes all of the given data, possibly using multiple transport writes (e.g., SSL writes at most
+// one record at a time).
+static bool write_data(xsp_ws_client_handle_t client, const void* data, int size, int timeout_ms) {
+    const char* p = (const char*)data;
+    while (size > 0) {
+        client->stats.transport_writes++;
+        // NOTE: If esp_transport_write() returns 0, we can't tell if it's due to timeout or due to
+        // some other failure.
+        int result = esp_transport_write(client->transport, p, size, timeout_ms);
+        if (result <= 0)
+            return false;
+        client->stats.bytes_written += (uint64_t)result;
+        p += result;
+        size -= result;
+    }
+    return true;
+}
+
+// Writes as much of the given data as the transport accepts without blocking, in pieces of at most
+// CONFIG_XSP_WS_CLIENT_NONBLOCKING_WRITE_SIZE bytes. Returns the amount written, or -1 on failure.
+static int write_data_nonblocking(xsp_ws_client_handle_t client, const void* data, int size) {
+    const char* p = (const char*)data;
+    int written = 0;
+    while (written < size) {
+        int piece_size = size - written;
+        if (piece_size > CONFIG_XSP_WS_CLIENT_NONBLOCKING_WRITE_SIZE)
+            piece_size = CONFIG_XSP_WS_CLIENT_NONBLOCKING_WRITE_SIZE;
+        // With a zero timeout, this only writes if the socket is writable. With lwIP, that means
+        // that it has more than TCP_SNDLOWAT bytes of send buffer space, so that writing a piece
+        // (that isn't bigger than that) won't block. NOTE: As for `write_data()`, 0 may also
+        // indicate failure, but then the socket will poll as writable and the next write fails.
+        int result = esp_transport_write(client->transport, p + written, piece_size, 0);
+        if (result < 0)
+            return -1;
+        if (result == 0)
+            break;
+        client->stats.transport_writes++;
+        client->stats.bytes_written += (uint64_t)result;
+        written += result;
+    }
+    return written;
+}
+
+static void reset_pending_write(xsp_ws_client_handle_t client) {
+    client->write_pending = false;
+    client->write_buf_used = 0;
+    client->write_buf_written = 0;
+    client->pending_payload = NULL;
+}
+
+// Puts as much of the pending frame (the header, then the masked payload) into the write buffer as
+// fits.
+static void fill_pending_write(xsp_ws_client_handle_t client) {
+    if (!client->pending_header_added) {
+        // There may be frames buffered while corked in the way.
+        if (client->write_buf_used + XSP_WS_CLIENT_FRAME_HEADROOM >
+            CONFIG_XSP_WS_CLIENT_WRITE_FRAME_BUFFER_SIZE) {
+            return;
+        }
+        client->write_buf_used +=
+                make_frame_header(client->pending_fin, client->pending_opcode,
+                                  client->pending_payload_size, client->pending_masking_key,
+                                  client->write_buf + client->write_buf_used);
+        client->pending_header_added = true;
+    }
+    int chunk_size = CONFIG_XSP_WS_CLIENT_WRITE_FRAME_BUFFER_SIZE - client->write_buf_used;
+    if (chunk_size > client->pending_payload_size - client->pending_payload_offset)
+        chunk_size = client->pending_payload_size - client->pending_payload_offset;
+    xsp_ws_mask(client->pending_masking_key, client->pending_payload_offset, chunk_size,
+                client->pending_payload + client->pending_payload_offset,
+                client->write_buf + client->write_buf_used);
+    client->write_buf_used += chunk_size;
+    client->pending_payload_offset += chunk_size;
+}
+
+// Writes data, blocking (if `timeout_ms` is nonnegative; see `write_data()`) or not (if it's
+// negative; see `write_data_nonblocking()`). Returns the amount written, or -1 on failure (in
+// which case the client fails).
+static int write_some(xsp_ws_client_handle_t client, const void* data, int size, int timeout_ms) {
+    int result;
+    if (timeout_ms < 0)
+        result = write_data_nonblocking(client, data, size);
+    else
+        result = write_data(client, data, size, timeout_ms) ? size : -1;
+    // We don't know why it failed, so we have to assume that the transport is bad.
+    if (result < 0)
+        client->state = XSP_WS_CLIENT_STATE_FAILED_NO_CLOSE;
+    return result;
+}
+
+// Writes the unwritten data in the write buffer (emptying it if it's all written). Returns ESP_OK
+// if it's all written, ESP_ERR_TIMEOUT if not (only if `timeout_ms` is negative), or ESP_FAIL.
+static esp_err_t write_buffered(xsp_ws_client_handle_t client, int timeout_ms) {
+    int remaining = client->write_buf_used - client->write_buf_written;
+    if (remaining > 0) {
+        int result = write_some(client, client->write_buf + client->write_buf_written, remaining,
+                                timeout_ms);
+        if (result < 0)
+            return ESP_FAIL;
+        client->write_buf_written += result;
+        if (result < remaining)
+            return ESP_ERR_TIMEOUT;
+    }
+    client->write_buf_used = 0;
+    client->write_buf_written = 0;
+    return ESP_OK;
+}
+
+// Marks the pending frame as written (which, if corked, may only mean that it's in the buffer).
+static void complete_pending_write(xsp_ws_client_handle_t client) {
+    if (client->pending_opcode == XSP_WS_FRAME_OPCODE_CONNECTION_CLOSE)
+        client->close_frame_written = true;
+    client->stats.frames_written++;
+    client->write_pending = false;
+    client->pending_payload = NULL;
+}
+
+// Continues writing the pending frame (if any) and then the write buffer. If `timeout_ms` is
+// negative, this doesn't block, and returns ESP_ERR_TIMEOUT if not everything could be written;
+// otherwise, it blocks (with the timeout applying to each write, as for `write_data()`). If corked
+// (and not `flush`ing), the end of the frame is left in the write buffer, as for
+// `xsp_ws_client_write_frame()`, unless the buffer was already being written. On failure,
+// everything is discarded (and the client fails).
+static esp_err_t continue_write(xsp_ws_client_handle_t client, int timeout_ms, bool flush) {
+    esp_err_t err;
+    while (client->write_pending) {
+        if (client->pending_in_place) {
+            // Anything buffered goes first.
+            err = write_buffered(client, timeout_ms);
+            if (err != ESP_OK)
+                goto done;
+            int remaining = client->pending_payload_size - client->pending_payload_offset;
+            int result =
+                    write_some(client, client->pending_payload + client->pending_payload_offset,
+                               remaining, timeout_ms);
+            if (result < 0) {
+                err = ESP_FAIL;
+                goto done;
+            }
+            client->pending_payload_offset += result;
+            if (result < remaining)
+                return ESP_ERR_TIMEOUT;
+            complete_pending_write(client);
+            return ESP_OK;
+        }
+
+        fill_pending_write(client);
+        if (client->pending_header_added &&
+            client->pending_payload_offset == client->pending_payload_size) {
+            complete_pending_write(client);
+            break;
+        }
+        // The buffer is full, so write it to make room for the rest of the frame.
+        err = write_buffered(client, timeout_ms);
+        if (err != ESP_OK)
+            goto done;
+    }
+
+    if (client->corked && !flush && client->write_buf_written == 0)
+        return ESP_OK;
+    err = write_buffered(client, timeout_ms);
+
+done:
+    if (err == ESP_FAIL)
+        reset_pending_write(client);
+    return err;
+}
+
+// Writes any frames buffered while corked (and first finishes any pending nonblocking write). On
+// failure, the buffered frames are discarded (and the client fails).
+static bool flush_write_buf(xsp_ws_client_handle_t client, int timeout_ms) {
+    if (!client->write_pending && client->write_buf_used == 0)
+        return true;
+    if (!can_write(client->state)) {
+        reset_pending_write(client);
+        return false;
+    }
+    return continue_write(client, timeout_ms, true) == ESP_OK;
+}
+
+esp_err_t xsp_ws_client_set_cork(xsp_ws_client_handle_t client, bool cork) {
+    if (!client)
+        return ESP_ERR_INVALID_ARG;
+
+    client->corked = cork;
+    return ESP_OK;
+}
+
+esp_err_t xsp_ws_client_flush(xsp_ws_client_handle_t client, int timeout_ms) {
+    if (!client || timeout_ms < 0)
+        return ESP_ERR_INVALID_ARG;
+    if (client->write_buf_used > 0 && !client->transport)
+        return ESP_ERR_INVALID_STATE;
+
+    return flush_write_buf(client, timeout_ms) ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t xsp_ws_client_flush_nonblocking(xsp_ws_client_handle_t client) {
+    if (!client)
+        return ESP_ERR_INVALID_ARG;
+    if (!client->transport || client->write_pending)
+        return ESP_ERR_INVALID_STATE;
+    if (client->write_buf_used == 0)
+        return ESP_OK;
+    if (!can_write(client->state)) {
+        reset_pending_write(client);
+        return ESP_FAIL;
+    }
+
+    return continue_write(client, -1, true);
+}
+
+esp_err_t xsp_ws_client_write_frame_nonblocking(xsp_ws_client_handle_t client,
+                                                bool fin,
+                                                xsp_ws_frame_opcode_t opcode,
+                                                int payload_size,
+                                                const void* payload) {
+    if (!client || payload_size < 0 || (payload_size > 0 && !payload))
+        return ESP_ERR_INVALID_ARG;
+    if (!client->transport || xsp_ws_client_has_pending_write(client))
+        return ESP_ERR_INVALID_STATE;
+    if (!can_write(client->state))
+        return ESP_FAIL;
+
+    client->write_pending = true;
+    client->pending_in_place = false;
+    client->pending_header_added = false;
+    client->pending_fin = fin;
+    client->pending_opcode = opcode;
+    // This shouldn't fail.
+    getrandom(client->pending_masking_key, sizeof(client->pending_masking_key), 0);
+    client->pending_payload = (const unsigned char*)payload;
+    client->pending_payload_size = payload_size;
+    client->pending_payload_offset = 0;
+    return continue_write(client, -1, false);
+}
+
+// Makes the frame in place (see `xsp_ws_client_write_frame_in_place()`), returning its start and
+// putting its size in `*frame_size`.
+static const unsigned char* make_frame_in_place(bool fin,
+                                                xsp_ws_frame_opcode_t opcode,
+                                                int payload_size,
+                                                void* buffer,
+                                                int* frame_size) {
+    unsigned char masking_key[4];
+    // This shouldn't fail.
+    getrandom(masking_key, sizeof(masking_key), 0);
+
+    // Make the header in a temporary buffer, since its size depends on the payload size; then put
+    // it immediately before the payload.
+    unsigned char header[XSP_WS_CLIENT_FRAME_HEADROOM];
+    int header_size = make_frame_header(fin, opcode, payload_size, masking_key, header);
+    unsigned char* payload = (unsigned char*)buffer + XSP_WS_CLIENT_FRAME_HEADROOM;
+    unsigned char* frame = payload - header_size;
+    memcpy(frame, header, (size_t)header_size);
+    xsp_ws_mask(masking_key, 0, payload_size, payload, payload);
+
+    *frame_size = header_size + payload_size;
+    return frame;
+}
+
+esp_err_t xsp_ws_client_write_frame_in_place_nonblocking(xsp_ws_client_handle_t client,
+                                                         bool fin,
+                                                         xsp_ws_frame_opcode_t opcode,
+                                                         int payload_size,
+                                                         void* buffer) {
+    if (!client || payload_size < 0 || !buffer)
+        return ESP_ERR_INVALID_ARG;
+    if (!client->transport || xsp_ws_client_has_pending_write(client))
+        return ESP_ERR_INVALID_STATE;
+    if (!can_write(client->state))
+        return ESP_FAIL;
+
+    client->write_pending = true;
+    client->pending_in_place = true;
+    client->pending_opcode = opcode;
+    client->pending_payload =
+            make_frame_in_place(fin, opcode, payload_size, buffer, &client->pending_payload_size);
+    client->pending_payload_offset = 0;
+    return continue_write(client, -1, false);
+}
+
+esp_err_t xsp_ws_client_continue_write(xsp_ws_client_handle_t client) {
+    if (!client)
+        return ESP_ERR_INVALID_ARG;
+    if (!xsp_ws_client_has_pending_write(client))
+        return ESP_ERR_INVALID_STATE;
+    if (!can_write(client->state)) {
+        reset_pending_write(client);
+        return ESP_FAIL;
+    }
+
+    return continue_write(client, -1, false);
+}
+
+bool xsp_ws_client_has_pending_write(xsp_ws_client_handle_t client) {
+    return client && (client->write_pending || client->write_buf_written > 0);
 }
 
 esp_err_t xsp_ws_client_write_frame(xsp_ws_client_handle_t client,
@@ -548,36 +1477,84 @@ esp_err_t xsp_ws_client_write_frame(xsp_ws_client_handle_t client,
     if (!can_write(client->state))
         return ESP_FAIL;
 
+    // A pending nonblocking write (or flush) must be completed first.
+    if (xsp_ws_client_has_pending_write(client) && !flush_write_buf(client, timeout_ms))
+        return ESP_FAIL;
+
     unsigned char masking_key[4];
     // This shouldn't fail.
     getrandom(masking_key, sizeof(masking_key), 0);
 
-    if (!write_frame_header(client->transport, fin, opcode, payload_size, masking_key,
-                            timeout_ms)) {
-        // We don't know why it failed, so we have to assume that the transport is bad.
-        client->state = XSP_WS_CLIENT_STATE_FAILED_NO_CLOSE;
+    // The header goes at the start of the buffer (or, if corked, after any buffered frames),
+    // followed by as much of the (masked) payload as fits, so that small frames only take a single
+    // write (and so that, over TLS, we don't produce lots of tiny records).
+    unsigned char* write_buf = client->write_buf;
+    if (client->write_buf_used + XSP_WS_CLIENT_FRAME_HEADROOM >
+                CONFIG_XSP_WS_CLIENT_WRITE_FRAME_BUFFER_SIZE &&
+        !flush_write_buf(client, timeout_ms)) {
         return ESP_FAIL;
     }
-
-    unsigned char write_buf[CONFIG_XSP_WS_CLIENT_WRITE_FRAME_BUFFER_SIZE];
+    int write_size = client->write_buf_used;
+    client->write_buf_used = 0;
+    write_size += make_frame_header(fin, opcode, payload_size, masking_key, write_buf + write_size);
     const unsigned char* src = (const unsigned char*)payload;
-    while (payload_size > 0) {
-        int write_size =
-                (payload_size > (int)sizeof(write_buf)) ? (int)sizeof(write_buf) : payload_size;
-        // TODO(vtl): This could be more efficient; the optimizer probably isn't smart enough to
-        // "vectorize".
-        for (int i = 0; i < write_size; i++, src++)
-            write_buf[i] = *src ^ masking_key[i % 4];
-
-        if (esp_transport_write(client->transport, (const char*)write_buf, write_size,
-                                timeout_ms) != write_size) {
+    int offset = 0;
+    do {
+        int chunk_size = CONFIG_XSP_WS_CLIENT_WRITE_FRAME_BUFFER_SIZE - write_size;
+        if (chunk_size > payload_size - offset)
+            chunk_size = payload_size - offset;
+        xsp_ws_mask(masking_key, offset, chunk_size, src + offset, write_buf + write_size);
+        write_size += chunk_size;
+        offset += chunk_size;
+
+        // If corked, leave the end of the frame in the buffer (to be written with later frames).
+        if (client->corked && offset == payload_size) {
+            client->write_buf_used = write_size;
+            break;
+        }
+        if (!write_data(client, write_buf, write_size, timeout_ms)) {
+            // We don't know why it failed, so we have to assume that the transport is bad.
             client->state = XSP_WS_CLIENT_STATE_FAILED_NO_CLOSE;
             return ESP_FAIL;
         }
+        write_size = 0;
+    } while (offset < payload_size);
+
+    if (opcode == XSP_WS_FRAME_OPCODE_CONNECTION_CLOSE)
+        client->close_frame_written = true;
+    client->stats.frames_written++;
+    return ESP_OK;
+}
 
-        payload_size -= write_size;
+esp_err_t xsp_ws_client_write_frame_in_place(xsp_ws_client_handle_t client,
+                                             bool fin,
+                                             xsp_ws_frame_opcode_t opcode,
+                                             int payload_size,
+                                             void* buffer,
+                                             int timeout_ms) {
+    if (!client || payload_size < 0 || !buffer || timeout_ms < 0)
+        return ESP_ERR_INVALID_ARG;
+    if (!client->transport)
+        return ESP_ERR_INVALID_STATE;
+    if (!can_write(client->state))
+        return ESP_FAIL;
+
+    // Any buffered frames (or pending nonblocking write) must be written first.
+    if (!flush_write_buf(client, timeout_ms))
+        return ESP_FAIL;
+
+    int frame_size;
+    const unsigned char* frame =
+            make_frame_in_place(fin, opcode, payload_size, buffer, &frame_size);
+    if (!write_data(client, frame, frame_size, timeout_ms)) {
+        // We don't know why it failed, so we have to assume that the transport is bad.
+        client->state = XSP_WS_CLIENT_STATE_FAILED_NO_CLOSE;
+        return ESP_FAIL;
     }
 
+    if (opcode == XSP_WS_FRAME_OPCODE_CONNECTION_CLOSE)
+        client->close_frame_written = true;
+    client->stats.frames_written++;
     return ESP_OK;
 }
 
@@ -619,28 +1596,69 @@ esp_err_t xsp_ws_client_poll_read(xsp_ws_client_handle_t client, int timeout_ms)
     if (!can_read(client->state))
         return ESP_FAIL;
 
-    if (client->overread_consumed < client->overread_size)
+    if (has_buffered_frame(client))
         return ESP_OK;
     return poll_result_to_esp_err(esp_transport_poll_read(client->transport, timeout_ms));
 }
 
-static int read_data(xsp_ws_client_handle_t client, char* data, int size, int timeout_ms) {
-    int size_read = 0;
-    if (client->overread_data) {
-        int overread_left = client->overread_size - client->overread_consumed;
-        size_read = (size <= overread_left) ? size : overread_left;
-        memcpy(data, client->overread_data + client->overread_consumed, (size_t)size_read);
-        client->overread_consumed += size_read;
-        if (client->overread_consumed == client->overread_size) {
-            free(client->overread_data);
-            client->overread_data = NULL;
-        }
+// Returns true if the transport's socket has reached the end of the stream (or has failed), without
+// blocking or consuming any data.
+static bool is_at_eof(xsp_ws_client_handle_t client) {
+    int fd = esp_transport_get_select_fd(client->transport);
+    if (fd < 0)
+        return true;
+    char c;
+    int result = recv(fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    return !(result > 0 || (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)));
+}
+
+// Reads up to `size` bytes from the transport. Returns the number of bytes read, 0 if no data was
+// available within `timeout_ms`, or -1 on failure (including the end of the stream).
+static int transport_read(xsp_ws_client_handle_t client, char* data, int size, int timeout_ms) {
+    client->stats.transport_reads++;
+    int result = esp_transport_read(client->transport, data, size, timeout_ms);
+    if (result > 0) {
+        client->stats.bytes_read += (uint64_t)result;
+        return result;
+    }
+    if (result < 0)
+        return -1;
+    // `esp_transport_read()` returns 0 both on timeout and at the end of the stream.
+    return is_at_eof(client) ? -1 : 0;
+}
+
+// Reads up to `size` (which must be positive) bytes, from the buffered data if there is any and
+// otherwise using a single transport read. Returns the number of bytes read, 0 if no data was
+// available within `timeout_ms`, or -1 on failure.
+static int read_some(xsp_ws_client_handle_t client, char* data, int size, int timeout_ms) {
+    const unsigned char* buffered_data;
+    int buffered_size = get_buffered_data(client, &buffered_data);
+    if (buffered_size > 0) {
+        int n = (size <= buffered_size) ? size : buffered_size;
+        memcpy(data, buffered_data, (size_t)n);
+        consume_buffered_data(client, n);
+        return n;
     }
 
+    // Nothing is buffered. Read large amounts directly; otherwise, (try to) fill the buffer, so
+    // that subsequent frames can be read without going back to the transport.
+    if (size >= CONFIG_XSP_WS_CLIENT_READ_BUFFER_SIZE)
+        return transport_read(client, data, size, timeout_ms);
+    int result = transport_read(client, (char*)client->read_buf,
+                                CONFIG_XSP_WS_CLIENT_READ_BUFFER_SIZE, timeout_ms);
+    if (result <= 0)
+        return result;
+    client->read_buf_end = result;
+    return read_some(client, data, size, timeout_ms);
+}
+
+// Reads `size` bytes, returning the number of bytes read (which is less than `size` on timeout or
+// failure), or -1 if nothing could be read.
+static int read_data(xsp_ws_client_handle_t client, char* data, int size, int timeout_ms) {
+    int size_read = 0;
     // Note: This also handles the size == 0 case.
     while (size_read < size) {
-        int result = esp_transport_read(client->transport, data + size_read, size - size_read,
-                                        timeout_ms);
+        int result = read_some(client, data + size_read, size - size_read, timeout_ms);
         if (result <= 0) {
             if (size_read > 0)
                 break;
@@ -651,6 +1669,70 @@ static int read_data(xsp_ws_client_handle_t client, char* data, int size, int ti
     return size_read;
 }
 
+// Checks a frame header (read from the server), updating the client state as appropriate and
+// setting `*fin` and `*opcode`. Returns ESP_OK if the payload should be read (even if the client
+// has failed), or ESP_FAIL if it can't be.
+static esp_err_t check_frame_header(xsp_ws_client_handle_t client,
+                                    const frame_header_t* header,
+                                    bool* fin,
+                                    xsp_ws_frame_opcode_t* opcode) {
+    if (header->reserved != 0)                          // Reserved bits are set.
+        client->state = XSP_WS_CLIENT_STATE_FAILED;     // But keep going.
+    if (!xsp_ws_is_valid_frame_opcode(header->opcode))  // Invalid opcode.
+        client->state = XSP_WS_CLIENT_STATE_FAILED;     // But keep going.
+    xsp_ws_frame_opcode_t opcode_value = (xsp_ws_frame_opcode_t)header->opcode;
+    bool is_control_frame = xsp_ws_is_control_frame_opcode(opcode_value);
+    if (is_control_frame && !header->fin)            // Control frames must not be fragmented.
+        client->state = XSP_WS_CLIENT_STATE_FAILED;  // But keep going.
+    *fin = header->fin;
+    *opcode = opcode_value;
+    if (header->masked) {  // Frames from server must not be masked.
+        // Don't keep going since we don't know how to unmask.
+        client->state = XSP_WS_CLIENT_STATE_FAILED_NO_CLOSE;
+        return ESP_FAIL;
+    }
+    if (header->payload_size < 0) {  // Too big!
+        client->state = XSP_WS_CLIENT_STATE_FAILED_NO_CLOSE;
+        return ESP_FAIL;
+    }
+    // Control frames are at most 125 bytes.
+    if (is_control_frame && header->payload_size > 125)
+        client->state = XSP_WS_CLIENT_STATE_FAILED;  // But keep going.
+    if (!header->minimal_payload_size)               // Not minimal encoding of size.
+        client->state = XSP_WS_CLIENT_STATE_FAILED;  // But keep going.
+    return ESP_OK;
+}
+
+// Reads and checks a frame header (see `check_frame_header()`). If no more data is available
+// within `timeout_ms`, returns ESP_ERR_TIMEOUT; the part of the header read so far is kept, and the
+// next call continues reading it.
+static esp_err_t read_frame_header(xsp_ws_client_handle_t client,
+                                   frame_header_t* header,
+                                   bool* fin,
+                                   xsp_ws_frame_opcode_t* opcode,
+                                   int timeout_ms) {
+    // Read the first 2 bytes, and then the rest of the header (if necessary).
+    int header_size =
+            parse_frame_header(client->read_header_data, client->read_header_size, header);
+    while (client->read_header_size < header_size) {
+        int result = read_some(client, (char*)client->read_header_data + client->read_header_size,
+                               header_size - client->read_header_size, timeout_ms);
+        if (result == 0)
+            return ESP_ERR_TIMEOUT;
+        if (result < 0) {
+            // We don't know why it failed, so we have to assume that the transport is bad.
+            client->read_header_size = 0;
+            client->state = XSP_WS_CLIENT_STATE_FAILED_NO_CLOSE;
+            return ESP_FAIL;
+        }
+        client->read_header_size += result;
+        header_size =
+                parse_frame_header(client->read_header_data, client->read_header_size, header);
+    }
+    client->read_header_size = 0;
+    return check_frame_header(client, header, fin, opcode);
+}
+
 esp_err_t xsp_ws_client_read_frame(xsp_ws_client_handle_t client,
                                    bool* fin,
                                    xsp_ws_frame_opcode_t* opcode,
@@ -667,74 +1749,161 @@ esp_err_t xsp_ws_client_read_frame(xsp_ws_client_handle_t client,
     if (!can_read(client->state))
         return ESP_FAIL;
 
-    unsigned char header1[2];
-    if (read_data(client, (char*)&header1, (int)sizeof(header1), timeout_ms) != sizeof(header1)) {
-        // We don't know why it failed, so we have to assume that the transport is bad.
+    if (client->chunk_remaining >= 0)
+        return ESP_ERR_INVALID_STATE;
+
+    release_view(client);
+
+    frame_header_t header;
+    esp_err_t err = read_frame_header(client, &header, fin, opcode, timeout_ms);
+    if (err != ESP_OK)
+        return err;
+    int size = header.payload_size;
+
+    *payload_size = size;
+    if (size > payload_buffer_size) {
+        // TODO(vtl): Possibly, we should just read/discard the remaining data, and report that the
+        // frame was too big. (Then we'd be able to close properly, with status 1009, I guess.)
         client->state = XSP_WS_CLIENT_STATE_FAILED_NO_CLOSE;
         return ESP_FAIL;
     }
-    if ((header1[0] & 0x70) != 0)                                 // Reserved bits are set.
-        client->state = XSP_WS_CLIENT_STATE_FAILED;               // But keep going.
-    if (!xsp_ws_is_valid_frame_opcode((int)(header1[0] & 0x0f)))  // Invalid opcode.
-        client->state = XSP_WS_CLIENT_STATE_FAILED;               // But keep going.
-    xsp_ws_frame_opcode_t opcode_value = (xsp_ws_frame_opcode_t)(header1[0] & 0x0f);
-    bool is_control_frame = xsp_ws_is_control_frame_opcode(opcode_value);
-    bool fin_value = (header1[0] & 0x80) != 0;
-    if (is_control_frame && !fin_value)              // Control frames must not be fragmented.
-        client->state = XSP_WS_CLIENT_STATE_FAILED;  // But keep going.
-    *fin = fin_value;
-    *opcode = opcode_value;
-    if ((header1[1] & 0x80) != 0) {  // Frames from server must not be masked.
-        // Don't keep going since we don't know how to unmask.
+
+    if (read_data(client, (char*)payload_buffer, size, timeout_ms) != size) {
         client->state = XSP_WS_CLIENT_STATE_FAILED_NO_CLOSE;
         return ESP_FAIL;
     }
-    int size = header1[1];
+    client->stats.frames_read++;
 
-    if (size == 126) {
-        if (is_control_frame)                            // Control frames are at most 125 bytes.
-            client->state = XSP_WS_CLIENT_STATE_FAILED;  // But keep going.
+    if (client->state != XSP_WS_CLIENT_STATE_OK)
+        return ESP_FAIL;
 
-        unsigned char header2[2];
-        if (read_data(client, (char*)&header2, (int)sizeof(header2), timeout_ms) !=
-            sizeof(header2)) {
-            client->state = XSP_WS_CLIENT_STATE_FAILED_NO_CLOSE;
-            return ESP_FAIL;
+    return ESP_OK;
+}
+
+esp_err_t xsp_ws_client_read_frame_view(xsp_ws_client_handle_t client,
+                                        bool* fin,
+                                        xsp_ws_frame_opcode_t* opcode,
+                                        const void** payload,
+                                        int* payload_size,
+                                        int timeout_ms) {
+    if (!client || !fin || !opcode || !payload || !payload_size || timeout_ms < 0)
+        return ESP_ERR_INVALID_ARG;
+    if (!client->transport)
+        return ESP_ERR_INVALID_STATE;
+    if (!can_read(client->state))
+        return ESP_FAIL;
+    if (client->chunk_remaining >= 0 || client->read_header_size > 0)
+        return ESP_ERR_INVALID_STATE;
+
+    release_view(client);
+
+    for (;;) {
+        const unsigned char* data;
+        int size = get_buffered_data(client, &data);
+        frame_header_t header;
+        int header_size = parse_frame_header(data, size, &header);
+        int frame_size = header_size;
+        if (header_size <= size) {
+            if (header.payload_size < 0 || size - header_size >= header.payload_size) {
+                // Complete frame (or a bad one).
+                esp_err_t err = check_frame_header(client, &header, fin, opcode);
+                if (err != ESP_OK)
+                    return err;
+                *payload = data + header_size;
+                *payload_size = header.payload_size;
+                client->view_size = header_size + header.payload_size;
+                client->stats.frames_read++;
+                return (client->state == XSP_WS_CLIENT_STATE_OK) ? ESP_OK : ESP_FAIL;
+            }
+            frame_size += header.payload_size;
         }
-        size = ((int)header2[0] << 8) | (int)header2[1];
-        if (size <= 125)                                 // Not minimal encoding of size.
-            client->state = XSP_WS_CLIENT_STATE_FAILED;  // But keep going.
-    } else if (size == 127) {
-        if (is_control_frame)                            // Control frames are at most 125 bytes.
-            client->state = XSP_WS_CLIENT_STATE_FAILED;  // But keep going.
-
-        unsigned char header2[8];
-        if (read_data(client, (char*)&header2, (int)sizeof(header2), timeout_ms) !=
-            sizeof(header2)) {
-            client->state = XSP_WS_CLIENT_STATE_FAILED_NO_CLOSE;
-            return ESP_FAIL;
+        if (frame_size > CONFIG_XSP_WS_CLIENT_READ_BUFFER_SIZE)
+            return ESP_ERR_INVALID_SIZE;  // Nothing has been consumed.
+
+        // Need more data, which must be contiguous in the read buffer. Move any remaining overread
+        // data (which must fit, since the frame does) into the read buffer, and then move the
+        // buffered data to the start of the read buffer.
+        if (client->overread_data) {
+            memcpy(client->read_buf, data, (size_t)size);
+            client->read_buf_start = 0;
+            client->read_buf_end = size;
+            free(client->overread_data);
+            client->overread_data = NULL;
+            client->overread_consumed = client->overread_size;
+        } else if (client->read_buf_start > 0) {
+            memmove(client->read_buf, data, (size_t)size);
+            client->read_buf_start = 0;
+            client->read_buf_end = size;
         }
-        if (header2[0] != 0 || header2[1] != 0 || header2[2] != 0 || header2[3] != 0 ||
-            (header2[4] & 0x80) != 0) {  // Too big!
+        int result = transport_read(client, (char*)client->read_buf + client->read_buf_end,
+                                    CONFIG_XSP_WS_CLIENT_READ_BUFFER_SIZE - client->read_buf_end,
+                                    timeout_ms);
+        if (result == 0)
+            return ESP_ERR_TIMEOUT;  // Nothing has been consumed.
+        if (result < 0) {
+            // We don't know why it failed, so we have to assume that the transport is bad.
             client->state = XSP_WS_CLIENT_STATE_FAILED_NO_CLOSE;
             return ESP_FAIL;
         }
-        size = ((int)header2[4] << 24) | ((int)header2[5] << 16) | ((int)header2[6] << 8) |
-               (int)header2[7];
-        if (size <= 0xffff)                              // Not minimal encoding of size.
-            client->state = XSP_WS_CLIENT_STATE_FAILED;  // But keep going.
+        client->read_buf_end += result;
     }
-    *payload_size = size;
-    if (size > payload_buffer_size) {
-        // TODO(vtl): Possibly, we should just read/discard the remaining data, and report that the
-        // frame was too big. (Then we'd be able to close properly, with status 1009, I guess.)
-        client->state = XSP_WS_CLIENT_STATE_FAILED_NO_CLOSE;
+}
+
+esp_err_t xsp_ws_client_read_frame_chunk(xsp_ws_client_handle_t client,
+                                         bool* fin,
+                                         xsp_ws_frame_opcode_t* opcode,
+                                         int* payload_size,
+                                         int* chunk_offset,
+                                         int chunk_buffer_size,
+                                         void* chunk_buffer,
+                                         int* chunk_size,
+                                         bool* last_chunk,
+                                         int timeout_ms) {
+    if (!client || !fin || !opcode || !payload_size || !chunk_offset || chunk_buffer_size <= 0 ||
+        !chunk_buffer || !chunk_size || !last_chunk || timeout_ms < 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!client->transport)
+        return ESP_ERR_INVALID_STATE;
+    if (!can_read(client->state))
         return ESP_FAIL;
+
+    release_view(client);
+
+    if (client->chunk_remaining < 0) {
+        // Start a new frame.
+        frame_header_t header;
+        esp_err_t err = read_frame_header(client, &header, &client->chunk_fin,
+                                          &client->chunk_opcode, timeout_ms);
+        if (err != ESP_OK)
+            return err;
+        client->chunk_payload_size = header.payload_size;
+        client->chunk_remaining = header.payload_size;
     }
 
-    if (read_data(client, (char*)payload_buffer, size, timeout_ms) != size) {
-        client->state = XSP_WS_CLIENT_STATE_FAILED_NO_CLOSE;
-        return ESP_FAIL;
+    *fin = client->chunk_fin;
+    *opcode = client->chunk_opcode;
+    *payload_size = client->chunk_payload_size;
+    *chunk_offset = client->chunk_payload_size - client->chunk_remaining;
+    int size = 0;
+    if (client->chunk_remaining > 0) {
+        size = read_some(client, (char*)chunk_buffer,
+                         (client->chunk_remaining < chunk_buffer_size) ? client->chunk_remaining
+                                                                       : chunk_buffer_size,
+                         timeout_ms);
+        if (size == 0)
+            return ESP_ERR_TIMEOUT;
+        if (size < 0) {
+            client->state = XSP_WS_CLIENT_STATE_FAILED_NO_CLOSE;
+            return ESP_FAIL;
+        }
+        client->chunk_remaining -= size;
+    }
+    *chunk_size = size;
+    *last_chunk = client->chunk_remaining == 0;
+    if (*last_chunk) {
+        client->chunk_remaining = -1;
+        client->stats.frames_read++;
     }
 
     if (client->state != XSP_WS_CLIENT_STATE_OK)
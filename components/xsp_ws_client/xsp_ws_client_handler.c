@@ -3,34 +3,82 @@
 
 #include "xsp_ws_client_handler.h"
 
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
 #include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
 
+#include "xsp_timerfd.h"
 #include "xsp_ws_client_utf8.h"
 
 #include "sdkconfig.h"
 
+// A message in the send queue.
+typedef struct send_queue_entry {
+    bool is_binary;
+    const void* message;  // Not owned by us.
+    int size;
+    // If set, the message is streamed: its data is provided by `producer` (and `message` and
+    // `size` are unused).
+    xsp_ws_client_handler_producer_func_t producer;
+    void* producer_ctx;
+    on_ws_client_message_sent_func_t on_sent;  // If null, the event handler's is used.
+    void* on_sent_ctx;
+} send_queue_entry_t;
+
 typedef struct xsp_ws_client_handler {
     xsp_ws_client_handler_config_t config;
     xsp_ws_client_event_handler_t evt_handler;
     xsp_ws_client_handle_t client;
     xsp_loop_handle_t loop;
 
-    xsp_loop_fd_watcher_handle_t fd_watcher;
+    xsp_loop_fd_watcher_handle_t fd_watcher;  // Null while disconnected.
 
     void* read_buffer;
     int read_buffer_size;
 
+    // State for reading frames in chunks (see `do_read_chunk()`).
+    bool reading_chunks;
+    int read_buffer_used;  // Only nonzero when reading a frame that fits into `read_buffer`.
+    // While a frame is partly received, the time (in microseconds) that reading it last made
+    // progress (see `check_read_timeout()`); otherwise, 0.
+    int64_t read_progress_us;
+
     // State that's persistent across multiple runnings of the loop.
     bool close_sent;
     bool close_event_sent;
     int close_status;
-    bool sending_message;
-    bool send_is_binary;       // Only valid when sending message.
-    const void* send_message;  // Only valid when sending message. Not owned by us.
-    int send_size;             // Only valid when sending message.
-    int send_written;          // Only valid when sending message.
+
+    // The send queue: a ring buffer of `config.send_queue_max_messages` entries, of which the first
+    // (at `send_queue_head`) is the message being sent.
+    send_queue_entry_t* send_queue;
+    int send_queue_head;
+    int send_queue_count;
+    int send_queue_bytes;
+    bool send_started;  // Set once a frame of the message being sent has been written.
+    int send_written;   // Amount of the message being sent that has been written.
+    bool send_fin;      // Whether the frame being written (possibly pending) is the last.
+    bool send_paused;   // Set if the producer of the streamed message being sent has no data.
+    // For streamed messages (allocated on first use): XSP_WS_CLIENT_FRAME_HEADROOM bytes followed
+    // by `config.max_data_frame_write_size` bytes for the producer, so frames are written in place.
+    void* stream_buffer;
+    // Set while the client's nonblocking write of a frame of the message being sent (or of a flush;
+    // see `on_loop_will_select()`) is pending.
+    bool frame_pending;
+    bool flush_pending;
+    xsp_ws_client_handler_send_queue_stats_t send_queue_stats;
+
+    // State for automatic reconnection. `timer_fd` is -1 if it's disabled.
+    int timer_fd;
+    xsp_loop_fd_watcher_handle_t timer_fd_watcher;
+    xsp_ws_client_handler_connection_state_t connection_state;
+    int reconnect_attempts;  // Number of consecutive failed attempts.
+    bool close_requested;    // Set by `xsp_ws_client_handler_close()`: don't reconnect.
+    bool client_closing;     // Set while the client is being closed asynchronously.
 } xsp_ws_client_handler_t;
 
 static const char TAG[] = "WS_CLIENT_HANDLER";
@@ -38,15 +86,31 @@ static const char TAG[] = "WS_CLIENT_HANDLER";
 #if CONFIG_XSP_WS_CLIENT_HANDLER_DEFAULT_MAX_FRAME_READ_SIZE < 125 ||         \
         CONFIG_XSP_WS_CLIENT_HANDLER_DEFAULT_MAX_DATA_FRAME_WRITE_SIZE < 1 || \
         CONFIG_XSP_WS_CLIENT_HANDLER_DEFAULT_READ_TIMEOUT_MS < 0 ||           \
-        CONFIG_XSP_WS_CLIENT_HANDLER_DEFAULT_WRITE_TIMEOUT_MS < 0
+        CONFIG_XSP_WS_CLIENT_HANDLER_DEFAULT_WRITE_TIMEOUT_MS < 0 ||          \
+        CONFIG_XSP_WS_CLIENT_HANDLER_DEFAULT_RECONNECT_BASE_DELAY_MS < 0 ||   \
+        CONFIG_XSP_WS_CLIENT_HANDLER_DEFAULT_RECONNECT_MAX_DELAY_MS <         \
+                CONFIG_XSP_WS_CLIENT_HANDLER_DEFAULT_RECONNECT_BASE_DELAY_MS ||       \
+        CONFIG_XSP_WS_CLIENT_HANDLER_DEFAULT_SEND_QUEUE_MAX_MESSAGES < 1 ||           \
+        CONFIG_XSP_WS_CLIENT_HANDLER_DEFAULT_SEND_QUEUE_MAX_BYTES < 0
 #error "Invalid value for CONFIG_XSP_WS_CLIENT_HANDLER_DEFAULT_..."
 #endif
 
+#ifdef CONFIG_XSP_WS_CLIENT_HANDLER_DEFAULT_CORK
+#define DEFAULT_CORK true
+#else
+#define DEFAULT_CORK false
+#endif
+
 const xsp_ws_client_handler_config_t xsp_ws_client_handler_config_default = {
         CONFIG_XSP_WS_CLIENT_HANDLER_DEFAULT_MAX_FRAME_READ_SIZE,
         CONFIG_XSP_WS_CLIENT_HANDLER_DEFAULT_MAX_DATA_FRAME_WRITE_SIZE,
         CONFIG_XSP_WS_CLIENT_HANDLER_DEFAULT_READ_TIMEOUT_MS,
-        CONFIG_XSP_WS_CLIENT_HANDLER_DEFAULT_WRITE_TIMEOUT_MS};
+        CONFIG_XSP_WS_CLIENT_HANDLER_DEFAULT_WRITE_TIMEOUT_MS,
+        CONFIG_XSP_WS_CLIENT_HANDLER_DEFAULT_RECONNECT_BASE_DELAY_MS,
+        CONFIG_XSP_WS_CLIENT_HANDLER_DEFAULT_RECONNECT_MAX_DELAY_MS,
+        DEFAULT_CORK,
+        CONFIG_XSP_WS_CLIENT_HANDLER_DEFAULT_SEND_QUEUE_MAX_MESSAGES,
+        CONFIG_XSP_WS_CLIENT_HANDLER_DEFAULT_SEND_QUEUE_MAX_BYTES};
 
 static bool validate_config(const xsp_ws_client_handler_config_t* config) {
     if (!config)
@@ -59,12 +123,24 @@ static bool validate_config(const xsp_ws_client_handler_config_t* config) {
         return false;
     if (config->write_timeout_ms < 0)
         return false;
+    if (config->reconnect_base_delay_ms < 0)
+        return false;
+    if (config->reconnect_base_delay_ms > 0 &&
+        config->reconnect_max_delay_ms < config->reconnect_base_delay_ms) {
+        return false;
+    }
+    if (config->send_queue_max_messages < 1)
+        return false;
+    if (config->send_queue_max_bytes < 0)
+        return false;
     return true;
 }
 
 static bool should_stop(xsp_ws_client_handler_handle_t handler) {
-    if (xsp_loop_should_stop(handler->loop) || handler->close_sent)
+    if (xsp_loop_should_stop(handler->loop) || handler->close_sent ||
+        handler->connection_state != XSP_WS_CLIENT_HANDLER_CONNECTION_STATE_CONNECTED) {
         return true;
+    }
 
     switch (xsp_ws_client_get_state(handler->client)) {
     case XSP_WS_CLIENT_STATE_CLOSED:
@@ -81,30 +157,147 @@ static bool should_stop(xsp_ws_client_handler_handle_t handler) {
     return true;  // Shouldn't get here.
 }
 
-static void maybe_send_close_event(xsp_ws_client_handler_handle_t handler) {
+// Removes the message being sent from the send queue, and generates its message-sent event.
+static void send_message_completed(xsp_ws_client_handler_handle_t handler, bool success) {
+    send_queue_entry_t entry = handler->send_queue[handler->send_queue_head];
+    handler->send_queue_head =
+            (handler->send_queue_head + 1) % handler->config.send_queue_max_messages;
+    handler->send_queue_count--;
+    handler->send_queue_bytes -= entry.size;
+    handler->send_started = false;
+    handler->send_written = 0;
+    handler->send_paused = false;
+    if (success)
+        handler->send_queue_stats.messages_sent++;
+    else
+        handler->send_queue_stats.messages_failed++;
+
+    // Note: The event handler may send another message.
+    if (entry.on_sent)
+        entry.on_sent(handler, entry.on_sent_ctx, success);
+    else if (handler->evt_handler.on_ws_client_message_sent)
+        handler->evt_handler.on_ws_client_message_sent(handler, handler->evt_handler.ctx, success);
+}
+
+// Fails all queued messages (once no more messages can be sent).
+static void fail_send_queue(xsp_ws_client_handler_handle_t handler) {
+    while (handler->send_queue_count > 0)
+        send_message_completed(handler, false);
+}
+
+static void send_close_event(xsp_ws_client_handler_handle_t handler) {
     if (handler->close_event_sent)
         return;
 
     handler->close_event_sent = true;
+    // Messages may not be sent after this, so this terminates.
+    fail_send_queue(handler);
     if (handler->evt_handler.on_ws_client_closed) {
         handler->evt_handler.on_ws_client_closed(handler, handler->evt_handler.ctx,
                                                  handler->close_status);
     }
 }
 
-static void do_read(xsp_ws_client_handler_handle_t handler) {
-    bool fin;
-    xsp_ws_frame_opcode_t opcode;
-    int payload_size;
-    esp_err_t err = xsp_ws_client_read_frame(handler->client, &fin, &opcode,
-                                             handler->read_buffer_size, handler->read_buffer,
-                                             &payload_size, handler->config.read_timeout_ms);
-    if (err != ESP_OK) {
-        ESP_LOGD(TAG, "Read frame failed: %s", esp_err_to_name(err));
-        maybe_send_close_event(handler);
+static void set_connection_state(xsp_ws_client_handler_handle_t handler,
+                                 xsp_ws_client_handler_connection_state_t state,
+                                 int status) {
+    handler->connection_state = state;
+    if (handler->evt_handler.on_ws_client_connection_state_changed) {
+        handler->evt_handler.on_ws_client_connection_state_changed(
+                handler, handler->evt_handler.ctx, state, status);
+    }
+}
+
+static bool should_reconnect(xsp_ws_client_handler_handle_t handler) {
+    return handler->timer_fd != -1 && !handler->close_requested &&
+           !xsp_loop_should_stop(handler->loop);
+}
+
+// Arms the timer to fire after `delay_ms` (or as soon as possible, if 0).
+static bool arm_timer(xsp_ws_client_handler_handle_t handler, int delay_ms) {
+    xsp_timerfd_itimerspec_t its = {
+            .it_interval = {.tv_sec = 0, .tv_nsec = 0},
+            // Note: A zero value would disarm the timer.
+            .it_value = {.tv_sec = delay_ms / 1000,
+                         .tv_nsec = delay_ms > 0 ? (delay_ms % 1000) * 1000000 : 1},
+    };
+    return xsp_timerfd_settime(handler->timer_fd, 0, &its, NULL) == 0;
+}
+
+// Schedules a reconnect attempt, with exponential backoff and full jitter.
+static void schedule_reconnect(xsp_ws_client_handler_handle_t handler) {
+    int backoff_ms = handler->config.reconnect_base_delay_ms;
+    for (int i = 0; i < handler->reconnect_attempts &&
+                    backoff_ms < handler->config.reconnect_max_delay_ms;
+         i++) {
+        backoff_ms *= 2;
+    }
+    if (backoff_ms > handler->config.reconnect_max_delay_ms)
+        backoff_ms = handler->config.reconnect_max_delay_ms;
+    int delay_ms = (int)(esp_random() % ((uint32_t)backoff_ms + 1));
+    ESP_LOGD(TAG, "Reconnecting in %d ms (attempt %d)", delay_ms,
+             handler->reconnect_attempts + 1);
+    if (!arm_timer(handler, delay_ms)) {
+        ESP_LOGE(TAG, "Failed to set reconnect timer");
+        handler->close_requested = true;
+        send_close_event(handler);
+    }
+}
+
+static void on_client_closed(xsp_ws_client_handle_t client, void* ctx) {
+    xsp_ws_client_handler_handle_t handler = (xsp_ws_client_handler_handle_t)ctx;
+
+    handler->client_closing = false;
+    if (handler->close_requested)
+        send_close_event(handler);
+    else
+        schedule_reconnect(handler);
+}
+
+// Handles loss of the connection when reconnecting: closes the client and schedules a reconnect
+// attempt. Queued messages are kept, and the message being sent (if any) will be sent again from
+// the start, unless it's a streamed message (whose data can't be produced again), which fails.
+static void disconnect(xsp_ws_client_handler_handle_t handler) {
+    if (handler->send_started && handler->send_queue[handler->send_queue_head].producer)
+        send_message_completed(handler, false);
+
+    // Note: Removing the FD watcher from inside its event handler is OK.
+    xsp_loop_remove_fd_watcher(handler->loop, handler->fd_watcher);  // Ignore any error.
+    handler->fd_watcher = NULL;
+    handler->reading_chunks = false;
+    handler->read_buffer_used = 0;
+    handler->read_progress_us = 0;
+    handler->send_started = false;
+    handler->send_written = 0;
+    handler->frame_pending = false;
+    handler->flush_pending = false;
+    handler->close_sent = false;
+    set_connection_state(handler, XSP_WS_CLIENT_HANDLER_CONNECTION_STATE_DISCONNECTED,
+                         handler->close_status);
+
+    handler->client_closing = true;
+    // This only fails on invalid arguments or state.
+    xsp_ws_client_close_async(handler->client, handler->loop, &on_client_closed, handler);
+}
+
+static void maybe_send_close_event(xsp_ws_client_handler_handle_t handler) {
+    if (handler->close_event_sent ||
+        handler->connection_state != XSP_WS_CLIENT_HANDLER_CONNECTION_STATE_CONNECTED) {
         return;
     }
 
+    if (should_reconnect(handler))
+        disconnect(handler);
+    else
+        send_close_event(handler);
+}
+
+// Handles a complete frame.
+static void handle_frame(xsp_ws_client_handler_handle_t handler,
+                         bool fin,
+                         xsp_ws_frame_opcode_t opcode,
+                         int payload_size,
+                         const void* payload) {
     switch (opcode) {
     case XSP_WS_FRAME_OPCODE_CONTINUATION:
     case XSP_WS_FRAME_OPCODE_TEXT:
@@ -112,7 +305,7 @@ static void do_read(xsp_ws_client_handler_handle_t handler) {
         if (handler->evt_handler.on_ws_client_data_frame_received) {
             handler->evt_handler.on_ws_client_data_frame_received(handler, handler->evt_handler.ctx,
                                                                   fin, opcode, payload_size,
-                                                                  handler->read_buffer);
+                                                                  payload);
         }
         break;
 
@@ -129,16 +322,16 @@ static void do_read(xsp_ws_client_handler_handle_t handler) {
             xsp_ws_client_write_close_frame(handler->client, XSP_WS_STATUS_CLOSE_PROTOCOL_ERROR,
                                             NULL, handler->config.write_timeout_ms);
         } else {
-            const unsigned char* read_buffer = handler->read_buffer;
+            const unsigned char* payload_bytes = (const unsigned char*)payload;
             // Record the close status (if it's valid).
-            int close_status = (int)(((int)read_buffer[0] << 8) | (int)read_buffer[1]);
+            int close_status = (int)(((int)payload_bytes[0] << 8) | (int)payload_bytes[1]);
             if (xsp_ws_is_valid_close_frame_status(close_status)) {
-                if (xsp_ws_client_utf8_validate(payload_size - 2, read_buffer + 2)) {
+                if (xsp_ws_client_utf8_validate(payload_size - 2, payload_bytes + 2)) {
                     handler->close_status = close_status;
                     // Echo the Close frame.
-                    xsp_ws_client_write_frame(
-                            handler->client, true, XSP_WS_FRAME_OPCODE_CONNECTION_CLOSE,
-                            payload_size, handler->read_buffer, handler->config.write_timeout_ms);
+                    xsp_ws_client_write_frame(handler->client, true,
+                                              XSP_WS_FRAME_OPCODE_CONNECTION_CLOSE, payload_size,
+                                              payload, handler->config.write_timeout_ms);
                 } else {
                     handler->close_status = XSP_WS_STATUS_CLOSE_INVALID_DATA;
                     xsp_ws_client_write_close_frame(handler->client,
@@ -158,17 +351,17 @@ static void do_read(xsp_ws_client_handler_handle_t handler) {
     case XSP_WS_FRAME_OPCODE_PING:
         // Send pong automatically.
         xsp_ws_client_write_frame(handler->client, true, XSP_WS_FRAME_OPCODE_PONG, payload_size,
-                                  handler->read_buffer, handler->config.write_timeout_ms);
+                                  payload, handler->config.write_timeout_ms);
         if (handler->evt_handler.on_ws_client_ping_received) {
             handler->evt_handler.on_ws_client_ping_received(handler, handler->evt_handler.ctx,
-                                                            payload_size, handler->read_buffer);
+                                                            payload_size, payload);
         }
         break;
 
     case XSP_WS_FRAME_OPCODE_PONG:
         if (handler->evt_handler.on_ws_client_pong_received) {
             handler->evt_handler.on_ws_client_pong_received(handler, handler->evt_handler.ctx,
-                                                            payload_size, handler->read_buffer);
+                                                            payload_size, payload);
         }
         break;
     }
@@ -176,48 +369,287 @@ static void do_read(xsp_ws_client_handler_handle_t handler) {
         maybe_send_close_event(handler);
 }
 
+// Closes the connection because of a problem with what was received, sending a Close frame with the
+// given status (unless one has already been sent).
+static void close_on_read_error(xsp_ws_client_handler_handle_t handler, int close_status) {
+    if (!handler->close_sent) {
+        handler->close_status = close_status;
+        xsp_ws_client_write_close_frame(handler->client, close_status, NULL,
+                                        handler->config.write_timeout_ms);
+        handler->close_sent = true;
+    }
+    maybe_send_close_event(handler);
+}
+
+// Returns the number of bytes that the client has read from the transport (so that we can tell if
+// a read made progress, even if it didn't complete anything).
+static uint64_t get_bytes_read(xsp_ws_client_handler_handle_t handler) {
+    xsp_ws_client_stats_t stats;
+    xsp_ws_client_get_stats(handler->client, &stats);
+    return stats.bytes_read;
+}
+
+// Notes that the frame being read is only partly received (and nothing more is available for now).
+// `bytes_read` is the value of `get_bytes_read()` before the read; if anything more was received
+// (e.g., part of the frame's header), the read timeout restarts.
+static void partial_read(xsp_ws_client_handler_handle_t handler, uint64_t bytes_read) {
+    if (handler->read_progress_us == 0 || get_bytes_read(handler) != bytes_read)
+        handler->read_progress_us = esp_timer_get_time();
+}
+
+// Reads the next chunk of a frame that's too big for the client's read buffer, without blocking.
+// Frames that fit in our read buffer are accumulated there and handled as complete frames; larger
+// (data) frames are provided chunk by chunk to the data-frame-chunk-received event handler.
+// `bytes_read` is as for `partial_read()`.
+static void do_read_chunk(xsp_ws_client_handler_handle_t handler, uint64_t bytes_read) {
+    bool fin;
+    xsp_ws_frame_opcode_t opcode;
+    int payload_size;
+    int chunk_offset;
+    int chunk_size;
+    bool last_chunk;
+    esp_err_t err = xsp_ws_client_read_frame_chunk(
+            handler->client, &fin, &opcode, &payload_size, &chunk_offset,
+            handler->read_buffer_size - handler->read_buffer_used,
+            (char*)handler->read_buffer + handler->read_buffer_used, &chunk_size, &last_chunk, 0);
+    if (err == ESP_ERR_TIMEOUT) {
+        // Continue when the client is next readable (the client keeps the frame's state).
+        handler->reading_chunks = true;
+        partial_read(handler, bytes_read);
+        return;
+    }
+    if (err != ESP_OK) {
+        ESP_LOGD(TAG, "Read frame chunk failed: %s", esp_err_to_name(err));
+        handler->reading_chunks = false;
+        handler->read_buffer_used = 0;
+        handler->read_progress_us = 0;
+        maybe_send_close_event(handler);
+        return;
+    }
+    handler->reading_chunks = !last_chunk;
+    handler->read_progress_us = last_chunk ? 0 : esp_timer_get_time();
+
+    if (payload_size <= handler->read_buffer_size) {
+        if (!last_chunk) {
+            handler->read_buffer_used = chunk_offset + chunk_size;
+            return;
+        }
+        handler->read_buffer_used = 0;
+        handle_frame(handler, fin, opcode, payload_size, handler->read_buffer);
+        return;
+    }
+
+    // Control frames are never bigger than 125 bytes, so this is a data frame.
+    if (!handler->evt_handler.on_ws_client_data_frame_chunk_received) {
+        ESP_LOGD(TAG, "Frame too big");
+        handler->read_progress_us = 0;
+        close_on_read_error(handler, XSP_WS_STATUS_CLOSE_MESSAGE_TOO_BIG);
+        return;
+    }
+    handler->evt_handler.on_ws_client_data_frame_chunk_received(
+            handler, handler->evt_handler.ctx, fin, opcode, payload_size, chunk_offset, chunk_size,
+            handler->read_buffer, last_chunk);
+    if (should_stop(handler))
+        maybe_send_close_event(handler);
+}
+
+// Reads (as much as is available of) the next frame, without blocking, and handles it if it's
+// complete.
+static void do_read(xsp_ws_client_handler_handle_t handler) {
+    uint64_t bytes_read = get_bytes_read(handler);
+    if (handler->reading_chunks) {
+        do_read_chunk(handler, bytes_read);
+        return;
+    }
+
+    bool fin;
+    xsp_ws_frame_opcode_t opcode;
+    const void* payload;
+    int payload_size;
+    // Try to read the frame in place first; if it's too big, read it in chunks (into our buffer, or
+    // to the data-frame-chunk-received event handler).
+    esp_err_t err = xsp_ws_client_read_frame_view(handler->client, &fin, &opcode, &payload,
+                                                  &payload_size, 0);
+    if (err == ESP_ERR_INVALID_SIZE) {
+        do_read_chunk(handler, bytes_read);
+        return;
+    }
+    if (err == ESP_ERR_TIMEOUT) {
+        // Continue when the client is next readable (what's been read stays in its buffer).
+        partial_read(handler, bytes_read);
+        return;
+    }
+    handler->read_progress_us = 0;
+    if (err != ESP_OK) {
+        ESP_LOGD(TAG, "Read frame failed: %s", esp_err_to_name(err));
+        maybe_send_close_event(handler);
+        return;
+    }
+    if (payload_size > handler->read_buffer_size) {
+        // The frame fit in the client's buffer, but it's bigger than we allow (or, if reading in
+        // chunks, it's a data frame that we were expected to read in chunks).
+        if (handler->evt_handler.on_ws_client_data_frame_chunk_received) {
+            handler->evt_handler.on_ws_client_data_frame_chunk_received(
+                    handler, handler->evt_handler.ctx, fin, opcode, payload_size, 0, payload_size,
+                    payload, true);
+            if (should_stop(handler))
+                maybe_send_close_event(handler);
+            return;
+        }
+        ESP_LOGD(TAG, "Frame too big");
+        close_on_read_error(handler, XSP_WS_STATUS_CLOSE_MESSAGE_TOO_BIG);
+        return;
+    }
+
+    handle_frame(handler, fin, opcode, payload_size, payload);
+}
+
+// Closes the connection if the frame being read has been only partly received, without progress,
+// for longer than the read timeout (e.g., if the server or the network has gone away).
+static void check_read_timeout(xsp_ws_client_handler_handle_t handler) {
+    if (handler->read_progress_us == 0 || should_stop(handler))
+        return;
+    if (esp_timer_get_time() - handler->read_progress_us <=
+        (int64_t)handler->config.read_timeout_ms * 1000) {
+        return;
+    }
+    ESP_LOGD(TAG, "Read timed out");
+    handler->read_progress_us = 0;
+    close_on_read_error(handler, XSP_WS_STATUS_CLOSE_POLICY_VIOLATION);
+}
+
 static xsp_loop_fd_watch_for_t on_loop_will_select(xsp_loop_handle_t loop, void* ctx, int fd) {
     xsp_ws_client_handler_handle_t handler = (xsp_ws_client_handler_handle_t)ctx;
 
     // TODO(vtl): Even if We do real work in this, but the loop will still consider us to be idle.
     while (!should_stop(handler) && xsp_ws_client_has_buffered_read_data(handler->client))
         do_read(handler);
+    check_read_timeout(handler);
+
+    // Write anything written (while corked) during this loop iteration, without blocking, before
+    // the loop waits; if it can't all be written now, the rest is written when the socket is
+    // writable. (If a frame is pending, the buffered data will be written with it.)
+    if (handler->config.cork &&
+        handler->connection_state == XSP_WS_CLIENT_HANDLER_CONNECTION_STATE_CONNECTED &&
+        !xsp_ws_client_has_pending_write(handler->client) &&
+        xsp_ws_client_flush_nonblocking(handler->client) == ESP_ERR_TIMEOUT) {
+        handler->flush_pending = true;
+    }
 
     if (should_stop(handler)) {
         maybe_send_close_event(handler);
         return XSP_LOOP_FD_WATCH_FOR_NONE;
     }
 
-    return handler->sending_message ? XSP_LOOP_FD_WATCH_FOR_WRITE_READ : XSP_LOOP_FD_WATCH_FOR_READ;
+    return handler->flush_pending || (handler->send_queue_count > 0 && !handler->send_paused)
+                   ? XSP_LOOP_FD_WATCH_FOR_WRITE_READ
+                   : XSP_LOOP_FD_WATCH_FOR_READ;
 }
 
-static void send_message_completed(xsp_ws_client_handler_handle_t handler, bool success) {
-    handler->sending_message = false;
-    if (handler->evt_handler.on_ws_client_message_sent)
-        handler->evt_handler.on_ws_client_message_sent(handler, handler->evt_handler.ctx, success);
+// Handles failure of the producer of the streamed message being sent. If part of the message has
+// already been sent, the connection has to be closed, since the message can't be completed.
+static void abort_streamed_message(xsp_ws_client_handler_handle_t handler) {
+    bool started = handler->send_started;
+    send_message_completed(handler, false);
+    if (started && !handler->close_sent) {
+        handler->close_status = XSP_WS_STATUS_CLOSE_INTERNAL_SERVER_ERROR;
+        xsp_ws_client_write_close_frame(handler->client, XSP_WS_STATUS_CLOSE_INTERNAL_SERVER_ERROR,
+                                        NULL, handler->config.write_timeout_ms);
+        handler->close_sent = true;
+    }
+    if (should_stop(handler))
+        maybe_send_close_event(handler);
 }
 
-static void do_write(xsp_ws_client_handler_handle_t handler) {
-    int write_size = handler->config.max_data_frame_write_size;
-    if (write_size > handler->send_size - handler->send_written)
-        write_size = handler->send_size - handler->send_written;
-
+// Starts writing the next frame of the message at the head of the send queue, without blocking,
+// putting the result in `*err` (ESP_ERR_TIMEOUT if the frame is pending, i.e., only partially
+// written). Returns false if no frame was started (if the producer has no data, or failed, or we
+// should stop).
+static bool start_write_frame(xsp_ws_client_handler_handle_t handler, esp_err_t* err) {
+    const send_queue_entry_t* entry = &handler->send_queue[handler->send_queue_head];
     xsp_ws_frame_opcode_t opcode;
-    if (handler->send_written == 0)
-        opcode = handler->send_is_binary ? XSP_WS_FRAME_OPCODE_BINARY : XSP_WS_FRAME_OPCODE_TEXT;
+    if (!handler->send_started)
+        opcode = entry->is_binary ? XSP_WS_FRAME_OPCODE_BINARY : XSP_WS_FRAME_OPCODE_TEXT;
     else
         opcode = XSP_WS_FRAME_OPCODE_CONTINUATION;
-    const void* payload = (const char*)handler->send_message + handler->send_written;
+
+    int write_size;
+    const void* payload = NULL;
+    if (entry->producer) {
+        // The producer writes after the headroom, so that the frame can be written in place.
+        bool done = false;
+        write_size = entry->producer(
+                handler, entry->producer_ctx, handler->config.max_data_frame_write_size,
+                (unsigned char*)handler->stream_buffer + XSP_WS_CLIENT_FRAME_HEADROOM, &done);
+        if (write_size < 0 || write_size > handler->config.max_data_frame_write_size) {
+            ESP_LOGD(TAG, "Producer failed");
+            abort_streamed_message(handler);
+            return false;
+        }
+        // The producer may have closed the connection.
+        if (should_stop(handler)) {
+            maybe_send_close_event(handler);
+            return false;
+        }
+        if (write_size == 0 && !done) {
+            // Wait for `xsp_ws_client_handler_resume_streamed_message()`.
+            handler->send_paused = true;
+            return false;
+        }
+        handler->send_fin = done;
+    } else {
+        write_size = handler->config.max_data_frame_write_size;
+        if (write_size > entry->size - handler->send_written)
+            write_size = entry->size - handler->send_written;
+        payload = (const char*)entry->message + handler->send_written;
+        handler->send_fin = handler->send_written + write_size == entry->size;
+    }
+    handler->send_started = true;
     handler->send_written += write_size;
-    bool fin = handler->send_written == handler->send_size;
+    // Note: The payload (the message, or our stream buffer) remains valid until the frame has been
+    // written.
+    if (entry->producer) {
+        *err = xsp_ws_client_write_frame_in_place_nonblocking(handler->client, handler->send_fin,
+                                                              opcode, write_size,
+                                                              handler->stream_buffer);
+    } else {
+        *err = xsp_ws_client_write_frame_nonblocking(handler->client, handler->send_fin, opcode,
+                                                      write_size, payload);
+    }
+    return true;
+}
+
+// Continues the client's pending nonblocking write (of a frame or a flush), without blocking.
+// Returns ESP_ERR_TIMEOUT if it's still pending.
+static esp_err_t continue_pending_write(xsp_ws_client_handler_handle_t handler) {
+    if (xsp_ws_client_has_pending_write(handler->client))
+        return xsp_ws_client_continue_write(handler->client);
+    // A blocking write (e.g., of a pong) completed it in the meantime; if that failed, so did the
+    // pending write.
+    return xsp_ws_client_get_state(handler->client) == XSP_WS_CLIENT_STATE_FAILED_NO_CLOSE
+                   ? ESP_FAIL
+                   : ESP_OK;
+}
+
+// Writes (or continues writing) the next frame of the message at the head of the send queue,
+// without blocking.
+static void do_write(xsp_ws_client_handler_handle_t handler) {
+    esp_err_t err;
+    if (handler->frame_pending)
+        err = continue_pending_write(handler);
+    else if (!start_write_frame(handler, &err))
+        return;
+    handler->frame_pending = err == ESP_ERR_TIMEOUT;
+    if (handler->frame_pending)
+        return;  // We'll continue when the client is writable.
 
-    esp_err_t err = xsp_ws_client_write_frame(handler->client, fin, opcode, write_size, payload,
-                                              handler->config.write_timeout_ms);
     if (err != ESP_OK) {
         ESP_LOGD(TAG, "Write frame failed: %s", esp_err_to_name(err));
-        send_message_completed(handler, false);
+        // If we'll reconnect, the messages will be sent (again) (see `disconnect()`).
+        if (!should_reconnect(handler))
+            fail_send_queue(handler);
     } else {
-        if (fin)
+        if (handler->send_fin)
             send_message_completed(handler, true);
     }
     if (should_stop(handler))
@@ -227,10 +659,28 @@ static void do_write(xsp_ws_client_handler_handle_t handler) {
 static void on_loop_can_write_fd(xsp_loop_handle_t loop, void* ctx, int fd) {
     xsp_ws_client_handler_handle_t handler = (xsp_ws_client_handler_handle_t)ctx;
 
-    while (!should_stop(handler) && handler->sending_message) {
+    // First finish the flush (see `on_loop_will_select()`), if one is pending.
+    if (handler->flush_pending) {
+        esp_err_t err = continue_pending_write(handler);
+        if (err == ESP_ERR_TIMEOUT)
+            return;
+        handler->flush_pending = false;
+        if (err != ESP_OK) {
+            ESP_LOGD(TAG, "Flush failed: %s", esp_err_to_name(err));
+            if (should_stop(handler))
+                maybe_send_close_event(handler);
+            return;
+        }
+    }
+
+    // Keep going with the next queued message (if any) as long as the socket is writable. (While
+    // corked, frames are only written once the write buffer fills.) If a frame is left pending,
+    // the socket is no longer writable (for now).
+    while (!should_stop(handler) && handler->send_queue_count > 0 && !handler->send_paused) {
         do_write(handler);
-        if (xsp_ws_client_poll_write(handler->client, 0) != ESP_OK)
+        if (handler->frame_pending || xsp_ws_client_poll_write(handler->client, 0) != ESP_OK) {
             break;
+        }
     }
 }
 
@@ -240,6 +690,62 @@ static void on_loop_can_read_fd(xsp_loop_handle_t loop, void* ctx, int fd) {
     do_read(handler);
 }
 
+static bool watch_client(xsp_ws_client_handler_handle_t handler) {
+    xsp_loop_fd_event_handler_t loop_fd_event_handler = {
+            on_loop_will_select, on_loop_can_write_fd, on_loop_can_read_fd, handler,
+            xsp_ws_client_get_select_fd(handler->client),
+    };
+    handler->fd_watcher = xsp_loop_add_fd_watcher(handler->loop, &loop_fd_event_handler);
+    return !!handler->fd_watcher;
+}
+
+static void on_client_open(xsp_ws_client_handle_t client, void* ctx, esp_err_t result) {
+    xsp_ws_client_handler_handle_t handler = (xsp_ws_client_handler_handle_t)ctx;
+
+    if (result == ESP_OK && (handler->close_requested || !watch_client(handler))) {
+        // Nothing has been written, so this won't block.
+        xsp_ws_client_close(client);
+        result = ESP_FAIL;
+    }
+    if (handler->close_requested) {
+        handler->connection_state = XSP_WS_CLIENT_HANDLER_CONNECTION_STATE_DISCONNECTED;
+        send_close_event(handler);
+        return;
+    }
+    if (result != ESP_OK) {
+        ESP_LOGD(TAG, "Reconnect failed: %s", esp_err_to_name(result));
+        handler->reconnect_attempts++;
+        set_connection_state(handler, XSP_WS_CLIENT_HANDLER_CONNECTION_STATE_DISCONNECTED,
+                             XSP_WS_STATUS_CLOSE_RESERVED_ABNORMAL_CLOSURE);
+        schedule_reconnect(handler);
+        return;
+    }
+
+    handler->reconnect_attempts = 0;
+    handler->close_status = XSP_WS_STATUS_NONE;
+    set_connection_state(handler, XSP_WS_CLIENT_HANDLER_CONNECTION_STATE_CONNECTED,
+                         XSP_WS_STATUS_NONE);
+}
+
+static void on_loop_can_read_timer_fd(xsp_loop_handle_t loop, void* ctx, int fd) {
+    xsp_ws_client_handler_handle_t handler = (xsp_ws_client_handler_handle_t)ctx;
+
+    uint64_t expirations;
+    if (read(fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+        return;
+    // The timer is also used to deliver the close event after `xsp_ws_client_handler_close()`.
+    if (handler->close_requested) {
+        send_close_event(handler);
+        return;
+    }
+
+    set_connection_state(handler, XSP_WS_CLIENT_HANDLER_CONNECTION_STATE_CONNECTING,
+                         XSP_WS_STATUS_NONE);
+    esp_err_t err = xsp_ws_client_open_async(handler->client, loop, &on_client_open, handler);
+    if (err != ESP_OK)
+        on_client_open(handler->client, handler, err);
+}
+
 xsp_ws_client_handler_handle_t xsp_ws_client_handler_init(
         const xsp_ws_client_handler_config_t* config,
         const xsp_ws_client_event_handler_t* evt_handler,
@@ -274,44 +780,106 @@ xsp_ws_client_handler_handle_t xsp_ws_client_handler_init(
     handler->evt_handler = *evt_handler;
     handler->client = client;
     handler->loop = loop;
+    handler->timer_fd = -1;
+    handler->timer_fd_watcher = NULL;
+    handler->read_buffer = NULL;
+    handler->send_queue = NULL;
+    handler->stream_buffer = NULL;
 
-    xsp_loop_fd_event_handler_t loop_fd_event_handler = {
-            on_loop_will_select, on_loop_can_write_fd, on_loop_can_read_fd, handler, fd,
-    };
-    handler->fd_watcher = xsp_loop_add_fd_watcher(loop, &loop_fd_event_handler);
-    if (!handler->fd_watcher) {
+    if (!watch_client(handler)) {
         ESP_LOGE(TAG, "Failed to watch FD");
+        free(handler);
         return NULL;
     }
 
     handler->read_buffer = malloc(handler->config.max_frame_read_size);
     if (!handler->read_buffer) {
         ESP_LOGE(TAG, "Allocation failed");
-        // TODO(vtl): Check return value?
-        xsp_loop_remove_fd_watcher(loop, handler->fd_watcher);
-        free(handler);
-        return NULL;
+        goto fail;
     }
     handler->read_buffer_size = handler->config.max_frame_read_size;
+    handler->send_queue = (send_queue_entry_t*)malloc(handler->config.send_queue_max_messages *
+                                                      sizeof(send_queue_entry_t));
+    if (!handler->send_queue) {
+        ESP_LOGE(TAG, "Allocation failed");
+        goto fail;
+    }
+    if (handler->config.cork)
+        xsp_ws_client_set_cork(client, true);  // This can't fail.
+    handler->reading_chunks = false;
+    handler->read_buffer_used = 0;
+    handler->read_progress_us = 0;
+
+    if (handler->config.reconnect_base_delay_ms > 0) {
+        handler->timer_fd = xsp_timerfd_create(XSP_TIMERFD_NONBLOCK);
+        if (handler->timer_fd == -1) {
+            ESP_LOGE(TAG, "Timer FD creation failed");
+            goto fail;
+        }
+        xsp_loop_fd_event_handler_t timer_fd_event_handler = {
+                NULL, NULL, on_loop_can_read_timer_fd, handler, handler->timer_fd,
+        };
+        handler->timer_fd_watcher = xsp_loop_add_fd_watcher(loop, &timer_fd_event_handler);
+        if (!handler->timer_fd_watcher) {
+            ESP_LOGE(TAG, "Failed to watch timer FD");
+            goto fail;
+        }
+    }
 
     handler->close_sent = false;
     handler->close_event_sent = false;
     handler->close_status = XSP_WS_STATUS_NONE;
-    handler->sending_message = false;
+    handler->send_queue_head = 0;
+    handler->send_queue_count = 0;
+    handler->send_queue_bytes = 0;
+    handler->send_started = false;
+    handler->send_written = 0;
+    handler->send_fin = false;
+    handler->send_paused = false;
+    handler->frame_pending = false;
+    handler->flush_pending = false;
+    memset(&handler->send_queue_stats, 0, sizeof(handler->send_queue_stats));
+    handler->connection_state = XSP_WS_CLIENT_HANDLER_CONNECTION_STATE_CONNECTED;
+    handler->reconnect_attempts = 0;
+    handler->close_requested = false;
+    handler->client_closing = false;
 
     return handler;
+
+fail:
+    // TODO(vtl): Check return values?
+    if (handler->timer_fd != -1)
+        close(handler->timer_fd);
+    free(handler->send_queue);
+    free(handler->read_buffer);
+    xsp_loop_remove_fd_watcher(loop, handler->fd_watcher);
+    free(handler);
+    return NULL;
 }
 
 esp_err_t xsp_ws_client_handler_cleanup(xsp_ws_client_handler_handle_t handler) {
     if (!handler)
         return ESP_FAIL;
 
-    if (xsp_loop_is_running(handler->loop))
+    if (xsp_loop_is_running(handler->loop) || handler->client_closing)
         return ESP_ERR_INVALID_STATE;
 
+    // Otherwise, `on_client_open()` would be called after the handler is freed.
+    if (handler->connection_state == XSP_WS_CLIENT_HANDLER_CONNECTION_STATE_CONNECTING)
+        xsp_ws_client_cancel_open_async(handler->client);  // Ignore any error.
+
+    if (handler->config.cork)
+        xsp_ws_client_set_cork(handler->client, false);  // This can't fail.
+    free(handler->stream_buffer);
+    free(handler->send_queue);
     free(handler->read_buffer);
-    // TODO(vtl): Check return value?
-    xsp_loop_remove_fd_watcher(handler->loop, handler->fd_watcher);
+    // TODO(vtl): Check return values?
+    if (handler->fd_watcher)
+        xsp_loop_remove_fd_watcher(handler->loop, handler->fd_watcher);
+    if (handler->timer_fd_watcher)
+        xsp_loop_remove_fd_watcher(handler->loop, handler->timer_fd_watcher);
+    if (handler->timer_fd != -1)
+        close(handler->timer_fd);
     free(handler);
     return ESP_OK;
 }
@@ -330,22 +898,111 @@ xsp_loop_handle_t xsp_ws_client_handler_get_loop(xsp_ws_client_handler_handle_t
     return handler->loop;
 }
 
+// Adds the given message to the send queue (checking state and limits).
+static esp_err_t queue_message(xsp_ws_client_handler_handle_t handler,
+                               const send_queue_entry_t* entry) {
+    if (!xsp_loop_is_running(handler->loop))
+        return ESP_ERR_INVALID_STATE;
+    if (handler->close_sent || handler->close_event_sent)
+        return ESP_FAIL;
+    if (handler->timer_fd != -1) {
+        // The message will be sent once reconnected (if necessary).
+        if (handler->close_requested)
+            return ESP_FAIL;
+    } else if (xsp_ws_client_get_state(handler->client) != XSP_WS_CLIENT_STATE_OK) {
+        return ESP_FAIL;
+    }
+    // A message bigger than the byte limit is only accepted if the queue is empty.
+    if (handler->send_queue_count == handler->config.send_queue_max_messages ||
+        (handler->config.send_queue_max_bytes > 0 && handler->send_queue_count > 0 &&
+         entry->size > handler->config.send_queue_max_bytes - handler->send_queue_bytes)) {
+        handler->send_queue_stats.messages_rejected++;
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    int index = (handler->send_queue_head + handler->send_queue_count) %
+                handler->config.send_queue_max_messages;
+    handler->send_queue[index] = *entry;
+    handler->send_queue_count++;
+    handler->send_queue_bytes += entry->size;
+
+    xsp_ws_client_handler_send_queue_stats_t* stats = &handler->send_queue_stats;
+    if (handler->send_queue_count > stats->max_queued_messages)
+        stats->max_queued_messages = handler->send_queue_count;
+    if (handler->send_queue_bytes > stats->max_queued_bytes)
+        stats->max_queued_bytes = handler->send_queue_bytes;
+    return ESP_OK;
+}
+
 esp_err_t xsp_ws_client_handler_send_message(xsp_ws_client_handler_handle_t handler,
                                              bool binary,
                                              int message_size,
                                              const void* message) {
+    return xsp_ws_client_handler_send_message_with_callback(handler, binary, message_size, message,
+                                                            NULL, NULL);
+}
+
+esp_err_t xsp_ws_client_handler_send_message_with_callback(xsp_ws_client_handler_handle_t handler,
+                                                           bool binary,
+                                                           int message_size,
+                                                           const void* message,
+                                                           on_ws_client_message_sent_func_t on_sent,
+                                                           void* on_sent_ctx) {
     if (!handler || message_size < 0 || (message_size > 0 && !message))
         return ESP_ERR_INVALID_ARG;
-    if (!xsp_loop_is_running(handler->loop) || handler->sending_message)
-        return ESP_ERR_INVALID_STATE;
-    if (xsp_ws_client_get_state(handler->client) != XSP_WS_CLIENT_STATE_OK)
-        return ESP_FAIL;
 
-    handler->sending_message = true;
-    handler->send_is_binary = binary;
-    handler->send_message = message;
-    handler->send_size = message_size;
-    handler->send_written = 0;
+    send_queue_entry_t entry = {binary, message, message_size, NULL, NULL, on_sent, on_sent_ctx};
+    return queue_message(handler, &entry);
+}
+
+esp_err_t xsp_ws_client_handler_send_streamed_message(
+        xsp_ws_client_handler_handle_t handler,
+        bool binary,
+        xsp_ws_client_handler_producer_func_t producer,
+        void* producer_ctx,
+        on_ws_client_message_sent_func_t on_sent,
+        void* on_sent_ctx) {
+    if (!handler || !producer)
+        return ESP_ERR_INVALID_ARG;
+
+    if (!handler->stream_buffer) {
+        handler->stream_buffer =
+                malloc(XSP_WS_CLIENT_FRAME_HEADROOM + handler->config.max_data_frame_write_size);
+        if (!handler->stream_buffer)
+            return ESP_ERR_NO_MEM;
+    }
+
+    send_queue_entry_t entry = {binary, NULL, 0, producer, producer_ctx, on_sent, on_sent_ctx};
+    return queue_message(handler, &entry);
+}
+
+esp_err_t xsp_ws_client_handler_resume_streamed_message(xsp_ws_client_handler_handle_t handler) {
+    if (!handler)
+        return ESP_ERR_INVALID_ARG;
+
+    handler->send_paused = false;
+    return ESP_OK;
+}
+
+esp_err_t xsp_ws_client_handler_get_send_queue_stats(
+        xsp_ws_client_handler_handle_t handler,
+        xsp_ws_client_handler_send_queue_stats_t* stats) {
+    if (!handler || !stats)
+        return ESP_ERR_INVALID_ARG;
+
+    *stats = handler->send_queue_stats;
+    stats->queued_messages = handler->send_queue_count;
+    stats->queued_bytes = handler->send_queue_bytes;
+    return ESP_OK;
+}
+
+esp_err_t xsp_ws_client_handler_reset_send_queue_stats(xsp_ws_client_handler_handle_t handler) {
+    if (!handler)
+        return ESP_ERR_INVALID_ARG;
+
+    memset(&handler->send_queue_stats, 0, sizeof(handler->send_queue_stats));
+    handler->send_queue_stats.max_queued_messages = handler->send_queue_count;
+    handler->send_queue_stats.max_queued_bytes = handler->send_queue_bytes;
     return ESP_OK;
 }
 
@@ -355,6 +1012,19 @@ esp_err_t xsp_ws_client_handler_close(xsp_ws_client_handler_handle_t handler, in
     if (!xsp_loop_is_running(handler->loop))
         return ESP_ERR_INVALID_STATE;
 
+    bool was_close_requested = handler->close_requested;
+    handler->close_requested = true;
+    if (handler->connection_state != XSP_WS_CLIENT_HANDLER_CONNECTION_STATE_CONNECTED) {
+        // Stop reconnecting. If the client is being closed or reopened, we'll send the close event
+        // when that's done; otherwise, use the timer to send it.
+        if (!was_close_requested && !handler->client_closing &&
+            handler->connection_state == XSP_WS_CLIENT_HANDLER_CONNECTION_STATE_DISCONNECTED &&
+            !arm_timer(handler, 0)) {
+            ESP_LOGE(TAG, "Failed to set timer");
+        }
+        return ESP_OK;
+    }
+
     // Don't report an error if we can't actually send a close frame. Note that in the
     // XSP_WS_CLIENT_STATE_FAILED case, we'll send a close frame automatically.
     if (xsp_ws_client_get_state(handler->client) != XSP_WS_CLIENT_STATE_OK)
@@ -372,6 +1042,20 @@ esp_err_t xsp_ws_client_handler_close(xsp_ws_client_handler_handle_t handler, in
     return ESP_OK;
 }
 
+esp_err_t xsp_ws_client_handler_reject_frame(xsp_ws_client_handler_handle_t handler) {
+    if (!handler)
+        return ESP_ERR_INVALID_ARG;
+    if (handler->connection_state != XSP_WS_CLIENT_HANDLER_CONNECTION_STATE_CONNECTED ||
+        handler->close_event_sent) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    ESP_LOGD(TAG, "Frame rejected");
+    handler->read_progress_us = 0;
+    close_on_read_error(handler, XSP_WS_STATUS_CLOSE_MESSAGE_TOO_BIG);
+    return ESP_OK;
+}
+
 esp_err_t xsp_ws_client_handler_ping(xsp_ws_client_handler_handle_t handler,
                                      int payload_size,
                                      const void* payload) {
@@ -379,6 +1063,8 @@ esp_err_t xsp_ws_client_handler_ping(xsp_ws_client_handler_handle_t handler,
         return ESP_ERR_INVALID_ARG;
     if (!xsp_loop_is_running(handler->loop))
         return ESP_ERR_INVALID_STATE;
+    if (handler->connection_state != XSP_WS_CLIENT_HANDLER_CONNECTION_STATE_CONNECTED)
+        return ESP_FAIL;
 
     return xsp_ws_client_write_frame(handler->client, true, XSP_WS_FRAME_OPCODE_PING, payload_size,
                                      payload, handler->config.write_timeout_ms);
@@ -0,0 +1,69 @@
+// Copyright 2019 Tricot Inc.
+// Use of this source code is governed by the license in the LICENSE file.
+
+#include "xsp_ws_client_mask.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// We mask a word at a time: 4 bytes on the ESP32 (8 bytes on 64-bit hosts, where the compiler may
+// also vectorize the main loop). Note that the ESP32 faults on unaligned word accesses, so words
+// are only ever accessed aligned.
+typedef uintptr_t __attribute__((__may_alias__)) word_t;
+
+void xsp_ws_mask(const unsigned char masking_key[4],
+                 int key_offset,
+                 int size,
+                 const void* src,
+                 void* dst) {
+    const unsigned char* s = (const unsigned char*)src;
+    unsigned char* d = (unsigned char*)dst;
+    unsigned k = (unsigned)key_offset % 4;
+
+    // Head: bytes up to the first aligned `dst` word.
+    while (size > 0 && ((uintptr_t)d % sizeof(word_t)) != 0) {
+        *d++ = *s++ ^ masking_key[k];
+        k = (k + 1) % 4;
+        size--;
+    }
+    if (size <= 0)
+        return;
+
+    // If `src` isn't also aligned, it's faster to let memcpy() deal with that and then mask in
+    // place. (If `src` is misaligned then it's not the same as `dst`.)
+    if (((uintptr_t)s % sizeof(word_t)) != 0) {
+        memcpy(d, s, (size_t)size);
+        s = d;
+    }
+
+    // The key, rotated to start at `k` and repeated to fill a word. Since the word size is a
+    // multiple of 4, the rotation is the same for every word.
+    word_t key_word;
+    {
+        unsigned char key_bytes[sizeof(word_t)];
+        for (size_t i = 0; i < sizeof(key_bytes); i++)
+            key_bytes[i] = masking_key[(k + i) % 4];
+        memcpy(&key_word, key_bytes, sizeof(key_word));
+    }
+
+    const word_t* ws = (const word_t*)s;
+    word_t* wd = (word_t*)d;
+    size_t num_words = (size_t)size / sizeof(word_t);
+    for (; num_words >= 4; num_words -= 4, ws += 4, wd += 4) {
+        wd[0] = ws[0] ^ key_word;
+        wd[1] = ws[1] ^ key_word;
+        wd[2] = ws[2] ^ key_word;
+        wd[3] = ws[3] ^ key_word;
+    }
+    for (; num_words > 0; num_words--)
+        *wd++ = *ws++ ^ key_word;
+
+    // Tail: remaining bytes (the key position is still `k`).
+    s = (const unsigned char*)ws;
+    d = (unsigned char*)wd;
+    for (size %= (int)sizeof(word_t); size > 0; size--) {
+        *d++ = *s++ ^ masking_key[k];
+        k = (k + 1) % 4;
+    }
+}
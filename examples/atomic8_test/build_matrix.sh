@@ -0,0 +1,29 @@
+#!/bin/bash
+# Copyright 2019 Tricot Inc.
+# Use of this source code is governed by the license in the LICENSE file.
+
+# Builds this test once for each xsp_atomic8 implementation strategy (each in its own build
+# directory, with its own sdkconfig), so that correctness and performance can be compared. Each
+# build may then be flashed and run using, e.g.:
+#
+#   idf.py -B build_matrix/build_SEQLOCK -p <port> flash monitor
+#
+# Note: This script assumes that the environment has been set up.
+
+STRATEGIES=(GLOBAL_LOCK STRIPED_LOCK SEQLOCK)
+
+set -e
+
+cd "$(dirname "${BASH_SOURCE}")"
+mkdir -p build_matrix
+
+for STRATEGY in "${STRATEGIES[@]}"; do
+    echo
+    echo "*** Building: ${STRATEGY}"
+    echo
+
+    echo "CONFIG_XSP_ATOMIC8_${STRATEGY}=y" > "build_matrix/sdkconfig.defaults.${STRATEGY}"
+    SDKCONFIG="${PWD}/build_matrix/sdkconfig.${STRATEGY}" \
+        SDKCONFIG_DEFAULTS="${PWD}/build_matrix/sdkconfig.defaults.${STRATEGY}" \
+        idf.py -B "build_matrix/build_${STRATEGY}" build
+done
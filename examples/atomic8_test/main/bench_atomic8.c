@@ -0,0 +1,141 @@
+// Copyright 2019 Tricot Inc.
+// Use of this source code is governed by the license in the LICENSE file.
+
+#include "bench_atomic8.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include "xsp_percpu_counter.h"
+
+#include "sdkconfig.h"
+
+#define VERIFY(cond, text) printf("  [%s] %s\n", (cond) ? "pass" : "FAIL", (text))
+
+#define NUM_TASKS 4  // Alternately pinned to cores 0 and 1.
+#define NUM_ITERATIONS 100000
+
+#define START_BIT 1
+
+#if defined(CONFIG_XSP_ATOMIC8_GLOBAL_LOCK)
+#define STRATEGY "global lock"
+#elif defined(CONFIG_XSP_ATOMIC8_STRIPED_LOCK)
+#define STRATEGY "striped locks"
+#elif defined(CONFIG_XSP_ATOMIC8_SEQLOCK)
+#define STRATEGY "seqlocks"
+#else
+#define STRATEGY "unknown"
+#endif
+
+// Keep counters on separate cache lines, so that only the locks can contend.
+typedef struct {
+    atomic_uint_least64_t value;
+} __attribute__((aligned(32))) counter_t;
+
+typedef struct {
+    counter_t* counter;
+    bool load;                     // If set, loads instead of incrementing.
+    xsp_percpu_counter_t* percpu;  // If set, increments this instead of `counter`.
+    EventGroupHandle_t start;
+    SemaphoreHandle_t done;
+} bench_task_args_t;
+
+static counter_t g_counters[NUM_TASKS];
+static xsp_percpu_counter_t g_percpu_counter = XSP_PERCPU_COUNTER_INITIALIZER;
+
+static void bench_task(void* pvParameters) {
+    const bench_task_args_t* args = (const bench_task_args_t*)pvParameters;
+    xEventGroupWaitBits(args->start, START_BIT, pdFALSE, pdFALSE, portMAX_DELAY);
+
+    if (args->percpu) {
+        for (int i = 0; i < NUM_ITERATIONS; i++)
+            xsp_percpu_counter_add(args->percpu, 1);
+    } else if (args->load) {
+        uint64_t last = 0;
+        for (int i = 0; i < NUM_ITERATIONS; i++) {
+            uint64_t value = atomic_load(&args->counter->value);
+            // Values should never go backwards (or be torn).
+            if (value < last)
+                printf("  [FAIL] load went backwards\n");
+            last = value;
+        }
+    } else {
+        for (int i = 0; i < NUM_ITERATIONS; i++)
+            atomic_fetch_add(&args->counter->value, 1);
+    }
+
+    xSemaphoreGive(args->done);
+    vTaskDelete(NULL);
+}
+
+// Runs the benchmark, with each task using its own counter (if `disjoint`) or a single shared
+// counter, and returns the elapsed time in microseconds. If `readers`, all but the first task only
+// load (instead of incrementing). If `percpu`, all tasks increment a single per-core counter
+// instead.
+static int64_t run_bench(bool disjoint, bool readers, bool percpu) {
+    static bench_task_args_t args[NUM_TASKS];
+    EventGroupHandle_t start = xEventGroupCreate();
+    SemaphoreHandle_t done = xSemaphoreCreateCounting(NUM_TASKS, 0);
+
+    for (int i = 0; i < NUM_TASKS; i++) {
+        atomic_init(&g_counters[i].value, 0);
+        args[i].counter = disjoint ? &g_counters[i] : &g_counters[0];
+        args[i].load = readers && i > 0;
+        args[i].percpu = percpu ? &g_percpu_counter : NULL;
+        args[i].start = start;
+        args[i].done = done;
+        xTaskCreatePinnedToCore(&bench_task, "BENCH", 2048, &args[i], 5, NULL, i % 2);
+    }
+
+    int64_t start_us = esp_timer_get_time();
+    xEventGroupSetBits(start, START_BIT);
+    for (int i = 0; i < NUM_TASKS; i++)
+        xSemaphoreTake(done, portMAX_DELAY);
+    int64_t elapsed_us = esp_timer_get_time() - start_us;
+
+    vSemaphoreDelete(done);
+    vEventGroupDelete(start);
+    return elapsed_us;
+}
+
+static void report(const char* name, int64_t elapsed_us) {
+    int64_t ops = (int64_t)NUM_TASKS * NUM_ITERATIONS;
+    printf("  %s: %d ops in %d us (%d ops/s)\n", name, (int)ops, (int)elapsed_us,
+           (int)(elapsed_us > 0 ? ops * 1000000 / elapsed_us : 0));
+}
+
+void bench_atomic8(void) {
+    printf("64-bit atomic contention (strategy: %s; %d tasks on 2 cores, %d iterations each):\n",
+           STRATEGY, NUM_TASKS, NUM_ITERATIONS);
+
+    int64_t elapsed_us = run_bench(true, false, false);
+    bool ok = true;
+    for (int i = 0; i < NUM_TASKS; i++)
+        ok = ok && atomic_load(&g_counters[i].value) == NUM_ITERATIONS;
+    VERIFY(ok, "disjoint counters");
+    report("disjoint counters", elapsed_us);
+
+    elapsed_us = run_bench(false, false, false);
+    VERIFY(atomic_load(&g_counters[0].value) == (uint64_t)NUM_TASKS * NUM_ITERATIONS,
+           "shared counter");
+    report("shared counter", elapsed_us);
+
+    // Loads don't take the lock, so readers shouldn't slow down the writer (much).
+    elapsed_us = run_bench(false, true, false);
+    VERIFY(atomic_load(&g_counters[0].value) == NUM_ITERATIONS, "shared counter, 1 writer");
+    report("shared counter, 1 writer + readers", elapsed_us);
+
+    xsp_percpu_counter_init(&g_percpu_counter);
+    elapsed_us = run_bench(false, false, true);
+    VERIFY(xsp_percpu_counter_read(&g_percpu_counter) == (uint64_t)NUM_TASKS * NUM_ITERATIONS,
+           "shared per-core counter");
+    report("shared per-core counter", elapsed_us);
+}
@@ -0,0 +1,18 @@
+// Copyright 2019 Tricot Inc.
+// Use of this source code is governed by the license in the LICENSE file.
+
+#ifndef BENCH_ATOMIC8_H_
+#define BENCH_ATOMIC8_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Benchmarks 64-bit atomics under contention, from tasks on both cores.
+void bench_atomic8(void);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // BENCH_ATOMIC8_H_
@@ -7,12 +7,14 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
+#include "bench_atomic8.h"
 #include "verify_cxx_atomic.h"
 #include "verify_stdatomic.h"
 
 void app_main(void) {
     verify_stdatomic();
     verify_cxx_atomic();
+    bench_atomic8();
     printf("DONE\n");
 
     vTaskDelay(10000 / portTICK_PERIOD_MS);
@@ -11,8 +11,9 @@ extern "C" void verify_cxx_atomic(void) {
 
     std::atomic_uint_least64_t x;
 
-    // TODO(vtl): This doesn't build.
-    // VERIFY(!x.is_lock_free(), "is_lock_free");
+    VERIFY(!x.is_lock_free(), "is_lock_free");
+    std::atomic_uint_least32_t y;
+    VERIFY(y.is_lock_free(), "is_lock_free (32-bit)");
 
     std::atomic_init(&x, 123ULL);
     VERIFY(x.load() == 123, "std::atomic_init, load");
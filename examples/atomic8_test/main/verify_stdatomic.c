@@ -16,8 +16,9 @@ void verify_stdatomic(void) {
 
     atomic_uint_least64_t x;
 
-    // TODO(vtl): This doesn't build, possibly because we're not C11.
-    // VERIFY(!atomic_is_lock_free(&x), "atomic_is_lock_free");
+    VERIFY(!atomic_is_lock_free(&x), "atomic_is_lock_free");
+    atomic_uint_least32_t y;
+    VERIFY(atomic_is_lock_free(&y), "atomic_is_lock_free (32-bit)");
 
     atomic_init(&x, 123);
     VERIFY(atomic_load(&x) == 123, "atomic_init, atomic_load");
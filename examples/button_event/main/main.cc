@@ -3,12 +3,15 @@
 
 // Button event example.
 
+#include <assert.h>
 #include <stddef.h>
+#include <stdint.h>
 
 #include <memory>
 
 #include "driver/gpio.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
@@ -21,6 +24,18 @@ namespace {
 
 const char TAG[] = "MAIN";
 
+#ifdef CONFIG_BUTTON_USE_TASK_NOTIFY
+constexpr bool kUseTaskNotify = true;
+#else
+constexpr bool kUseTaskNotify = false;
+#endif
+
+xsp_loop_config_t LoopConfig() {
+    xsp_loop_config_t config = xsp_loop_config_default;
+    config.use_task_notify = kUseTaskNotify;
+    return config;
+}
+
 class ButtonEventExampleApp final : public xsp::LoopEventHandler {
 public:
     explicit ButtonEventExampleApp() {}
@@ -47,6 +62,7 @@ public:
             ESP_ERROR_CHECK(gpio_config(&kGpioConfig));
         });
         assert(success);
+        ESP_LOGI(TAG, "Waking loop using %s", kUseTaskNotify ? "task notifications" : "select()");
         loop_.Run();
     }
 
@@ -59,10 +75,31 @@ private:
         static_cast<ButtonEventExampleApp*>(thiz)->OnButtonIsr();
     }
     void OnButtonIsr() {
-        loop_.PostTask([this]() { ESP_LOGI(TAG, "Button event"); });
+        int64_t isr_time_us = esp_timer_get_time();
+        loop_.PostTask([this, isr_time_us]() { OnButtonEvent(isr_time_us); });
     }
 
-    xsp::Loop loop_{this, 8};
+    void OnButtonEvent(int64_t isr_time_us) {
+        int64_t latency_us = esp_timer_get_time() - isr_time_us;
+        num_events_++;
+        total_latency_us_ += latency_us;
+        if (num_events_ == 1 || latency_us < min_latency_us_)
+            min_latency_us_ = latency_us;
+        if (latency_us > max_latency_us_)
+            max_latency_us_ = latency_us;
+        ESP_LOGI(TAG,
+                 "Button event: ISR-to-callback latency %lld us (min/avg/max %lld/%lld/%lld us)",
+                 latency_us, min_latency_us_, total_latency_us_ / num_events_, max_latency_us_);
+    }
+
+    const xsp_loop_config_t loop_config_ = LoopConfig();
+    xsp::Loop loop_{this, 8, &loop_config_};
+
+    // Latency statistics (only accessed on the loop).
+    int64_t num_events_ = 0;
+    int64_t total_latency_us_ = 0;
+    int64_t min_latency_us_ = 0;
+    int64_t max_latency_us_ = 0;
 };
 
 void button_event_example_task(void* pvParameters) {
@@ -0,0 +1,5 @@
+# Copyright 2019 Tricot Inc.
+# Use of this source code is governed by the license in the LICENSE file.
+
+# Uses default behavior: names component for the directory, builds all source files, and adds
+# include subdirectory to include path.
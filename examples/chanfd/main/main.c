@@ -0,0 +1,147 @@
+// Copyright 2019 Tricot Inc.
+// Use of this source code is governed by the license in the LICENSE file.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/ioctl.h>
+#include <sys/select.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "xsp_chanfd.h"
+
+#define CAPACITY 4096
+#define BLOCK_SIZE 300  // Deliberately not a divisor of CAPACITY, so that blocks wrap around.
+#define NUM_BLOCKS 1000
+
+static int g_fd = -1;
+
+static void do_sleep(int ms) {
+    vTaskDelay((ms + (portTICK_PERIOD_MS - 1)) / portTICK_PERIOD_MS);
+}
+
+// The byte at position `i` in the stream.
+static uint8_t pattern(uint32_t i) {
+    return (uint8_t)(i ^ (i >> 8));
+}
+
+// Producer: writes blocks using (blocking) `write()`.
+static void producer_task(void* pvParameters) {
+    printf("[PRODUCER] Started\n");
+
+    static uint8_t block[BLOCK_SIZE];
+    uint32_t pos = 0;
+    for (int i = 0; i < NUM_BLOCKS; i++) {
+        for (size_t j = 0; j < BLOCK_SIZE; j++)
+            block[j] = pattern(pos + j);
+        ssize_t sz = write(g_fd, block, BLOCK_SIZE);
+        if (sz != BLOCK_SIZE) {
+            printf("[PRODUCER] write: result=%d, errno=%d\n", (int)sz, errno);
+            break;
+        }
+        pos += BLOCK_SIZE;
+    }
+
+    printf("[PRODUCER] Wrote %u bytes\n", (unsigned)pos);
+    printf("[PRODUCER] Terminating\n");
+    vTaskDelete(NULL);
+}
+
+void app_main(void) {
+    printf("[TASK0] Starting\n");
+
+    printf("[TASK0] Registering chanfd ...\n");
+    xsp_chanfd_register();
+
+    printf("[TASK0] Creating fd (nonblocking) ...\n");
+    g_fd = xsp_chanfd(CAPACITY, XSP_CHANFD_NONBLOCK);
+    printf("[TASK0]   fd=%d\n", g_fd);
+
+    printf("[TASK0] Getting handle for fd ...\n");
+    xsp_chanfd_handle_t h = NULL;
+    int result = ioctl(g_fd, XSP_CHANFD_IOCTL_GET_HANDLE, &h);
+    printf("[TASK0]   ioctl: result=%d, handle=%p\n", result, h);
+
+    // Simple checks of nonblocking read()/write().
+    uint8_t buf[8] = {};
+    printf("[TASK0] Reading from fd ...\n");
+    ssize_t sz = read(g_fd, buf, sizeof(buf));
+    // Should fail with EAGAIN.
+    printf("[TASK0]   read: result=%d, errno=%d\n", (int)sz, errno);
+
+    printf("[TASK0] Writing to fd using handle ...\n");
+    size_t n = xsp_chanfd_write(h, "hello", 5);
+    printf("[TASK0]   xsp_chanfd_write: result=%u\n", (unsigned)n);
+
+    printf("[TASK0] Reading from fd ...\n");
+    sz = read(g_fd, buf, sizeof(buf));
+    printf("[TASK0]   read: result=%d, data=%.*s\n", (int)sz, (int)(sz > 0 ? sz : 0), buf);
+
+    // Stream data from a producer task, consuming it without copying (after `select()`ing).
+    printf("[TASK0] Setting fd flags (clear nonblocking) ...\n");
+    result = fcntl(g_fd, F_SETFL, 0);
+    printf("[TASK0]   fcntl: result=0x%x\n", (unsigned)result);
+
+    printf("[TASK0] Creating PRODUCER\n");
+    xTaskCreate(&producer_task, "PRODUCER", 4096, NULL, 5, NULL);
+
+    int64_t start_us = esp_timer_get_time();
+    uint32_t pos = 0;
+    unsigned num_selects = 0;
+    bool ok = true;
+    while (ok && pos < BLOCK_SIZE * NUM_BLOCKS) {
+        fd_set readfds;
+        FD_ZERO(&readfds);
+        FD_SET(g_fd, &readfds);
+        struct timeval timeout = {
+                .tv_sec = 1,
+                .tv_usec = 0,
+        };
+        result = select(g_fd + 1, &readfds, NULL, NULL, &timeout);
+        num_selects++;
+        if (result != 1) {
+            printf("[TASK0]   select: result=%d\n", result);
+            ok = false;
+            break;
+        }
+
+        const void* data;
+        while ((n = xsp_chanfd_acquire_read(h, &data)) > 0) {
+            const uint8_t* bytes = (const uint8_t*)data;
+            for (size_t i = 0; i < n; i++) {
+                if (bytes[i] != pattern(pos + i)) {
+                    printf("[TASK0]   Mismatch at position %u\n", (unsigned)(pos + i));
+                    ok = false;
+                    break;
+                }
+            }
+            xsp_chanfd_release_read(h, n);
+            pos += n;
+        }
+    }
+    int64_t elapsed_us = esp_timer_get_time() - start_us;
+
+    printf("[TASK0] Consumed %u bytes (%s) in %d us using %u selects (%d KB/s)\n", (unsigned)pos,
+           ok ? "OK" : "FAILED", (int)elapsed_us, num_selects,
+           (int)(elapsed_us > 0 ? (int64_t)pos * 1000000 / 1024 / elapsed_us : 0));
+
+    do_sleep(100);
+
+    printf("[TASK0] Closing fd ...\n");
+    result = close(g_fd);
+    printf("[TASK0]   close: result=%d\n", result);
+
+    do_sleep(10000);
+
+    printf("[TASK0] Restarting\n");
+    esp_restart();
+}
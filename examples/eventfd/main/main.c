@@ -20,6 +20,7 @@
 static int g_fd1 = -1;
 static int g_fd2 = -1;
 static int g_fd3 = -1;
+static int g_fd4 = -1;
 
 static void do_sleep(int ms) {
     vTaskDelay((ms + (portTICK_PERIOD_MS - 1)) / portTICK_PERIOD_MS);
@@ -151,6 +152,35 @@ static void task4(void* pvParameters) {
     vTaskDelete(NULL);
 }
 
+static void task5(void* pvParameters) {
+    printf("[TASK5] Started\n");
+
+    xsp_eventfd_handle_t h4 = NULL;
+    int result = ioctl(g_fd4, XSP_EVENTFD_IOCTL_GET_HANDLE, &h4);
+    printf("[TASK5]   ioctl: result=%d, handle=%p\n", result, h4);
+
+    // Signal "sources" 3, 17, and 63 (and 3 again, which should be coalesced).
+    static const unsigned kSources[] = {3, 17, 3, 63};
+    for (size_t i = 0; i < sizeof(kSources) / sizeof(kSources[0]); i++) {
+        uint64_t value = 1ULL << kSources[i];
+        printf("[TASK5] Writing to fd4 using handle (value=0x%llx) ...\n",
+               (unsigned long long)value);
+        bool success = xsp_eventfd_write(h4, value);
+        printf("[TASK5]   xsp_eventfd_write: result=%d\n", (int)success);
+    }
+
+    printf("[TASK5] Terminating\n");
+    vTaskDelete(NULL);
+}
+
+static void dispatch_bits(const char* prefix, uint64_t bits) {
+    while (bits) {
+        unsigned source = (unsigned)__builtin_ctzll(bits);
+        bits &= bits - 1;
+        printf("%ssource %u\n", prefix, source);
+    }
+}
+
 void app_main(void) {
     printf("[TASK0] Starting\n");
 
@@ -388,6 +418,54 @@ void app_main(void) {
     result = close(g_fd3);
     printf("[TASK0]   close: result=%d\n", result);
 
+    printf("[TASK0] Creating fd4 (bitmask) ...\n");
+    g_fd4 = xsp_eventfd(0, XSP_EVENTFD_BITMASK);
+    printf("[TASK0]   fd4=%d\n", g_fd4);
+
+    value = (uint64_t)-1;
+    printf("[TASK0] Writing to fd4 (value=0x%llx) ...\n", (unsigned long long)value);
+    sz = write(g_fd4, &value, sizeof(value));
+    printf("[TASK0]   write: result=%d\n", (int)sz);
+
+    FD_ZERO(&writefds);
+    FD_SET(g_fd4, &writefds);
+    timeout = k100ms;
+    printf("[TASK0] Selecting on fd4 (write) ...\n");
+    result = select(g_fd4 + 1, NULL, &writefds, NULL, &timeout);
+    printf("[TASK0]   select: result=%d\n", result);
+    // Should be writable (even though all bits are set).
+    print_fd_set("[TASK0]     writefds=", &writefds);
+
+    printf("[TASK0] Reading from fd4 ...\n");
+    value = 0;
+    sz = read(g_fd4, &value, sizeof(value));
+    printf("[TASK0]   read: result=%d, value=0x%llx\n", (int)sz, (unsigned long long)value);
+
+    printf("[TASK0] Creating TASK5\n");
+    xTaskCreate(&task5, "TASK5", 8192, NULL, 5, NULL);
+
+    FD_ZERO(&readfds);
+    FD_SET(g_fd4, &readfds);
+    timeout = k500ms;
+    printf("[TASK0] Selecting on fd4 (read) ...\n");
+    result = select(g_fd4 + 1, &readfds, NULL, NULL, &timeout);
+    printf("[TASK0]   select: result=%d\n", result);
+    // Should be readable.
+    print_fd_set("[TASK0]     readfds=", &readfds);
+
+    do_sleep(100);
+
+    printf("[TASK0] Reading from fd4 ...\n");
+    value = 0;
+    sz = read(g_fd4, &value, sizeof(value));
+    printf("[TASK0]   read: result=%d, value=0x%llx\n", (int)sz, (unsigned long long)value);
+    // Should be sources 3, 17, and 63.
+    dispatch_bits("[TASK0]     ", value);
+
+    printf("[TASK0] Closing fd4 ...\n");
+    result = close(g_fd4);
+    printf("[TASK0]   close: result=%d\n", result);
+
     do_sleep(10000);
 
     printf("[TASK0] Restarting\n");
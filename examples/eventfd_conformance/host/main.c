@@ -0,0 +1,63 @@
+// Copyright 2019 Tricot Inc.
+// Use of this source code is governed by the license in the LICENSE file.
+
+// Host (Linux) driver for the xsp_eventfd conformance checks and benchmarks; see Makefile.
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "xsp_eventfd.h"
+
+#include "eventfd_conformance.h"
+
+typedef struct spawn_args {
+    void (*fn)(void*);
+    void* arg;
+} spawn_args_t;
+
+static void* spawned_thread(void* arg) {
+    spawn_args_t args = *(spawn_args_t*)arg;
+    free(arg);
+    args.fn(args.arg);
+    return NULL;
+}
+
+void eventfd_conformance_spawn(void (*fn)(void*), void* arg) {
+    spawn_args_t* args = (spawn_args_t*)malloc(sizeof(spawn_args_t));
+    args->fn = fn;
+    args->arg = arg;
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, &spawned_thread, args) != 0)
+        abort();
+    pthread_detach(thread);
+}
+
+void eventfd_conformance_sleep_ms(int ms) {
+    struct timespec ts = {
+            .tv_sec = ms / 1000,
+            .tv_nsec = (long)(ms % 1000) * 1000000,
+    };
+    nanosleep(&ts, NULL);
+}
+
+int64_t eventfd_conformance_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+int main(int argc, char** argv) {
+    int iterations = (argc > 1) ? atoi(argv[1]) : 0;
+
+    xsp_eventfd_register();
+
+    int failures = eventfd_conformance_run();
+    if (iterations > 0)
+        eventfd_bench_wake_latency(iterations);
+    printf("DONE\n");
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,386 @@
+// Copyright 2019 Tricot Inc.
+// Use of this source code is governed by the license in the LICENSE file.
+
+#include "eventfd_conformance.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/ioctl.h>
+#include <sys/select.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "xsp_eventfd.h"
+
+static int g_failures = 0;
+
+#define VERIFY(cond, text)                                    \
+    do {                                                      \
+        bool ok_ = !!(cond);                                  \
+        printf("  [%s] %s\n", ok_ ? "pass" : "FAIL", (text)); \
+        if (!ok_)                                             \
+            g_failures++;                                     \
+    } while (0)
+
+static const uint64_t kMaxValue = (uint64_t)-2;
+
+static ssize_t read_value(int fd, uint64_t* value) {
+    return read(fd, value, sizeof(*value));
+}
+
+static ssize_t write_value(int fd, uint64_t value) {
+    return write(fd, &value, sizeof(value));
+}
+
+// Selects (with the given timeout) and returns the result; `*readable`/`*writable` are set
+// according to the returned FD sets.
+static int select_fd(int fd, int timeout_ms, bool* readable, bool* writable) {
+    fd_set readfds;
+    fd_set writefds;
+    FD_ZERO(&readfds);
+    FD_SET(fd, &readfds);
+    FD_ZERO(&writefds);
+    FD_SET(fd, &writefds);
+    struct timeval timeout = {
+            .tv_sec = timeout_ms / 1000,
+            .tv_usec = (timeout_ms % 1000) * 1000,
+    };
+    int rv = select(fd + 1, &readfds, writable ? &writefds : NULL, NULL, &timeout);
+    *readable = rv > 0 && FD_ISSET(fd, &readfds);
+    if (writable)
+        *writable = rv > 0 && FD_ISSET(fd, &writefds);
+    return rv;
+}
+
+typedef struct delayed_write_args {
+    int fd;
+    xsp_eventfd_handle_t handle;  // If non-null, writes using the handle instead of `write()`.
+    int delay_ms;
+    uint64_t value;
+} delayed_write_args_t;
+
+static void delayed_write(void* arg) {
+    const delayed_write_args_t* args = (const delayed_write_args_t*)arg;
+    eventfd_conformance_sleep_ms(args->delay_ms);
+    if (args->handle)
+        xsp_eventfd_write(args->handle, args->value);
+    else
+        write_value(args->fd, args->value);
+}
+
+static void check_read_write(void) {
+    printf("read()/write():\n");
+
+    int fd = xsp_eventfd(5, XSP_EVENTFD_NONBLOCK);
+    VERIFY(fd >= 0, "xsp_eventfd");
+
+    uint64_t value = 0;
+    VERIFY(read_value(fd, &value) == 8 && value == 5, "read initial value");
+    errno = 0;
+    VERIFY(read_value(fd, &value) == -1 && errno == EAGAIN, "read when zero (nonblocking)");
+
+    VERIFY(write_value(fd, 3) == 8, "write");
+    VERIFY(write_value(fd, 4) == 8, "write");
+    VERIFY(read_value(fd, &value) == 8 && value == 7, "read sum");
+
+    errno = 0;
+    VERIFY(write_value(fd, (uint64_t)-1) == -1 && errno == EINVAL, "write 0xff..ff");
+    errno = 0;
+    VERIFY(write(fd, &value, 4) == -1 && errno == EINVAL, "write short count");
+    errno = 0;
+    VERIFY(read(fd, &value, 4) == -1 && errno == EINVAL, "read short count");
+
+    VERIFY(write_value(fd, kMaxValue) == 8, "write max value");
+    errno = 0;
+    VERIFY(write_value(fd, 1) == -1 && errno == EAGAIN, "write overflow (nonblocking)");
+    VERIFY(read_value(fd, &value) == 8 && value == kMaxValue, "read max value");
+
+    VERIFY(close(fd) == 0, "close");
+}
+
+static void check_fcntl(void) {
+    printf("fcntl():\n");
+
+    int fd = xsp_eventfd(0, 0);
+    VERIFY(fd >= 0, "xsp_eventfd");
+
+    VERIFY(!(fcntl(fd, F_GETFL) & O_NONBLOCK), "F_GETFL (blocking)");
+    VERIFY(fcntl(fd, F_SETFL, O_NONBLOCK) == 0, "F_SETFL O_NONBLOCK");
+    VERIFY(!!(fcntl(fd, F_GETFL) & O_NONBLOCK), "F_GETFL (nonblocking)");
+    uint64_t value = 0;
+    errno = 0;
+    VERIFY(read_value(fd, &value) == -1 && errno == EAGAIN, "read when zero (nonblocking)");
+
+    VERIFY(close(fd) == 0, "close");
+}
+
+static void check_select(void) {
+    printf("select():\n");
+
+    int fd = xsp_eventfd(0, XSP_EVENTFD_NONBLOCK);
+    VERIFY(fd >= 0, "xsp_eventfd");
+
+    bool readable = false;
+    bool writable = false;
+    VERIFY(select_fd(fd, 0, &readable, &writable) == 1 && !readable && writable,
+           "select when zero: writable only");
+
+    write_value(fd, 1);
+    VERIFY(select_fd(fd, 0, &readable, &writable) == 2 && readable && writable,
+           "select when nonzero: readable and writable");
+
+    write_value(fd, kMaxValue - 1);
+    VERIFY(select_fd(fd, 0, &readable, &writable) == 1 && readable && !writable,
+           "select when max: readable only");
+
+    VERIFY(close(fd) == 0, "close");
+}
+
+static void check_handle(void) {
+    printf("Handles:\n");
+
+    int fd = xsp_eventfd(0, XSP_EVENTFD_NONBLOCK);
+    VERIFY(fd >= 0, "xsp_eventfd");
+
+    xsp_eventfd_handle_t h = NULL;
+    VERIFY(ioctl(fd, XSP_EVENTFD_IOCTL_GET_HANDLE, &h) == 0 && h, "XSP_EVENTFD_IOCTL_GET_HANDLE");
+
+    VERIFY(!xsp_eventfd_can_read(h), "xsp_eventfd_can_read when zero");
+    VERIFY(xsp_eventfd_write(h, 10), "xsp_eventfd_write");
+    VERIFY(xsp_eventfd_can_read(h), "xsp_eventfd_can_read when nonzero");
+    uint64_t value = 0;
+    VERIFY(read_value(fd, &value) == 8 && value == 10, "read");
+
+    write_value(fd, kMaxValue);
+    VERIFY(!xsp_eventfd_write(h, 1), "xsp_eventfd_write overflow");
+    VERIFY(read_value(fd, &value) == 8 && value == kMaxValue, "read max value");
+
+    VERIFY(close(fd) == 0, "close");
+
+    // `xsp_eventfd_write()` never blocks, even if the FD is in blocking mode.
+    fd = xsp_eventfd(0, 0);
+    VERIFY(fd >= 0, "xsp_eventfd (blocking)");
+    h = NULL;
+    VERIFY(ioctl(fd, XSP_EVENTFD_IOCTL_GET_HANDLE, &h) == 0 && h, "XSP_EVENTFD_IOCTL_GET_HANDLE");
+    write_value(fd, kMaxValue);
+    VERIFY(!xsp_eventfd_write(h, 1), "xsp_eventfd_write overflow (blocking): fails");
+    VERIFY(read_value(fd, &value) == 8 && value == kMaxValue, "read max value");
+
+    VERIFY(close(fd) == 0, "close");
+}
+
+static void check_bitmask(void) {
+    printf("Bitmask mode:\n");
+
+    int fd = xsp_eventfd(3, XSP_EVENTFD_BITMASK | XSP_EVENTFD_NONBLOCK);
+    VERIFY(fd >= 0, "xsp_eventfd");
+
+    uint64_t value = 0;
+    VERIFY(read_value(fd, &value) == 8 && value == 3, "read initial value");
+    errno = 0;
+    VERIFY(read_value(fd, &value) == -1 && errno == EAGAIN, "read when zero (nonblocking)");
+
+    VERIFY(write_value(fd, 1) == 8, "write");
+    VERIFY(write_value(fd, 4) == 8, "write");
+    VERIFY(write_value(fd, 1) == 8, "write");
+    VERIFY(read_value(fd, &value) == 8 && value == 5, "read bitwise-OR");
+
+    VERIFY(write_value(fd, (uint64_t)-1) == 8, "write 0xff..ff");
+    VERIFY(write_value(fd, 1) == 8, "write when all bits set");
+    bool readable = false;
+    bool writable = false;
+    VERIFY(select_fd(fd, 0, &readable, &writable) == 2 && readable && writable,
+           "select when all bits set: readable and writable");
+    VERIFY(read_value(fd, &value) == 8 && value == (uint64_t)-1, "read all bits");
+    VERIFY(select_fd(fd, 0, &readable, &writable) == 1 && !readable && writable,
+           "select when zero: writable only");
+
+    xsp_eventfd_handle_t h = NULL;
+    VERIFY(ioctl(fd, XSP_EVENTFD_IOCTL_GET_HANDLE, &h) == 0 && h, "XSP_EVENTFD_IOCTL_GET_HANDLE");
+    VERIFY(!xsp_eventfd_can_read(h), "xsp_eventfd_can_read when zero");
+    VERIFY(xsp_eventfd_write(h, (uint64_t)1 << 63), "xsp_eventfd_write");
+    VERIFY(xsp_eventfd_write(h, (uint64_t)-1), "xsp_eventfd_write 0xff..ff");
+    VERIFY(xsp_eventfd_can_read(h), "xsp_eventfd_can_read when nonzero");
+    VERIFY(read_value(fd, &value) == 8 && value == (uint64_t)-1, "read");
+
+    VERIFY(close(fd) == 0, "close");
+
+    fd = xsp_eventfd(0, XSP_EVENTFD_BITMASK);
+    VERIFY(fd >= 0, "xsp_eventfd (blocking)");
+    h = NULL;
+    ioctl(fd, XSP_EVENTFD_IOCTL_GET_HANDLE, &h);
+
+    static delayed_write_args_t args;
+    args.fd = fd;
+    args.handle = h;
+    args.delay_ms = 50;
+    args.value = 0x10;
+    int64_t start_us = eventfd_conformance_now_us();
+    eventfd_conformance_spawn(&delayed_write, &args);
+    VERIFY(read_value(fd, &value) == 8 && value == 0x10,
+           "blocking read woken by xsp_eventfd_write");
+    VERIFY(eventfd_conformance_now_us() - start_us >= 40 * 1000, "blocking read blocked");
+
+    // Make sure the writer is done before closing.
+    eventfd_conformance_sleep_ms(10);
+    VERIFY(close(fd) == 0, "close");
+}
+
+static void check_wake(void) {
+    printf("Waking:\n");
+
+    int fd = xsp_eventfd(0, 0);
+    VERIFY(fd >= 0, "xsp_eventfd");
+
+    static delayed_write_args_t args;
+    args.fd = fd;
+    args.handle = NULL;
+    args.delay_ms = 50;
+    args.value = 42;
+    int64_t start_us = eventfd_conformance_now_us();
+    eventfd_conformance_spawn(&delayed_write, &args);
+    uint64_t value = 0;
+    VERIFY(read_value(fd, &value) == 8 && value == 42, "blocking read woken by write");
+    VERIFY(eventfd_conformance_now_us() - start_us >= 40 * 1000, "blocking read blocked");
+
+    xsp_eventfd_handle_t h = NULL;
+    ioctl(fd, XSP_EVENTFD_IOCTL_GET_HANDLE, &h);
+    args.handle = h;
+    args.value = 43;
+    eventfd_conformance_spawn(&delayed_write, &args);
+    bool readable = false;
+    VERIFY(select_fd(fd, 1000, &readable, NULL) == 1 && readable,
+           "select woken by xsp_eventfd_write");
+    VERIFY(read_value(fd, &value) == 8 && value == 43, "read");
+
+    // Make sure the writer is done before closing.
+    eventfd_conformance_sleep_ms(10);
+    VERIFY(close(fd) == 0, "close");
+}
+
+#ifndef XSP_EVENTFD_HOST
+static void check_notify_task(void) {
+    printf("Notify task:\n");
+
+    int fd = xsp_eventfd(0, XSP_EVENTFD_NONBLOCK);
+    VERIFY(fd >= 0, "xsp_eventfd");
+    xsp_eventfd_handle_t h = NULL;
+    VERIFY(ioctl(fd, XSP_EVENTFD_IOCTL_GET_HANDLE, &h) == 0 && h, "XSP_EVENTFD_IOCTL_GET_HANDLE");
+
+    // Clear any stale notification.
+    ulTaskNotifyTake(pdTRUE, 0);
+    xsp_eventfd_set_notify_task(h, xTaskGetCurrentTaskHandle());
+
+    static delayed_write_args_t args;
+    args.fd = fd;
+    args.handle = h;
+    args.delay_ms = 50;
+    args.value = 1;
+    eventfd_conformance_spawn(&delayed_write, &args);
+    VERIFY(ulTaskNotifyTake(pdTRUE, 1000 / portTICK_PERIOD_MS) > 0 && xsp_eventfd_can_read(h),
+           "notified by xsp_eventfd_write");
+    uint64_t value = 0;
+    VERIFY(read_value(fd, &value) == 8 && value == 1, "read");
+    VERIFY(ulTaskNotifyTake(pdTRUE, 0) == 0, "not notified by read");
+
+    write_value(fd, 2);
+    VERIFY(ulTaskNotifyTake(pdTRUE, 0) > 0, "notified by write");
+    VERIFY(read_value(fd, &value) == 8 && value == 2, "read");
+
+    xsp_eventfd_set_notify_task(h, NULL);
+    xsp_eventfd_write(h, 3);
+    VERIFY(ulTaskNotifyTake(pdTRUE, 0) == 0, "not notified after clearing the notify task");
+
+    VERIFY(close(fd) == 0, "close");
+}
+#endif
+
+int eventfd_conformance_run(void) {
+    g_failures = 0;
+    check_read_write();
+    check_fcntl();
+    check_select();
+    check_handle();
+    check_bitmask();
+    check_wake();
+#ifndef XSP_EVENTFD_HOST
+    // The host implementation doesn't support notify tasks.
+    check_notify_task();
+#endif
+    printf("%d failure(s)\n", g_failures);
+    return g_failures;
+}
+
+typedef struct waker_args {
+    xsp_eventfd_handle_t handle;
+    int iterations;
+    int64_t write_time_us;  // Accessed atomically.
+} waker_args_t;
+
+static void waker(void* arg) {
+    waker_args_t* args = (waker_args_t*)arg;
+    for (int i = 0; i < args->iterations; i++) {
+        // Give the other side time to get back into select().
+        eventfd_conformance_sleep_ms(2);
+        __atomic_store_n(&args->write_time_us, eventfd_conformance_now_us(), __ATOMIC_RELEASE);
+        xsp_eventfd_write(args->handle, 1);
+    }
+}
+
+static int compare_int32(const void* a, const void* b) {
+    int32_t x = *(const int32_t*)a;
+    int32_t y = *(const int32_t*)b;
+    return (x > y) - (x < y);
+}
+
+void eventfd_bench_wake_latency(int iterations) {
+    printf("Write-to-select wake latency (%d iterations):\n", iterations);
+
+    int32_t* latencies_us = (int32_t*)malloc(sizeof(int32_t) * (size_t)iterations);
+    int fd = xsp_eventfd(0, XSP_EVENTFD_NONBLOCK);
+    if (!latencies_us || fd < 0) {
+        printf("  [FAIL] setup\n");
+        free(latencies_us);
+        return;
+    }
+
+    static waker_args_t args;
+    ioctl(fd, XSP_EVENTFD_IOCTL_GET_HANDLE, &args.handle);
+    args.iterations = iterations;
+    args.write_time_us = 0;
+    eventfd_conformance_spawn(&waker, &args);
+
+    int n = 0;
+    for (; n < iterations; n++) {
+        bool readable = false;
+        if (select_fd(fd, 1000, &readable, NULL) != 1 || !readable)
+            break;
+        int64_t now_us = eventfd_conformance_now_us();
+        latencies_us[n] =
+                (int32_t)(now_us - __atomic_load_n(&args.write_time_us, __ATOMIC_ACQUIRE));
+        uint64_t value;
+        read_value(fd, &value);
+    }
+
+    if (n < iterations) {
+        printf("  [FAIL] select timed out after %d iterations\n", n);
+    } else {
+        qsort(latencies_us, (size_t)n, sizeof(int32_t), &compare_int32);
+        int64_t total_us = 0;
+        for (int i = 0; i < n; i++)
+            total_us += latencies_us[i];
+        printf("  min/p50/p99/max/avg: %d/%d/%d/%d/%d us\n", (int)latencies_us[0],
+               (int)latencies_us[n / 2], (int)latencies_us[(n * 99) / 100],
+               (int)latencies_us[n - 1], (int)(total_us / n));
+    }
+
+    // Make sure the waker is done before closing.
+    eventfd_conformance_sleep_ms(10);
+    close(fd);
+    free(latencies_us);
+}
@@ -0,0 +1,34 @@
+// Copyright 2019 Tricot Inc.
+// Use of this source code is governed by the license in the LICENSE file.
+
+// Conformance checks and benchmarks for the xsp_eventfd.h API, shared by the device (ESP32) app and
+// the host (Linux) build (see ../host/).
+
+#ifndef EVENTFD_CONFORMANCE_H_
+#define EVENTFD_CONFORMANCE_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Platform hooks, implemented by the app.
+
+// Runs `fn(arg)` on a new task/thread (at the same priority as the caller).
+void eventfd_conformance_spawn(void (*fn)(void*), void* arg);
+void eventfd_conformance_sleep_ms(int ms);
+int64_t eventfd_conformance_now_us(void);
+
+// Runs the conformance checks (xsp_eventfd_register() must have been called). Returns the number of
+// failures.
+int eventfd_conformance_run(void);
+
+// Measures the latency from `xsp_eventfd_write()` (on another task/thread) to `select()` returning.
+void eventfd_bench_wake_latency(int iterations);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // EVENTFD_CONFORMANCE_H_
@@ -0,0 +1,55 @@
+// Copyright 2019 Tricot Inc.
+// Use of this source code is governed by the license in the LICENSE file.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "xsp_eventfd.h"
+
+#include "eventfd_conformance.h"
+
+#define BENCH_ITERATIONS 1000
+
+typedef struct spawn_args {
+    void (*fn)(void*);
+    void* arg;
+} spawn_args_t;
+
+static void spawned_task(void* pvParameters) {
+    spawn_args_t args = *(spawn_args_t*)pvParameters;
+    free(pvParameters);
+    args.fn(args.arg);
+    vTaskDelete(NULL);
+}
+
+void eventfd_conformance_spawn(void (*fn)(void*), void* arg) {
+    spawn_args_t* args = (spawn_args_t*)malloc(sizeof(spawn_args_t));
+    args->fn = fn;
+    args->arg = arg;
+    xTaskCreate(&spawned_task, "SPAWNED", 4096, args, uxTaskPriorityGet(NULL), NULL);
+}
+
+void eventfd_conformance_sleep_ms(int ms) {
+    vTaskDelay((ms + (portTICK_PERIOD_MS - 1)) / portTICK_PERIOD_MS);
+}
+
+int64_t eventfd_conformance_now_us(void) {
+    return esp_timer_get_time();
+}
+
+void app_main(void) {
+    xsp_eventfd_register();
+
+    eventfd_conformance_run();
+    eventfd_bench_wake_latency(BENCH_ITERATIONS);
+    printf("DONE\n");
+
+    vTaskDelay(10000 / portTICK_PERIOD_MS);
+    esp_restart();
+}
@@ -0,0 +1,139 @@
+// Copyright 2019 Tricot Inc.
+// Use of this source code is governed by the license in the LICENSE file.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/select.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "xsp_timerfd.h"
+
+static void do_sleep(int ms) {
+    vTaskDelay((ms + (portTICK_PERIOD_MS - 1)) / portTICK_PERIOD_MS);
+}
+
+static int64_t elapsed_us(int64_t start_us) {
+    return esp_timer_get_time() - start_us;
+}
+
+static void set_timer(int fd, long value_ms, long interval_ms) {
+    xsp_timerfd_itimerspec_t its = {
+            .it_interval = {.tv_sec = interval_ms / 1000,
+                            .tv_nsec = (interval_ms % 1000) * 1000000},
+            .it_value = {.tv_sec = value_ms / 1000, .tv_nsec = (value_ms % 1000) * 1000000},
+    };
+    printf("[TASK0] Setting timer (value=%ldms, interval=%ldms) ...\n", value_ms, interval_ms);
+    int result = xsp_timerfd_settime(fd, 0, &its, NULL);
+    printf("[TASK0]   xsp_timerfd_settime: result=%d\n", result);
+}
+
+static void read_timer(int fd, int64_t start_us) {
+    printf("[TASK0] Reading from fd ...\n");
+    uint64_t value = (uint64_t)-1;
+    ssize_t sz = read(fd, &value, sizeof(value));
+    printf("[TASK0]   read: result=%d, value=%llu, errno=%d, elapsed=%lldus\n", (int)sz,
+           (unsigned long long)value, errno, elapsed_us(start_us));
+}
+
+void app_main(void) {
+    printf("[TASK0] Starting\n");
+
+    printf("[TASK0] Registering timerfd ...\n");
+    xsp_timerfd_register();
+
+    printf("[TASK0] Creating fd ...\n");
+    int fd = xsp_timerfd_create(0);
+    printf("[TASK0]   fd=%d\n", fd);
+
+    // One-shot: should read 1 after ~250ms.
+    int64_t start_us = esp_timer_get_time();
+    set_timer(fd, 250, 0);
+    read_timer(fd, start_us);
+
+    xsp_timerfd_itimerspec_t its;
+    printf("[TASK0] Getting timer ...\n");
+    int result = xsp_timerfd_gettime(fd, &its);
+    // Should be disarmed (all zero).
+    printf("[TASK0]   xsp_timerfd_gettime: result=%d, value=%ld.%09lds, interval=%ld.%09lds\n",
+           result, (long)its.it_value.tv_sec, its.it_value.tv_nsec, (long)its.it_interval.tv_sec,
+           its.it_interval.tv_nsec);
+
+    // Periodic: should read 5 after sleeping for ~550ms.
+    start_us = esp_timer_get_time();
+    set_timer(fd, 100, 100);
+    do_sleep(550);
+    read_timer(fd, start_us);
+
+    printf("[TASK0] Getting timer ...\n");
+    result = xsp_timerfd_gettime(fd, &its);
+    // Should have a value of at most 100ms, and an interval of 100ms.
+    printf("[TASK0]   xsp_timerfd_gettime: result=%d, value=%ld.%09lds, interval=%ld.%09lds\n",
+           result, (long)its.it_value.tv_sec, its.it_value.tv_nsec, (long)its.it_interval.tv_sec,
+           its.it_interval.tv_nsec);
+
+    // Absolute time: should read 1 after ~200ms.
+    start_us = esp_timer_get_time();
+    int64_t deadline_us = start_us + 200 * 1000;
+    its.it_interval.tv_sec = 0;
+    its.it_interval.tv_nsec = 0;
+    its.it_value.tv_sec = (time_t)(deadline_us / 1000000);
+    its.it_value.tv_nsec = (long)(deadline_us % 1000000) * 1000;
+    printf("[TASK0] Setting timer (absolute, in 200ms) ...\n");
+    result = xsp_timerfd_settime(fd, XSP_TIMERFD_TIMER_ABSTIME, &its, NULL);
+    printf("[TASK0]   xsp_timerfd_settime: result=%d\n", result);
+    read_timer(fd, start_us);
+
+    // Periodic again, for select().
+    set_timer(fd, 100, 100);
+
+    // Using select(): should be readable (after ~100ms) before the 500ms timeout.
+    fd_set readfds;
+    FD_ZERO(&readfds);
+    FD_SET(fd, &readfds);
+    struct timeval timeout = {
+            .tv_sec = 0,
+            .tv_usec = 500 * 1000,
+    };
+    start_us = esp_timer_get_time();
+    printf("[TASK0] Selecting on fd (read) ...\n");
+    result = select(fd + 1, &readfds, NULL, NULL, &timeout);
+    printf("[TASK0]   select: result=%d, readable=%d, elapsed=%lldus\n", result,
+           !!FD_ISSET(fd, &readfds), elapsed_us(start_us));
+    read_timer(fd, start_us);
+
+    // Disarm, then a nonblocking read should fail with EAGAIN.
+    set_timer(fd, 0, 0);
+
+    printf("[TASK0] Setting fd flags (set nonblocking) ...\n");
+    result = fcntl(fd, F_SETFL, O_NONBLOCK);
+    printf("[TASK0]   fcntl: result=0x%x\n", (unsigned)result);
+
+    start_us = esp_timer_get_time();
+    read_timer(fd, start_us);
+
+    // Should time out.
+    FD_ZERO(&readfds);
+    FD_SET(fd, &readfds);
+    timeout.tv_usec = 100 * 1000;
+    printf("[TASK0] Selecting on fd (read) ...\n");
+    result = select(fd + 1, &readfds, NULL, NULL, &timeout);
+    printf("[TASK0]   select: result=%d\n", result);
+
+    printf("[TASK0] Closing fd ...\n");
+    result = close(fd);
+    printf("[TASK0]   close: result=%d\n", result);
+
+    do_sleep(10000);
+
+    printf("[TASK0] Restarting\n");
+    esp_restart();
+}
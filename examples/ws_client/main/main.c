@@ -12,7 +12,9 @@
 #include "freertos/task.h"
 #include "nvs_flash.h"
 
+#include "xsp_eventfd.h"
 #include "xsp_loop.h"
+#include "xsp_timerfd.h"
 #include "xsp_ws_client.h"
 #include "xsp_ws_client_defrag.h"
 #include "xsp_ws_client_handler.h"
@@ -172,6 +174,15 @@ static void on_ws_client_message_sent(xsp_ws_client_handler_handle_t handler,
     ctx->sent++;
 }
 
+static void on_ws_client_connection_state_changed(xsp_ws_client_handler_handle_t handler,
+                                                  void* raw_ctx,
+                                                  xsp_ws_client_handler_connection_state_t state,
+                                                  int status) {
+    ESP_LOGI(TAG, "Event: connection state changed");
+
+    ESP_LOGI(TAG, "  state=%d, status=%d", (int)state, status);
+}
+
 static void ws_client_example_task(void* pvParameters) {
     app_wifi_wait_connected();
     ESP_LOGI(TAG, "WiFi connected");
@@ -187,7 +198,11 @@ static void ws_client_example_task(void* pvParameters) {
     xsp_ws_client_event_handler_t client_evt_handler = {
             &on_ws_client_closed,        &on_ws_client_data_frame_received,
             &on_ws_client_ping_received, &on_ws_client_pong_received,
-            &on_ws_client_message_sent,  &ctx};
+            &on_ws_client_message_sent,  NULL,
+            &on_ws_client_connection_state_changed,
+            &ctx};
+    xsp_ws_client_handler_config_t client_handler_config = xsp_ws_client_handler_config_default;
+    client_handler_config.reconnect_base_delay_ms = CONFIG_MAIN_RECONNECT_BASE_DELAY_MS;
     static const char kUrl[] = CONFIG_MAIN_URL;
     static const char kSubprotocols[] = CONFIG_MAIN_SUBPROTOCOLS;
     bool have_subprotocols = strlen(kSubprotocols) > 0;
@@ -231,7 +246,8 @@ static void ws_client_example_task(void* pvParameters) {
         goto done;
     }
 
-    ctx.client_handler = xsp_ws_client_handler_init(NULL, &client_evt_handler, client, loop);
+    ctx.client_handler =
+            xsp_ws_client_handler_init(&client_handler_config, &client_evt_handler, client, loop);
     if (!ctx.client_handler) {
         ESP_LOGE(TAG, "Failed to initialize client handler");
         goto done;
@@ -292,5 +308,9 @@ void app_main(void) {
 
     app_wifi_initialise();
 
+    // These are needed for automatic reconnection.
+    xsp_eventfd_register();
+    xsp_timerfd_register();
+
     xTaskCreate(&ws_client_example_task, "ws_client_example_task", 8192, NULL, 5, NULL);
 }
@@ -0,0 +1,72 @@
+// Copyright 2019 Tricot Inc.
+// Use of this source code is governed by the license in the LICENSE file.
+
+#include "bench_latency.h"
+
+#include <string.h>
+#include <unistd.h>
+
+#include "esp_timer.h"
+
+#include "xsp_timerfd.h"
+
+void bench_latency_update(bench_latency_t* latency) {
+    int64_t now_us = esp_timer_get_time();
+    if (latency->measuring && now_us - latency->last_tick_us > latency->max_tick_gap_us)
+        latency->max_tick_gap_us = now_us - latency->last_tick_us;
+    latency->last_tick_us = now_us;
+}
+
+static void on_loop_can_read_timer_fd(xsp_loop_handle_t loop, void* ctx, int fd) {
+    bench_latency_t* latency = (bench_latency_t*)ctx;
+
+    uint64_t unused;
+    read(fd, &unused, sizeof(unused));
+
+    bench_latency_update(latency);
+    if (latency->on_tick)
+        latency->on_tick(loop, latency->ctx, latency->last_tick_us);
+}
+
+bool bench_latency_start(bench_latency_t* latency,
+                         xsp_loop_handle_t loop,
+                         bench_latency_on_tick_func_t on_tick,
+                         void* ctx) {
+    memset(latency, 0, sizeof(*latency));
+    latency->loop = loop;
+    latency->on_tick = on_tick;
+    latency->ctx = ctx;
+    latency->timer_fd = xsp_timerfd_create(XSP_TIMERFD_NONBLOCK);
+    if (latency->timer_fd == -1)
+        return false;
+
+    xsp_loop_fd_event_handler_t fd_evt_handler = {
+            NULL, NULL, &on_loop_can_read_timer_fd, latency, latency->timer_fd,
+    };
+    latency->fd_watcher = xsp_loop_add_fd_watcher(loop, &fd_evt_handler);
+    if (!latency->fd_watcher)
+        return false;
+
+    xsp_timerfd_itimerspec_t its = {
+            .it_interval = {.tv_sec = 0, .tv_nsec = BENCH_LATENCY_TICK_MS * 1000000},
+            .it_value = {.tv_sec = 0, .tv_nsec = BENCH_LATENCY_TICK_MS * 1000000},
+    };
+    if (xsp_timerfd_settime(latency->timer_fd, 0, &its, NULL) != 0)
+        return false;
+
+    latency->last_tick_us = esp_timer_get_time();
+    return true;
+}
+
+void bench_latency_stop(bench_latency_t* latency) {
+    if (!latency->loop)
+        return;  // Never started.
+    if (latency->fd_watcher) {
+        xsp_loop_remove_fd_watcher(latency->loop, latency->fd_watcher);
+        latency->fd_watcher = NULL;
+    }
+    if (latency->timer_fd != -1) {
+        close(latency->timer_fd);
+        latency->timer_fd = -1;
+    }
+}
@@ -0,0 +1,58 @@
+// Copyright 2019 Tricot Inc.
+// Use of this source code is governed by the license in the LICENSE file.
+
+#ifndef BENCH_LATENCY_H_
+#define BENCH_LATENCY_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "xsp_loop.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The timer FD ticks every this often.
+#define BENCH_LATENCY_TICK_MS 10
+// The loop's iteration latency (i.e., the maximum time between ticks) must stay below this while
+// doing nonblocking work on the loop.
+#define BENCH_LATENCY_MAX_MS 100
+
+// Called on each tick (after the latency has been measured), with the current time.
+typedef void (*bench_latency_on_tick_func_t)(xsp_loop_handle_t loop, void* ctx, int64_t now_us);
+
+// Loop latency probe: a timer FD that ticks (every BENCH_LATENCY_TICK_MS) on a loop, measuring the
+// maximum time between ticks while `measuring` is set.
+typedef struct bench_latency {
+    xsp_loop_handle_t loop;
+    bench_latency_on_tick_func_t on_tick;
+    void* ctx;
+    int timer_fd;
+    xsp_loop_fd_watcher_handle_t fd_watcher;
+
+    bool measuring;
+    int64_t last_tick_us;
+    int64_t max_tick_gap_us;
+} bench_latency_t;
+
+// Starts the probe on `loop` (which must not be running), calling `on_tick` (if non-null) on each
+// tick. Returns false on failure; either way, `bench_latency_stop()` must be called (before the
+// loop is cleaned up).
+bool bench_latency_start(bench_latency_t* latency,
+                         xsp_loop_handle_t loop,
+                         bench_latency_on_tick_func_t on_tick,
+                         void* ctx);
+
+// Measures the time since the last tick (if measuring), as if a tick happened now. E.g., this can
+// be used to account for time spent blocked on the loop (when there are no ticks).
+void bench_latency_update(bench_latency_t* latency);
+
+// Stops the probe (if started; a zero-initialized probe may also be stopped).
+void bench_latency_stop(bench_latency_t* latency);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // BENCH_LATENCY_H_
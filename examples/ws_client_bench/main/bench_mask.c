@@ -0,0 +1,115 @@
+// Copyright 2019 Tricot Inc.
+// Use of this source code is governed by the license in the LICENSE file.
+
+#include "bench_mask.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_timer.h"
+
+#include "xsp_ws_client_mask.h"
+
+#define VERIFY(cond, text) printf("  [%s] %s\n", (cond) ? "pass" : "FAIL", (text))
+
+// Payloads larger than this are masked in pieces (like `xsp_ws_client_write_frame()` does).
+#define BUF_SIZE (16 * 1024)
+// Each size is masked repeatedly, for (at least) this many bytes in total.
+#define TOTAL_BYTES (1024 * 1024)
+
+static const unsigned char kMaskingKey[4] = {0x12, 0x34, 0x56, 0x78};
+
+// Extra bytes, to test (and benchmark) unaligned buffers.
+static unsigned char g_src[BUF_SIZE + 8] __attribute__((aligned(8)));
+static unsigned char g_dst[BUF_SIZE + 8] __attribute__((aligned(8)));
+static unsigned char g_expected[BUF_SIZE];
+
+typedef void (*mask_func_t)(const unsigned char masking_key[4],
+                            int key_offset,
+                            int size,
+                            const void* src,
+                            void* dst);
+
+// The simple byte-at-a-time loop.
+static void mask_bytewise(const unsigned char masking_key[4],
+                          int key_offset,
+                          int size,
+                          const void* src,
+                          void* dst) {
+    const unsigned char* s = (const unsigned char*)src;
+    unsigned char* d = (unsigned char*)dst;
+    for (int i = 0; i < size; i++)
+        d[i] = s[i] ^ masking_key[(key_offset + i) % 4];
+}
+
+static bool check(int key_offset, int size, int src_offset, int dst_offset) {
+    mask_bytewise(kMaskingKey, key_offset, size, g_src + src_offset, g_expected);
+    memset(g_dst, 0xaa, sizeof(g_dst));
+    xsp_ws_mask(kMaskingKey, key_offset, size, g_src + src_offset, g_dst + dst_offset);
+    if (memcmp(g_dst + dst_offset, g_expected, (size_t)size) != 0)
+        return false;
+    // Make sure that nothing outside the destination was touched.
+    for (int i = 0; i < (int)sizeof(g_dst); i++) {
+        if ((i < dst_offset || i >= dst_offset + size) && g_dst[i] != 0xaa)
+            return false;
+    }
+    return true;
+}
+
+static void verify(void) {
+    printf("Masking:\n");
+
+    bool ok = true;
+    for (int size = 0; size <= 64; size++) {
+        for (int key_offset = 0; key_offset < 4; key_offset++) {
+            for (int src_offset = 0; src_offset < 8; src_offset++) {
+                for (int dst_offset = 0; dst_offset < 8; dst_offset++)
+                    ok = ok && check(key_offset, size, src_offset, dst_offset);
+            }
+        }
+    }
+    VERIFY(ok, "xsp_ws_mask (small, all offsets)");
+    VERIFY(check(1, BUF_SIZE, 0, 0) && check(3, BUF_SIZE - 5, 5, 5) &&
+                   check(2, BUF_SIZE - 3, 1, 6),
+           "xsp_ws_mask (large)");
+
+    memcpy(g_dst, g_src, BUF_SIZE);
+    mask_bytewise(kMaskingKey, 2, BUF_SIZE - 3, g_src + 3, g_expected);
+    xsp_ws_mask(kMaskingKey, 2, BUF_SIZE - 3, g_dst + 3, g_dst + 3);
+    VERIFY(memcmp(g_dst + 3, g_expected, BUF_SIZE - 3) == 0, "xsp_ws_mask (in place)");
+}
+
+// Masks `size` bytes (repeatedly) and returns the throughput in KB/s.
+static int run_bench(mask_func_t mask, int size, int src_offset, int dst_offset) {
+    int iterations = (size < TOTAL_BYTES) ? TOTAL_BYTES / size : 1;
+    int64_t start_us = esp_timer_get_time();
+    for (int i = 0; i < iterations; i++) {
+        for (int offset = 0; offset < size; offset += BUF_SIZE) {
+            int piece_size = (size - offset < BUF_SIZE) ? size - offset : BUF_SIZE;
+            mask(kMaskingKey, offset, piece_size, g_src + src_offset, g_dst + dst_offset);
+        }
+    }
+    int64_t elapsed_us = esp_timer_get_time() - start_us;
+    return (int)(elapsed_us > 0 ? (int64_t)size * iterations * 1000000 / 1024 / elapsed_us : 0);
+}
+
+static void bench(void) {
+    printf("Masking throughput (KB/s; byte-at-a-time vs xsp_ws_mask):\n");
+    printf("  %8s %12s %12s %12s %12s\n", "size", "bytewise", "aligned", "src+1/dst+1",
+           "src+1/dst+0");
+    for (int size = 16; size <= 1024 * 1024; size *= 4) {
+        printf("  %8d %12d %12d %12d %12d\n", size, run_bench(&mask_bytewise, size, 0, 0),
+               run_bench(&xsp_ws_mask, size, 0, 0), run_bench(&xsp_ws_mask, size, 1, 1),
+               run_bench(&xsp_ws_mask, size, 1, 0));
+    }
+}
+
+void bench_mask(void) {
+    for (int i = 0; i < (int)sizeof(g_src); i++)
+        g_src[i] = (unsigned char)(i ^ (i >> 8));
+
+    verify();
+    bench();
+}
@@ -0,0 +1,19 @@
+// Copyright 2019 Tricot Inc.
+// Use of this source code is governed by the license in the LICENSE file.
+
+#ifndef BENCH_MASK_H_
+#define BENCH_MASK_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Verifies `xsp_ws_mask()` and benchmarks its throughput (against a simple byte-at-a-time loop)
+// over a range of payload sizes.
+void bench_mask(void);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // BENCH_MASK_H_
@@ -0,0 +1,108 @@
+// Copyright 2019 Tricot Inc.
+// Use of this source code is governed by the license in the LICENSE file.
+
+#include "bench_open.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "esp_timer.h"
+
+#include "xsp_loop.h"
+#include "xsp_ws_client.h"
+
+#include "sdkconfig.h"
+
+#include "bench_latency.h"
+
+#define VERIFY(cond, text) printf("  [%s] %s\n", (cond) ? "pass" : "FAIL", (text))
+
+typedef struct {
+    xsp_ws_client_handle_t client;
+    bool async;
+    bench_latency_t latency;  // Only measured while opening.
+
+    bool open_started;
+    bool open_done;
+    esp_err_t open_result;
+    int64_t open_start_us;
+    int64_t open_elapsed_us;
+} bench_open_context_t;
+
+static void on_open(xsp_ws_client_handle_t client, void* raw_ctx, esp_err_t result) {
+    bench_open_context_t* ctx = (bench_open_context_t*)raw_ctx;
+    ctx->latency.measuring = false;
+    ctx->open_done = true;
+    ctx->open_result = result;
+    ctx->open_elapsed_us = esp_timer_get_time() - ctx->open_start_us;
+}
+
+static void on_tick(xsp_loop_handle_t loop, void* raw_ctx, int64_t now_us) {
+    bench_open_context_t* ctx = (bench_open_context_t*)raw_ctx;
+
+    if (ctx->open_done) {
+        xsp_loop_stop(loop);
+        return;
+    }
+    if (ctx->open_started)
+        return;
+
+    // Start opening on the first tick (i.e., from inside the loop, as an application would).
+    ctx->open_started = true;
+    ctx->open_start_us = now_us;
+    ctx->latency.measuring = true;
+    if (ctx->async) {
+        esp_err_t err = xsp_ws_client_open_async(ctx->client, loop, &on_open, ctx);
+        if (err != ESP_OK)
+            on_open(ctx->client, ctx, err);
+    } else {
+        esp_err_t err = xsp_ws_client_open(ctx->client);
+        // Account for the time spent blocked (since there's no tick while blocked).
+        bench_latency_update(&ctx->latency);
+        on_open(ctx->client, ctx, err);
+    }
+}
+
+static void run_bench(bool async) {
+    bench_open_context_t ctx = {};
+    ctx.async = async;
+
+    xsp_ws_client_config_t config = {
+            .url = CONFIG_BENCH_SLOW_SERVER_URL,
+    };
+    ctx.client = xsp_ws_client_init(&config);
+    xsp_loop_handle_t loop = xsp_loop_init(NULL, NULL);
+    if (!ctx.client || !loop || !bench_latency_start(&ctx.latency, loop, &on_tick, &ctx)) {
+        printf("  [FAIL] setup\n");
+        goto done;
+    }
+
+    xsp_loop_run(loop);
+
+    printf("  %-8s open: %s in %d ms; max loop latency %d ms\n", async ? "async" : "blocking",
+           (ctx.open_result == ESP_OK) ? "succeeded" : "failed", (int)(ctx.open_elapsed_us / 1000),
+           (int)(ctx.latency.max_tick_gap_us / 1000));
+    if (async) {
+        VERIFY(ctx.open_result == ESP_OK, "async open succeeded");
+        VERIFY(ctx.latency.max_tick_gap_us < BENCH_LATENCY_MAX_MS * 1000,
+               "loop latency bounded during open");
+    }
+
+done:
+    bench_latency_stop(&ctx.latency);
+    if (loop)
+        xsp_loop_cleanup(loop);
+    if (ctx.client) {
+        xsp_ws_client_close(ctx.client);
+        xsp_ws_client_cleanup(ctx.client);
+    }
+}
+
+void bench_open(void) {
+    printf("Open (slow server: %s; loop ticking every %d ms):\n", CONFIG_BENCH_SLOW_SERVER_URL,
+           BENCH_LATENCY_TICK_MS);
+
+    run_bench(true);
+    run_bench(false);
+}
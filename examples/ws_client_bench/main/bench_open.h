@@ -0,0 +1,20 @@
+// Copyright 2019 Tricot Inc.
+// Use of this source code is governed by the license in the LICENSE file.
+
+#ifndef BENCH_OPEN_H_
+#define BENCH_OPEN_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Connects to a (deliberately) slow server (at CONFIG_BENCH_SLOW_SERVER_URL), using both
+// `xsp_ws_client_open_async()` and `xsp_ws_client_open()`, while a timer FD ticks on the loop, and
+// reports the loop's maximum iteration latency during each open.
+void bench_open(void);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // BENCH_OPEN_H_
@@ -0,0 +1,86 @@
+// Copyright 2019 Tricot Inc.
+// Use of this source code is governed by the license in the LICENSE file.
+
+#include "bench_read.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "esp_timer.h"
+
+#include "xsp_ws_client.h"
+
+#include "sdkconfig.h"
+
+#define PAYLOAD_SIZE 16
+#define NUM_FRAMES 200
+#define NUM_ROUNDS 10
+#define TIMEOUT_MS 5000
+
+void bench_read(void) {
+    printf("Reads (echo server: %s; %d rounds of %d %d-byte frames; read buffer size %d):\n",
+           CONFIG_BENCH_URL, NUM_ROUNDS, NUM_FRAMES, PAYLOAD_SIZE,
+           CONFIG_XSP_WS_CLIENT_READ_BUFFER_SIZE);
+
+    xsp_ws_client_config_t config = {
+            .url = CONFIG_BENCH_URL,
+    };
+    xsp_ws_client_handle_t client = xsp_ws_client_init(&config);
+    if (!client || xsp_ws_client_open(client) != ESP_OK) {
+        printf("  [FAIL] setup\n");
+        goto done;
+    }
+
+    unsigned char payload[PAYLOAD_SIZE] = {};
+    int64_t read_us = 0;
+    int num_buffered = 0;  // Frames that were read without going back to the transport.
+    xsp_ws_client_reset_stats(client);
+    for (int i = 0; i < NUM_ROUNDS; i++) {
+        // Send a burst, so that the echoes arrive back to back.
+        for (int j = 0; j < NUM_FRAMES; j++) {
+            if (xsp_ws_client_write_frame(client, true, XSP_WS_FRAME_OPCODE_BINARY, PAYLOAD_SIZE,
+                                          payload, TIMEOUT_MS) != ESP_OK) {
+                printf("  [FAIL] write\n");
+                goto done;
+            }
+        }
+
+        int64_t start_us = esp_timer_get_time();
+        for (int j = 0; j < NUM_FRAMES;) {
+            if (xsp_ws_client_has_buffered_read_data(client))
+                num_buffered++;
+            bool fin;
+            xsp_ws_frame_opcode_t opcode;
+            unsigned char buf[125];
+            int size;
+            if (xsp_ws_client_read_frame(client, &fin, &opcode, (int)sizeof(buf), buf, &size,
+                                         TIMEOUT_MS) != ESP_OK) {
+                printf("  [FAIL] read\n");
+                goto done;
+            }
+            // Skip control frames (e.g., pings).
+            if (!xsp_ws_is_control_frame_opcode(opcode))
+                j++;
+        }
+        read_us += esp_timer_get_time() - start_us;
+    }
+
+    xsp_ws_client_stats_t stats;
+    xsp_ws_client_get_stats(client, &stats);
+    int num_frames = NUM_ROUNDS * NUM_FRAMES;
+    // In hundredths.
+    int reads = (int)((uint64_t)stats.transport_reads * 100 / stats.frames_read);
+    printf("  %d frames in %d us (%d frames/s)\n", num_frames, (int)read_us,
+           (int)(read_us > 0 ? (int64_t)num_frames * 1000000 / read_us : 0));
+    printf("  %d.%02d transport reads/frame; %d frames already buffered\n", reads / 100,
+           reads % 100, num_buffered);
+
+    xsp_ws_client_write_close_frame(client, XSP_WS_STATUS_CLOSE_NORMAL_CLOSURE, NULL, TIMEOUT_MS);
+
+done:
+    if (client) {
+        xsp_ws_client_close(client);
+        xsp_ws_client_cleanup(client);
+    }
+}
@@ -0,0 +1,19 @@
+// Copyright 2019 Tricot Inc.
+// Use of this source code is governed by the license in the LICENSE file.
+
+#ifndef BENCH_READ_H_
+#define BENCH_READ_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Connects to an echo server (at CONFIG_BENCH_URL), sends a burst of small messages and then reads
+// the echoes, reporting frames read per second and transport reads per frame.
+void bench_read(void);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // BENCH_READ_H_
@@ -0,0 +1,50 @@
+// Copyright 2019 Tricot Inc.
+// Use of this source code is governed by the license in the LICENSE file.
+
+#include "bench_reopen.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "xsp_ws_client.h"
+
+#include "sdkconfig.h"
+
+#define NUM_REOPENS 5
+
+void bench_reopen(void) {
+    printf("Reopens (echo server: %s; %d opens):\n", CONFIG_BENCH_URL, NUM_REOPENS);
+
+    xsp_ws_client_config_t config = {
+            .url = CONFIG_BENCH_URL,
+    };
+    xsp_ws_client_handle_t client = xsp_ws_client_init(&config);
+    if (!client) {
+        printf("  [FAIL] setup\n");
+        return;
+    }
+
+    // The same client is reused, as when reconnecting. (Note that each open does a full TLS
+    // handshake for wss URLs, since TLS sessions aren't resumed.)
+    uint64_t last_open_time_us = 0;
+    for (int i = 0; i < NUM_REOPENS; i++) {
+        if (xsp_ws_client_open(client) != ESP_OK) {
+            printf("  [FAIL] open %d\n", i);
+            break;
+        }
+        xsp_ws_client_write_close_frame(client, XSP_WS_STATUS_CLOSE_NORMAL_CLOSURE, NULL, 5000);
+        xsp_ws_client_close(client);
+
+        xsp_ws_client_stats_t stats;
+        xsp_ws_client_get_stats(client, &stats);
+        printf("  open %d: %d ms\n", i, (int)((stats.open_time_us - last_open_time_us) / 1000));
+        last_open_time_us = stats.open_time_us;
+    }
+
+    xsp_ws_client_stats_t stats;
+    xsp_ws_client_get_stats(client, &stats);
+    if (stats.opens > 0)
+        printf("  average: %d ms\n", (int)(stats.open_time_us / stats.opens / 1000));
+
+    xsp_ws_client_cleanup(client);
+}
@@ -0,0 +1,19 @@
+// Copyright 2019 Tricot Inc.
+// Use of this source code is governed by the license in the LICENSE file.
+
+#ifndef BENCH_REOPEN_H_
+#define BENCH_REOPEN_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Repeatedly opens and closes a connection to the echo server (at CONFIG_BENCH_URL), and reports
+// the time taken by each open (i.e., the cost of a reconnect).
+void bench_reopen(void);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // BENCH_REOPEN_H_
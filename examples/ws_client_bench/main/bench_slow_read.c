@@ -0,0 +1,123 @@
+// Copyright 2019 Tricot Inc.
+// Use of this source code is governed by the license in the LICENSE file.
+
+#include "bench_slow_read.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "esp_timer.h"
+
+#include "xsp_loop.h"
+#include "xsp_ws_client.h"
+#include "xsp_ws_client_handler.h"
+
+#include "sdkconfig.h"
+
+#include "bench_latency.h"
+
+#define VERIFY(cond, text) printf("  [%s] %s\n", (cond) ? "pass" : "FAIL", (text))
+// Give up if the frames haven't all been received after this long.
+#define MAX_DURATION_MS 30000
+// The handler's read timeout. This is shorter than each frame takes to arrive (e.g., about 500 ms,
+// with `--write-rate 2000`), but the frames keep making progress, so they must not time out.
+#define READ_TIMEOUT_MS 250
+
+// These must match slow_server.py.
+#define NUM_FRAMES 8
+#define FRAME_SIZE 1000
+
+typedef struct {
+    int num_frames;
+    bool closed;
+    int64_t start_us;
+    int64_t elapsed_us;
+
+    bench_latency_t latency;
+} bench_slow_read_context_t;
+
+static void on_closed(xsp_ws_client_handler_handle_t handler, void* raw_ctx, int status) {
+    bench_slow_read_context_t* ctx = (bench_slow_read_context_t*)raw_ctx;
+    ctx->closed = true;
+    xsp_loop_stop(xsp_ws_client_handler_get_loop(handler));
+}
+
+static void on_data_frame_received(xsp_ws_client_handler_handle_t handler,
+                                   void* raw_ctx,
+                                   bool fin,
+                                   xsp_ws_frame_opcode_t opcode,
+                                   int payload_size,
+                                   const void* payload) {
+    bench_slow_read_context_t* ctx = (bench_slow_read_context_t*)raw_ctx;
+    if (payload_size != FRAME_SIZE)
+        return;
+    ctx->num_frames++;
+    if (ctx->num_frames == NUM_FRAMES) {
+        ctx->elapsed_us = esp_timer_get_time() - ctx->start_us;
+        xsp_loop_stop(xsp_ws_client_handler_get_loop(handler));
+    }
+}
+
+static void on_tick(xsp_loop_handle_t loop, void* raw_ctx, int64_t now_us) {
+    bench_slow_read_context_t* ctx = (bench_slow_read_context_t*)raw_ctx;
+
+    if (now_us - ctx->start_us > MAX_DURATION_MS * 1000)
+        xsp_loop_stop(loop);
+}
+
+void bench_slow_read(void) {
+    printf("Slow read (slow writer: %s; %d frames of %d bytes; read timeout %d ms; loop ticking "
+           "every %d ms):\n",
+           CONFIG_BENCH_SLOW_WRITER_URL, NUM_FRAMES, FRAME_SIZE, READ_TIMEOUT_MS,
+           BENCH_LATENCY_TICK_MS);
+
+    bench_slow_read_context_t ctx = {};
+    xsp_ws_client_handler_handle_t handler = NULL;
+
+    xsp_ws_client_config_t config = {
+            .url = CONFIG_BENCH_SLOW_WRITER_URL,
+    };
+    xsp_ws_client_handle_t client = xsp_ws_client_init(&config);
+    xsp_loop_handle_t loop = xsp_loop_init(NULL, NULL);
+    if (!client || !loop || xsp_ws_client_open(client) != ESP_OK) {
+        printf("  [FAIL] setup\n");
+        goto done;
+    }
+
+    xsp_ws_client_event_handler_t evt_handler = {
+            .on_ws_client_closed = &on_closed,
+            .on_ws_client_data_frame_received = &on_data_frame_received,
+            .ctx = &ctx,
+    };
+    xsp_ws_client_handler_config_t handler_config = xsp_ws_client_handler_config_default;
+    handler_config.read_timeout_ms = READ_TIMEOUT_MS;
+    handler = xsp_ws_client_handler_init(&handler_config, &evt_handler, client, loop);
+    if (!handler || !bench_latency_start(&ctx.latency, loop, &on_tick, &ctx)) {
+        printf("  [FAIL] setup\n");
+        goto done;
+    }
+
+    ctx.start_us = esp_timer_get_time();
+    ctx.latency.measuring = true;
+    xsp_loop_run(loop);
+
+    printf("  received %d/%d frames in %d ms; max loop latency %d ms\n", ctx.num_frames, NUM_FRAMES,
+           (int)(ctx.elapsed_us / 1000), (int)(ctx.latency.max_tick_gap_us / 1000));
+    VERIFY(ctx.num_frames == NUM_FRAMES && !ctx.closed, "all frames received");
+    VERIFY(ctx.elapsed_us / NUM_FRAMES > READ_TIMEOUT_MS * 1000,
+           "frames took longer than the read timeout");
+    VERIFY(ctx.latency.max_tick_gap_us < BENCH_LATENCY_MAX_MS * 1000,
+           "loop latency bounded while receiving");
+
+done:
+    bench_latency_stop(&ctx.latency);
+    if (handler)
+        xsp_ws_client_handler_cleanup(handler);
+    if (loop)
+        xsp_loop_cleanup(loop);
+    if (client) {
+        xsp_ws_client_close(client);
+        xsp_ws_client_cleanup(client);
+    }
+}
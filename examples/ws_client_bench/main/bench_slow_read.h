@@ -0,0 +1,21 @@
+// Copyright 2019 Tricot Inc.
+// Use of this source code is governed by the license in the LICENSE file.
+
+#ifndef BENCH_SLOW_READ_H_
+#define BENCH_SLOW_READ_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Receives several frames (using `xsp_ws_client_handler`) from a server that writes slowly (at
+// CONFIG_BENCH_SLOW_WRITER_URL), while a timer FD ticks on the loop, and reports the loop's maximum
+// iteration latency while receiving. Each frame takes longer to arrive than the handler's read
+// timeout, which mustn't expire since the frame keeps making progress.
+void bench_slow_read(void);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // BENCH_SLOW_READ_H_
@@ -0,0 +1,119 @@
+// Copyright 2019 Tricot Inc.
+// Use of this source code is governed by the license in the LICENSE file.
+
+#include "bench_slow_write.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "esp_timer.h"
+
+#include "xsp_loop.h"
+#include "xsp_ws_client.h"
+#include "xsp_ws_client_handler.h"
+
+#include "sdkconfig.h"
+
+#include "bench_latency.h"
+
+#define VERIFY(cond, text) printf("  [%s] %s\n", (cond) ? "pass" : "FAIL", (text))
+
+#define NUM_MESSAGES 8
+#define MESSAGE_SIZE (4 * 1024)
+
+typedef struct {
+    xsp_ws_client_handler_handle_t handler;
+    unsigned char* message;
+
+    bool send_started;
+    int num_completed;
+    int num_succeeded;
+    int64_t send_start_us;
+    int64_t send_elapsed_us;
+
+    bench_latency_t latency;  // Only measured while sending.
+} bench_slow_write_context_t;
+
+static void on_sent(xsp_ws_client_handler_handle_t handler, void* raw_ctx, bool success) {
+    bench_slow_write_context_t* ctx = (bench_slow_write_context_t*)raw_ctx;
+    ctx->num_completed++;
+    if (success)
+        ctx->num_succeeded++;
+    if (ctx->num_completed == NUM_MESSAGES) {
+        ctx->send_elapsed_us = esp_timer_get_time() - ctx->send_start_us;
+        xsp_loop_stop(xsp_ws_client_handler_get_loop(handler));
+    }
+}
+
+static void on_tick(xsp_loop_handle_t loop, void* raw_ctx, int64_t now_us) {
+    bench_slow_write_context_t* ctx = (bench_slow_write_context_t*)raw_ctx;
+
+    if (ctx->send_started)
+        return;
+
+    // Queue all the messages on the first tick (i.e., from inside the loop, as an application
+    // would).
+    ctx->send_started = true;
+    ctx->send_start_us = now_us;
+    ctx->latency.measuring = true;
+    for (int i = 0; i < NUM_MESSAGES; i++) {
+        if (xsp_ws_client_handler_send_message_with_callback(ctx->handler, true, MESSAGE_SIZE,
+                                                             ctx->message, &on_sent,
+                                                             ctx) != ESP_OK) {
+            on_sent(ctx->handler, ctx, false);
+        }
+    }
+}
+
+void bench_slow_write(void) {
+    printf("Slow write (slow reader: %s; %d messages of %d bytes; loop ticking every %d ms):\n",
+           CONFIG_BENCH_SLOW_READER_URL, NUM_MESSAGES, MESSAGE_SIZE, BENCH_LATENCY_TICK_MS);
+
+    bench_slow_write_context_t ctx = {};
+
+    xsp_ws_client_config_t config = {
+            .url = CONFIG_BENCH_SLOW_READER_URL,
+    };
+    xsp_ws_client_handle_t client = xsp_ws_client_init(&config);
+    xsp_loop_handle_t loop = xsp_loop_init(NULL, NULL);
+    ctx.message = (unsigned char*)malloc(MESSAGE_SIZE);
+    if (!client || !loop || !ctx.message || xsp_ws_client_open(client) != ESP_OK) {
+        printf("  [FAIL] setup\n");
+        goto done;
+    }
+    for (int i = 0; i < MESSAGE_SIZE; i++)
+        ctx.message[i] = (unsigned char)i;
+
+    xsp_ws_client_handler_config_t handler_config = xsp_ws_client_handler_config_default;
+    handler_config.send_queue_max_messages = NUM_MESSAGES;
+    handler_config.send_queue_max_bytes = 0;
+    xsp_ws_client_event_handler_t evt_handler = {};
+    ctx.handler = xsp_ws_client_handler_init(&handler_config, &evt_handler, client, loop);
+    if (!ctx.handler || !bench_latency_start(&ctx.latency, loop, &on_tick, &ctx)) {
+        printf("  [FAIL] setup\n");
+        goto done;
+    }
+
+    xsp_loop_run(loop);
+
+    printf("  sent %d/%d messages in %d ms; max loop latency %d ms\n", ctx.num_succeeded,
+           NUM_MESSAGES, (int)(ctx.send_elapsed_us / 1000),
+           (int)(ctx.latency.max_tick_gap_us / 1000));
+    VERIFY(ctx.num_succeeded == NUM_MESSAGES, "all messages sent");
+    VERIFY(ctx.latency.max_tick_gap_us < BENCH_LATENCY_MAX_MS * 1000,
+           "loop latency bounded while sending");
+
+done:
+    bench_latency_stop(&ctx.latency);
+    if (ctx.handler)
+        xsp_ws_client_handler_cleanup(ctx.handler);
+    if (loop)
+        xsp_loop_cleanup(loop);
+    if (client) {
+        xsp_ws_client_close(client);
+        xsp_ws_client_cleanup(client);
+    }
+    free(ctx.message);
+}
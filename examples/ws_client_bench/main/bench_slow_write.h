@@ -0,0 +1,20 @@
+// Copyright 2019 Tricot Inc.
+// Use of this source code is governed by the license in the LICENSE file.
+
+#ifndef BENCH_SLOW_WRITE_H_
+#define BENCH_SLOW_WRITE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Sends several large messages (using `xsp_ws_client_handler`) to a server that reads slowly (at
+// CONFIG_BENCH_SLOW_READER_URL), while a timer FD ticks on the loop, and reports the loop's maximum
+// iteration latency while sending.
+void bench_slow_write(void);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // BENCH_SLOW_WRITE_H_
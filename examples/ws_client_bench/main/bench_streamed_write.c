@@ -0,0 +1,361 @@
+// Copyright 2019 Tricot Inc.
+// Use of this source code is governed by the license in the LICENSE file.
+
+#include "bench_streamed_write.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "esp_timer.h"
+
+#include "xsp_loop.h"
+#include "xsp_ws_client.h"
+#include "xsp_ws_client_handler.h"
+
+#include "sdkconfig.h"
+
+#include "bench_latency.h"
+
+#define VERIFY(cond, text) printf("  [%s] %s\n", (cond) ? "pass" : "FAIL", (text))
+
+#define MESSAGE_SIZE (32 * 1024)
+// The producer is asked for at most this much at a time (i.e., `max_data_frame_write_size`).
+#define PRODUCER_BUFFER_SIZE 512
+// How long a paused producer stays paused before the message is resumed.
+#define PAUSE_TICKS 20
+// A case fails if it doesn't complete within this time.
+#define CASE_TIMEOUT_US (30 * 1000 * 1000)
+
+// The follow-up message (see `bench_case_t`), which is also the start of the streamed message's
+// data (so that echoes of either can be checked the same way).
+#define FOLLOW_UP_SIZE 16
+
+typedef struct {
+    const char* name;
+
+    int fail_at;   // If nonnegative, the producer fails when it gets here.
+    int pause_at;  // If nonnegative, the producer pauses (once) when it gets here.
+    // If set, the message isn't resumed after pausing; instead, the connection is closed (by the
+    // server, in response to a Close frame written directly to the client), with automatic
+    // reconnection enabled.
+    bool disconnect_when_paused;
+    // If set, a (non-streamed) message is queued after the streamed one.
+    bool follow_up;
+
+    // Expectations.
+    bool expect_success;      // For the streamed message.
+    int expect_close_status;  // Or -1 if the connection shouldn't be closed.
+} bench_case_t;
+
+static const bench_case_t kCases[] = {
+        {"pull", -1, -1, false, false, true, -1},
+        {"pause and resume", -1, MESSAGE_SIZE / 2, false, false, true, -1},
+        {"producer failure before first frame", 0, -1, false, true, false, -1},
+        {"producer failure after first frame", 4 * PRODUCER_BUFFER_SIZE, -1, false, false, false,
+         XSP_WS_STATUS_CLOSE_INTERNAL_SERVER_ERROR},
+        {"started message fails on disconnect", -1, 2 * PRODUCER_BUFFER_SIZE, true, true, false,
+         -1},
+};
+
+typedef struct {
+    const bench_case_t* bench_case;
+    xsp_ws_client_handler_handle_t handler;
+
+    // Producer state.
+    int produced;
+    int producer_calls;
+    int max_produced;        // Maximum amount produced by a single call.
+    int calls_while_paused;  // Should be 0, since the handler shouldn't call a paused producer.
+    bool paused;
+    bool pause_done;  // Set once the producer has paused (it only pauses once).
+    int pause_ticks_left;
+
+    // Results.
+    bool started;
+    int64_t start_us;
+    int64_t elapsed_us;
+    int num_completed;
+    int streamed_result;   // -1 if not completed, else 0 (failed) or 1 (succeeded).
+    int follow_up_result;  // Likewise.
+    int close_status;      // -1 if not closed.
+    int num_reconnects;
+    bool timed_out;
+
+    // Echo state: the echoed data (of the last message sent on the current connection) is checked
+    // against the message's data.
+    int echo_received;
+    bool echo_ok;
+    bool echo_done;
+
+    bench_latency_t latency;  // Only measured while the case is running.
+} bench_streamed_write_context_t;
+
+static unsigned char message_byte(int offset) {
+    return (unsigned char)(offset * 7 + 1);
+}
+
+static void maybe_finish(bench_streamed_write_context_t* ctx) {
+    const bench_case_t* c = ctx->bench_case;
+    if (ctx->num_completed < (c->follow_up ? 2 : 1))
+        return;
+    if (c->expect_close_status >= 0 && ctx->close_status < 0)
+        return;
+    // If the last message should succeed, wait for its echo.
+    if ((c->follow_up || c->expect_success) && !ctx->echo_done && ctx->close_status < 0)
+        return;
+    ctx->elapsed_us = esp_timer_get_time() - ctx->start_us;
+    xsp_loop_stop(xsp_ws_client_handler_get_loop(ctx->handler));
+}
+
+static int produce(xsp_ws_client_handler_handle_t handler,
+                   void* raw_ctx,
+                   int max_size,
+                   void* buffer,
+                   bool* done) {
+    bench_streamed_write_context_t* ctx = (bench_streamed_write_context_t*)raw_ctx;
+    const bench_case_t* c = ctx->bench_case;
+
+    ctx->producer_calls++;
+    if (ctx->paused) {
+        ctx->calls_while_paused++;
+        return 0;
+    }
+    if (ctx->produced == c->fail_at)
+        return -1;
+    if (ctx->produced == c->pause_at && !ctx->pause_done) {
+        ctx->paused = true;
+        ctx->pause_done = true;
+        ctx->pause_ticks_left = PAUSE_TICKS;
+        return 0;
+    }
+
+    int size = MESSAGE_SIZE - ctx->produced;
+    if (size > max_size)
+        size = max_size;
+    // Stop at the failure/pause point, so that it's reached exactly.
+    if (c->fail_at > ctx->produced && size > c->fail_at - ctx->produced)
+        size = c->fail_at - ctx->produced;
+    if (c->pause_at > ctx->produced && size > c->pause_at - ctx->produced)
+        size = c->pause_at - ctx->produced;
+    for (int i = 0; i < size; i++)
+        ((unsigned char*)buffer)[i] = message_byte(ctx->produced + i);
+    ctx->produced += size;
+    if (size > ctx->max_produced)
+        ctx->max_produced = size;
+    *done = ctx->produced == MESSAGE_SIZE;
+    return size;
+}
+
+static void on_streamed_sent(xsp_ws_client_handler_handle_t handler, void* raw_ctx, bool success) {
+    bench_streamed_write_context_t* ctx = (bench_streamed_write_context_t*)raw_ctx;
+    ctx->num_completed++;
+    ctx->streamed_result = success ? 1 : 0;
+    maybe_finish(ctx);
+}
+
+static void on_follow_up_sent(xsp_ws_client_handler_handle_t handler, void* raw_ctx, bool success) {
+    bench_streamed_write_context_t* ctx = (bench_streamed_write_context_t*)raw_ctx;
+    ctx->num_completed++;
+    ctx->follow_up_result = success ? 1 : 0;
+    maybe_finish(ctx);
+}
+
+static void check_echo(bench_streamed_write_context_t* ctx, bool fin, int size, const void* data) {
+    for (int i = 0; i < size; i++) {
+        if (((const unsigned char*)data)[i] != message_byte(ctx->echo_received + i))
+            ctx->echo_ok = false;
+    }
+    ctx->echo_received += size;
+    if (fin) {
+        ctx->echo_done = true;
+        maybe_finish(ctx);
+    }
+}
+
+static void on_data_frame_received(xsp_ws_client_handler_handle_t handler,
+                                   void* raw_ctx,
+                                   bool fin,
+                                   xsp_ws_frame_opcode_t opcode,
+                                   int payload_size,
+                                   const void* payload) {
+    check_echo((bench_streamed_write_context_t*)raw_ctx, fin, payload_size, payload);
+}
+
+static void on_data_frame_chunk_received(xsp_ws_client_handler_handle_t handler,
+                                         void* raw_ctx,
+                                         bool fin,
+                                         xsp_ws_frame_opcode_t opcode,
+                                         int payload_size,
+                                         int chunk_offset,
+                                         int chunk_size,
+                                         const void* chunk,
+                                         bool last_chunk) {
+    check_echo((bench_streamed_write_context_t*)raw_ctx, fin && last_chunk, chunk_size, chunk);
+}
+
+static void on_closed(xsp_ws_client_handler_handle_t handler, void* raw_ctx, int status) {
+    bench_streamed_write_context_t* ctx = (bench_streamed_write_context_t*)raw_ctx;
+    ctx->close_status = status;
+    maybe_finish(ctx);
+    // In any case, there's nothing more to do.
+    xsp_loop_stop(xsp_ws_client_handler_get_loop(handler));
+}
+
+static void on_connection_state_changed(xsp_ws_client_handler_handle_t handler,
+                                        void* raw_ctx,
+                                        xsp_ws_client_handler_connection_state_t state,
+                                        int status) {
+    bench_streamed_write_context_t* ctx = (bench_streamed_write_context_t*)raw_ctx;
+    if (state != XSP_WS_CLIENT_HANDLER_CONNECTION_STATE_CONNECTED)
+        return;
+    // Only the follow-up message will be echoed on the new connection.
+    ctx->num_reconnects++;
+    ctx->echo_received = 0;
+    ctx->echo_ok = true;
+    ctx->echo_done = false;
+}
+
+static void on_tick(xsp_loop_handle_t loop, void* raw_ctx, int64_t now_us) {
+    bench_streamed_write_context_t* ctx = (bench_streamed_write_context_t*)raw_ctx;
+
+    if (!ctx->started) {
+        // Queue the message(s) on the first tick (i.e., from inside the loop, as an application
+        // would).
+        ctx->started = true;
+        ctx->start_us = now_us;
+        ctx->latency.measuring = true;
+        if (xsp_ws_client_handler_send_streamed_message(ctx->handler, true, &produce, ctx,
+                                                        &on_streamed_sent, ctx) != ESP_OK) {
+            on_streamed_sent(ctx->handler, ctx, false);
+        }
+        if (ctx->bench_case->follow_up) {
+            // Note: The follow-up message's data is the start of the streamed message's.
+            static unsigned char follow_up[FOLLOW_UP_SIZE];
+            for (int i = 0; i < FOLLOW_UP_SIZE; i++)
+                follow_up[i] = message_byte(i);
+            if (xsp_ws_client_handler_send_message_with_callback(
+                        ctx->handler, true, FOLLOW_UP_SIZE, follow_up, &on_follow_up_sent, ctx) !=
+                ESP_OK) {
+                on_follow_up_sent(ctx->handler, ctx, false);
+            }
+        }
+        return;
+    }
+
+    if (now_us - ctx->start_us > CASE_TIMEOUT_US) {
+        ctx->timed_out = true;
+        xsp_loop_stop(loop);
+        return;
+    }
+
+    if (!ctx->paused || --ctx->pause_ticks_left > 0)
+        return;
+    ctx->paused = false;
+    if (ctx->bench_case->disconnect_when_paused) {
+        // Have the server close the connection. (The handler only sees the server's Close frame.)
+        xsp_ws_client_write_close_frame(xsp_ws_client_handler_get_ws_client(ctx->handler),
+                                        XSP_WS_STATUS_CLOSE_NORMAL_CLOSURE, NULL, 1000);
+        return;
+    }
+    if (xsp_ws_client_handler_resume_streamed_message(ctx->handler) != ESP_OK)
+        printf("  [FAIL] xsp_ws_client_handler_resume_streamed_message\n");
+}
+
+static void run_case(const bench_case_t* bench_case) {
+    printf("  %s:\n", bench_case->name);
+
+    bench_streamed_write_context_t ctx = {
+            .bench_case = bench_case,
+            .streamed_result = -1,
+            .follow_up_result = -1,
+            .close_status = -1,
+            .echo_ok = true,
+    };
+
+    xsp_ws_client_config_t config = {
+            .url = CONFIG_BENCH_URL,
+    };
+    xsp_ws_client_handle_t client = xsp_ws_client_init(&config);
+    xsp_loop_handle_t loop = xsp_loop_init(NULL, NULL);
+    if (!client || !loop || xsp_ws_client_open(client) != ESP_OK) {
+        printf("  [FAIL] setup\n");
+        goto done;
+    }
+
+    xsp_ws_client_handler_config_t handler_config = xsp_ws_client_handler_config_default;
+    handler_config.max_data_frame_write_size = PRODUCER_BUFFER_SIZE;
+    if (bench_case->disconnect_when_paused) {
+        handler_config.reconnect_base_delay_ms = 100;
+        handler_config.reconnect_max_delay_ms = 100;
+    } else {
+        handler_config.reconnect_base_delay_ms = 0;
+    }
+    xsp_ws_client_event_handler_t evt_handler = {
+            .on_ws_client_closed = &on_closed,
+            .on_ws_client_data_frame_received = &on_data_frame_received,
+            .on_ws_client_data_frame_chunk_received = &on_data_frame_chunk_received,
+            .on_ws_client_connection_state_changed = &on_connection_state_changed,
+            .ctx = &ctx,
+    };
+    ctx.handler = xsp_ws_client_handler_init(&handler_config, &evt_handler, client, loop);
+    if (!ctx.handler || !bench_latency_start(&ctx.latency, loop, &on_tick, &ctx)) {
+        printf("  [FAIL] setup\n");
+        goto done;
+    }
+
+    xsp_loop_run(loop);
+
+    printf("  produced %d/%d bytes in %d calls (at most %d bytes each) in %d ms; "
+           "max loop latency %d ms\n",
+           ctx.produced, MESSAGE_SIZE, ctx.producer_calls, ctx.max_produced,
+           (int)(ctx.elapsed_us / 1000), (int)(ctx.latency.max_tick_gap_us / 1000));
+    VERIFY(!ctx.timed_out, "completed");
+    VERIFY(ctx.max_produced <= PRODUCER_BUFFER_SIZE, "producer asked for at most its buffer size");
+    VERIFY(ctx.calls_while_paused == 0, "paused producer not called until resumed");
+    VERIFY(ctx.latency.max_tick_gap_us < BENCH_LATENCY_MAX_MS * 1000, "loop latency bounded");
+    if (bench_case->expect_success) {
+        VERIFY(ctx.streamed_result == 1 && ctx.produced == MESSAGE_SIZE, "message sent");
+        VERIFY(ctx.echo_done && ctx.echo_ok && ctx.echo_received == MESSAGE_SIZE,
+               "echo matches message");
+    } else {
+        VERIFY(ctx.streamed_result == 0, "message failed");
+    }
+    if (bench_case->pause_at >= 0 && !bench_case->disconnect_when_paused) {
+        VERIFY(ctx.elapsed_us >= PAUSE_TICKS * BENCH_LATENCY_TICK_MS * 1000,
+               "message paused until resumed");
+    }
+    if (bench_case->follow_up) {
+        VERIFY(ctx.follow_up_result == 1 && ctx.echo_done && ctx.echo_ok &&
+                       ctx.echo_received == FOLLOW_UP_SIZE,
+               "follow-up message sent and echoed");
+    }
+    if (bench_case->disconnect_when_paused)
+        VERIFY(ctx.num_reconnects == 1, "reconnected");
+    if (bench_case->expect_close_status >= 0) {
+        VERIFY(ctx.close_status == bench_case->expect_close_status,
+               "connection closed with expected status");
+    } else {
+        VERIFY(ctx.close_status < 0, "connection not closed");
+    }
+
+done:
+    bench_latency_stop(&ctx.latency);
+    if (ctx.handler)
+        xsp_ws_client_handler_cleanup(ctx.handler);
+    if (loop)
+        xsp_loop_cleanup(loop);
+    if (client) {
+        xsp_ws_client_close(client);
+        xsp_ws_client_cleanup(client);
+    }
+}
+
+void bench_streamed_write(void) {
+    printf("Streamed writes (echo server: %s; %d-byte messages, produced at most %d bytes at a "
+           "time; loop ticking every %d ms):\n",
+           CONFIG_BENCH_URL, MESSAGE_SIZE, PRODUCER_BUFFER_SIZE, BENCH_LATENCY_TICK_MS);
+
+    for (size_t i = 0; i < sizeof(kCases) / sizeof(kCases[0]); i++)
+        run_case(&kCases[i]);
+}
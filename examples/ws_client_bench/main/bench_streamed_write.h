@@ -0,0 +1,20 @@
+// Copyright 2019 Tricot Inc.
+// Use of this source code is governed by the license in the LICENSE file.
+
+#ifndef BENCH_STREAMED_WRITE_H_
+#define BENCH_STREAMED_WRITE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Sends streamed messages (using `xsp_ws_client_handler_send_streamed_message()`) to the echo
+// server (at CONFIG_BENCH_URL), checking the echoes, and checks that producer pauses, producer
+// failures, and disconnects are handled.
+void bench_streamed_write(void);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // BENCH_STREAMED_WRITE_H_
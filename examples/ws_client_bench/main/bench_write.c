@@ -0,0 +1,184 @@
+// Copyright 2019 Tricot Inc.
+// Use of this source code is governed by the license in the LICENSE file.
+
+#include "bench_write.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "esp_timer.h"
+
+#include "xsp_ws_client.h"
+
+#include "sdkconfig.h"
+
+#define MAX_PAYLOAD_SIZE 16000
+#define TIMEOUT_MS 5000
+
+// For the batched small-message benchmark.
+#define BATCH_SIZE 32
+#define BATCH_PAYLOAD_SIZE 16
+
+// Approximate per-record overhead for TLS (with AES-GCM): 5 (header) + 8 (explicit IV) + 16 (tag).
+#define TLS_RECORD_OVERHEAD 29
+
+static const int kPayloadSizes[] = {16, 125, 126, 1000, 1400, 4000, MAX_PAYLOAD_SIZE};
+
+// Reads frames until a data frame is read, and checks that it's the expected echo. (This doesn't
+// reply to pings: it's only a benchmark.)
+static bool read_echo(xsp_ws_client_handle_t client, int buffer_size, void* buffer, int size) {
+    for (;;) {
+        bool fin;
+        xsp_ws_frame_opcode_t opcode;
+        int payload_size;
+        if (xsp_ws_client_read_frame(client, &fin, &opcode, buffer_size, buffer, &payload_size,
+                                     TIMEOUT_MS) != ESP_OK) {
+            return false;
+        }
+        if (!xsp_ws_is_control_frame_opcode(opcode))
+            return fin && payload_size == size;
+        if (opcode == XSP_WS_FRAME_OPCODE_CONNECTION_CLOSE)
+            return false;
+    }
+}
+
+// Sends messages of the given size (writing in place if `in_place`) and reports. Each message is
+// (re)filled in `buffer` (which has XSP_WS_CLIENT_FRAME_HEADROOM bytes of headroom) before sending,
+// since writing in place modifies it.
+static bool run_bench(xsp_ws_client_handle_t client,
+                      bool is_ssl,
+                      int size,
+                      bool in_place,
+                      unsigned char* buffer,
+                      unsigned char* read_buf) {
+    unsigned char* payload = buffer + XSP_WS_CLIENT_FRAME_HEADROOM;
+    xsp_ws_client_reset_stats(client);
+    int64_t start_us = esp_timer_get_time();
+    for (int i = 0; i < CONFIG_BENCH_NUM_MESSAGES; i++) {
+        for (int j = 0; j < size; j++)
+            payload[j] = (unsigned char)(i + j);
+        esp_err_t err;
+        if (in_place) {
+            err = xsp_ws_client_write_frame_in_place(client, true, XSP_WS_FRAME_OPCODE_BINARY, size,
+                                                     buffer, TIMEOUT_MS);
+        } else {
+            err = xsp_ws_client_write_frame(client, true, XSP_WS_FRAME_OPCODE_BINARY, size, payload,
+                                            TIMEOUT_MS);
+        }
+        if (err != ESP_OK || !read_echo(client, MAX_PAYLOAD_SIZE, read_buf, size)) {
+            printf("  [FAIL] size %d, message %d\n", size, i);
+            return false;
+        }
+    }
+    int64_t elapsed_us = esp_timer_get_time() - start_us;
+
+    xsp_ws_client_stats_t stats;
+    xsp_ws_client_get_stats(client, &stats);
+    // Per message, in hundredths.
+    int writes = (int)(stats.transport_writes * 100 / CONFIG_BENCH_NUM_MESSAGES);
+    int bytes = (int)(stats.bytes_written * 100 / CONFIG_BENCH_NUM_MESSAGES);
+    // Not counting TCP/IP overhead.
+    int wire_bytes = bytes + (is_ssl ? writes * TLS_RECORD_OVERHEAD : 0);
+    printf("  %6d %8s %11d.%02d %11d.%02d %11d.%02d %10d\n", size, in_place ? "in place" : "copy",
+           writes / 100, writes % 100, bytes / 100, bytes % 100, wire_bytes / 100,
+           wire_bytes % 100,
+           (int)(elapsed_us > 0 ? (int64_t)CONFIG_BENCH_NUM_MESSAGES * 1000000 / elapsed_us : 0));
+    return true;
+}
+
+// Sends batches of `BATCH_SIZE` small messages (corked if `corked`, flushing after each batch),
+// reading the echoes after each batch, and reports.
+static bool run_batch_bench(xsp_ws_client_handle_t client,
+                            bool is_ssl,
+                            bool corked,
+                            unsigned char* buffer,
+                            unsigned char* read_buf) {
+    xsp_ws_client_set_cork(client, corked);
+    xsp_ws_client_reset_stats(client);
+    int64_t start_us = esp_timer_get_time();
+    for (int i = 0; i < CONFIG_BENCH_NUM_MESSAGES; i += BATCH_SIZE) {
+        int n = (CONFIG_BENCH_NUM_MESSAGES - i < BATCH_SIZE) ? CONFIG_BENCH_NUM_MESSAGES - i
+                                                             : BATCH_SIZE;
+        for (int j = 0; j < n; j++) {
+            memset(buffer, i + j, BATCH_PAYLOAD_SIZE);
+            if (xsp_ws_client_write_frame(client, true, XSP_WS_FRAME_OPCODE_BINARY,
+                                          BATCH_PAYLOAD_SIZE, buffer, TIMEOUT_MS) != ESP_OK) {
+                printf("  [FAIL] batch message %d\n", i + j);
+                return false;
+            }
+        }
+        if (xsp_ws_client_flush(client, TIMEOUT_MS) != ESP_OK) {
+            printf("  [FAIL] flush after message %d\n", i + n - 1);
+            return false;
+        }
+        for (int j = 0; j < n; j++) {
+            if (!read_echo(client, MAX_PAYLOAD_SIZE, read_buf, BATCH_PAYLOAD_SIZE)) {
+                printf("  [FAIL] batch echo %d\n", i + j);
+                return false;
+            }
+        }
+    }
+    int64_t elapsed_us = esp_timer_get_time() - start_us;
+    xsp_ws_client_set_cork(client, false);
+
+    xsp_ws_client_stats_t stats;
+    xsp_ws_client_get_stats(client, &stats);
+    // Per message, in hundredths.
+    int writes = (int)(stats.transport_writes * 100 / CONFIG_BENCH_NUM_MESSAGES);
+    int bytes = (int)(stats.bytes_written * 100 / CONFIG_BENCH_NUM_MESSAGES);
+    int wire_bytes = bytes + (is_ssl ? writes * TLS_RECORD_OVERHEAD : 0);
+    printf("  %6d %8s %11d.%02d %11d.%02d %11d.%02d %10d\n", BATCH_PAYLOAD_SIZE,
+           corked ? "corked" : "uncorked", writes / 100, writes % 100, bytes / 100, bytes % 100,
+           wire_bytes / 100, wire_bytes % 100,
+           (int)(elapsed_us > 0 ? (int64_t)CONFIG_BENCH_NUM_MESSAGES * 1000000 / elapsed_us : 0));
+    return true;
+}
+
+void bench_write(void) {
+    printf("Writes (echo server: %s; %d messages per size):\n", CONFIG_BENCH_URL,
+           CONFIG_BENCH_NUM_MESSAGES);
+
+    bool is_ssl = strncasecmp(CONFIG_BENCH_URL, "wss:", 4) == 0;
+    xsp_ws_client_config_t config = {
+            .url = CONFIG_BENCH_URL,
+    };
+    xsp_ws_client_handle_t client = xsp_ws_client_init(&config);
+    unsigned char* buffer =
+            (unsigned char*)malloc(XSP_WS_CLIENT_FRAME_HEADROOM + MAX_PAYLOAD_SIZE);
+    unsigned char* read_buf = (unsigned char*)malloc(MAX_PAYLOAD_SIZE);
+    if (!client || !buffer || !read_buf || xsp_ws_client_open(client) != ESP_OK) {
+        printf("  [FAIL] setup\n");
+        goto done;
+    }
+
+    printf("  %6s %8s %14s %14s %14s %10s\n", "size", "mode", "writes/msg", "bytes/msg",
+           "est. wire/msg", "msgs/s");
+    for (size_t i = 0; i < sizeof(kPayloadSizes) / sizeof(kPayloadSizes[0]); i++) {
+        if (!run_bench(client, is_ssl, kPayloadSizes[i], false, buffer, read_buf) ||
+            !run_bench(client, is_ssl, kPayloadSizes[i], true, buffer, read_buf)) {
+            goto done;
+        }
+    }
+
+    printf("Batched writes (%d messages per batch):\n", BATCH_SIZE);
+    printf("  %6s %8s %14s %14s %14s %10s\n", "size", "mode", "writes/msg", "bytes/msg",
+           "est. wire/msg", "msgs/s");
+    if (!run_batch_bench(client, is_ssl, false, buffer, read_buf) ||
+        !run_batch_bench(client, is_ssl, true, buffer, read_buf)) {
+        goto done;
+    }
+
+    xsp_ws_client_write_close_frame(client, XSP_WS_STATUS_CLOSE_NORMAL_CLOSURE, NULL, TIMEOUT_MS);
+
+done:
+    if (client) {
+        xsp_ws_client_close(client);
+        xsp_ws_client_cleanup(client);
+    }
+    free(read_buf);
+    free(buffer);
+}
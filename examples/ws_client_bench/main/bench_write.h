@@ -0,0 +1,20 @@
+// Copyright 2019 Tricot Inc.
+// Use of this source code is governed by the license in the LICENSE file.
+
+#ifndef BENCH_WRITE_H_
+#define BENCH_WRITE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Connects to an echo server (at CONFIG_BENCH_URL) and, for a range of payload sizes, sends
+// messages (waiting for each to be echoed), reporting transport writes and bytes written per
+// message.
+void bench_write(void);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // BENCH_WRITE_H_
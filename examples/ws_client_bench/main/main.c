@@ -0,0 +1,68 @@
+// Copyright 2019 Tricot Inc.
+// Use of this source code is governed by the license in the LICENSE file.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_system.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "nvs_flash.h"
+
+#include "xsp_eventfd.h"
+#include "xsp_timerfd.h"
+
+#include "app_wifi.h"
+#include "bench_mask.h"
+#include "bench_open.h"
+#include "bench_read.h"
+#include "bench_reopen.h"
+#include "bench_slow_read.h"
+#include "bench_slow_write.h"
+#include "bench_streamed_write.h"
+#include "bench_write.h"
+
+#include "sdkconfig.h"
+
+static void bench_task(void* pvParameters) {
+    bench_mask();
+
+    if (strlen(CONFIG_BENCH_URL) > 0) {
+        app_wifi_wait_connected();
+        bench_write();
+        bench_read();
+        bench_reopen();
+        bench_streamed_write();
+    }
+    if (strlen(CONFIG_BENCH_SLOW_SERVER_URL) > 0) {
+        app_wifi_wait_connected();
+        bench_open();
+    }
+    if (strlen(CONFIG_BENCH_SLOW_READER_URL) > 0) {
+        app_wifi_wait_connected();
+        bench_slow_write();
+    }
+    if (strlen(CONFIG_BENCH_SLOW_WRITER_URL) > 0) {
+        app_wifi_wait_connected();
+        bench_slow_read();
+    }
+    printf("DONE\n");
+
+    vTaskDelay(10000 / portTICK_PERIOD_MS);
+    esp_restart();
+}
+
+void app_main(void) {
+    esp_err_t err = nvs_flash_init();
+    if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        err = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK(err);
+
+    xsp_eventfd_register();
+    xsp_timerfd_register();
+    app_wifi_initialise();
+
+    xTaskCreate(&bench_task, "bench_task", 8192, NULL, 5, NULL);
+}
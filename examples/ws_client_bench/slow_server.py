@@ -0,0 +1,111 @@
+#!/usr/bin/env python3
+# Copyright 2019 Tricot Inc.
+# Use of this source code is governed by the license in the LICENSE file.
+
+"""A deliberately slow WebSocket server, for testing asynchronous opens and nonblocking I/O.
+
+It delays its response to each upgrade request (by --delay seconds), then completes the handshake
+and discards anything received until the client disconnects. If --read-rate is given, it reads at
+most that many bytes per second (with small socket buffers), acting as a slow reader. If
+--write-rate is given, it also sends several binary frames (of 1000 bytes each), trickling them
+out at that many bytes per second, acting as a slow writer (some frame headers are split across
+writes).
+"""
+
+import argparse
+import asyncio
+import base64
+import hashlib
+import socket
+
+RFC6455_GUID = b"258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+SLOW_FRAME_COUNT = 8
+SLOW_FRAME_SIZE = 1000
+
+
+async def write_slowly(writer, write_rate):
+    # Unmasked binary frames, with 16-bit payload lengths.
+    frame = bytes([0x82, 126, SLOW_FRAME_SIZE >> 8, SLOW_FRAME_SIZE & 0xff]) + bytes(
+        SLOW_FRAME_SIZE)
+    data = frame * SLOW_FRAME_COUNT
+    # Write (about) a tenth of the rate every 100 ms. The piece size is odd, so that (since frames
+    # are an even size) some frame headers are split across pieces.
+    piece_size = max(1, write_rate // 10) | 1
+    for i in range(0, len(data), piece_size):
+        writer.write(data[i:i + piece_size])
+        await writer.drain()
+        await asyncio.sleep(0.1)
+
+
+async def handle(reader, writer, delay, read_rate, write_rate):
+    peer = writer.get_extra_info("peername")
+    try:
+        request = await reader.readuntil(b"\r\n\r\n")
+        key = None
+        for line in request.split(b"\r\n"):
+            name, _, value = line.partition(b":")
+            if name.strip().lower() == b"sec-websocket-key":
+                key = value.strip()
+        if key is None:
+            print("%s: not a WebSocket upgrade request" % (peer,))
+            return
+        print("%s: got upgrade request; responding in %g s" % (peer, delay))
+        await asyncio.sleep(delay)
+        accept = base64.b64encode(hashlib.sha1(key + RFC6455_GUID).digest())
+        writer.write(b"HTTP/1.1 101 Switching Protocols\r\n"
+                     b"Upgrade: websocket\r\n"
+                     b"Connection: Upgrade\r\n"
+                     b"Sec-WebSocket-Accept: " + accept + b"\r\n"
+                     b"\r\n")
+        await writer.drain()
+        if write_rate > 0:
+            write_task = asyncio.ensure_future(write_slowly(writer, write_rate))
+        if read_rate > 0:
+            # Read (at most) a tenth of the rate every 100 ms.
+            read_size = max(1, read_rate // 10)
+            while await reader.read(read_size):
+                await asyncio.sleep(0.1)
+        else:
+            while await reader.read(4096):
+                pass
+        if write_rate > 0:
+            write_task.cancel()
+        print("%s: disconnected" % (peer,))
+    except (asyncio.IncompleteReadError, ConnectionError):
+        print("%s: connection lost" % (peer,))
+    finally:
+        writer.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--port", type=int, default=8765)
+    parser.add_argument("--delay", type=float, default=3.0)
+    parser.add_argument("--read-rate", type=int, default=0,
+                        help="maximum bytes per second to read (default: unlimited)")
+    parser.add_argument("--write-rate", type=int, default=0,
+                        help="bytes per second at which to send frames (default: don't send)")
+    args = parser.parse_args()
+
+    # For a slow reader, keep the receive buffer small (it's inherited by accepted sockets), so
+    # that the client's writes back up quickly.
+    sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    if args.read_rate > 0:
+        sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 4096)
+    sock.bind(("", args.port))
+
+    loop = asyncio.get_event_loop()
+    server = loop.run_until_complete(asyncio.start_server(
+        lambda r, w: handle(r, w, args.delay, args.read_rate, args.write_rate), sock=sock,
+        limit=4096 if args.read_rate > 0 else 2 ** 16))
+    print("Listening on port %d" % args.port)
+    try:
+        loop.run_forever()
+    finally:
+        server.close()
+
+
+if __name__ == "__main__":
+    main()
@@ -219,7 +219,8 @@ static void do_echo(const char* url, bool save_first_msg, int* first_msg_size, v
     xsp_ws_client_event_handler_t client_evt_handler = {
             &on_ws_client_closed,        &on_ws_client_data_frame_received,
             &on_ws_client_ping_received, &on_ws_client_pong_received,
-            &on_ws_client_message_sent,  &ctx};
+            &on_ws_client_message_sent,  NULL,
+            NULL,                        &ctx};
 
     xsp_ws_client_handle_t client = NULL;
     xsp_loop_handle_t loop = NULL;